@@ -5,6 +5,9 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <set>
+#include <cctype>
+#include <algorithm>
 #include <assert.h>
 #include <sqlite3.h>
 
@@ -15,10 +18,14 @@ namespace {
         std::string name;
         std::string ctype;
         std::string ntype;
+
+        /// \brief true for a list bound to sqlch_array(:name)
+        bool isArray;
         inline Variable(const std::string& n, const std::string& c, const std::string& t)
             : name(n)
             , ctype(c)
-            , ntype(t) {}
+            , ntype(t)
+            , isArray(false) {}
     };
 
     struct Column {
@@ -37,6 +44,25 @@ namespace {
             , is_pk(p) {}
     };
 
+    /// \brief a single column foreign key, from a column of this table to a column of another
+    struct ForeignKey {
+        std::string table;
+        std::string from;
+        std::string to;
+        inline ForeignKey(const std::string& t, const std::string& f, const std::string& o)
+            : table(t)
+            , from(f)
+            , to(o) {}
+    };
+
+    /// \brief shape of the value returned by a generated select
+    enum class Cardinality {
+        Many,
+        One,
+        Scalar,
+        Exists
+    };
+
     struct Statement {
         int action;
         std::string sqls;
@@ -48,11 +74,61 @@ namespace {
 
         std::vector<Column> colList;
         std::vector<Variable> varList;
+
+        /// \brief foreign keys of a CREATE TABLE
+        std::vector<ForeignKey> fkList;
+
+        /// \brief tables read by this statement, as reported by the authorizer
+        std::vector<std::string> readList;
+
+        /// \brief max entries in the result cache of a select, 0 if not cached
+        size_t cacheSize;
+
+        /// \brief capacity of the change ring of a CREATE TABLE, 0 if its changes are not captured
+        size_t cdcSize;
+
+        /// \brief true for an INSERT ... ON CONFLICT DO UPDATE or DO NOTHING
+        bool isUpsert;
+
+        /// \brief true for a statement copied into a PROCEDURE by CALL, its sql string is already generated
+        bool isCalled;
+
+        /// \brief true for a select that also returns its rows as per-column arrays
+        bool isColumnar;
+
+        /// \brief true for a select that can also be exported as an Arrow IPC stream
+        bool isArrow;
+
+        Cardinality cardinality;
+
+        /// \brief keyset pagination: key expressions, their columns in colList,
+        /// direction and the rewritten queries for the first and the following pages
+        std::vector<std::string> pageList;
+        std::vector<size_t> pageCols;
+        bool pageDesc;
+        std::string pageFirst;
+        std::string pageNext;
+
+        /// \brief parallel scan: partition key, the range query over it, the
+        /// partition query, and the ORDER BY columns (index in colList, desc) to merge on
+        std::string partKey;
+        std::string partRange;
+        std::string partSql;
+        std::vector<std::pair<size_t, bool> > partOrder;
+
         std::string qname_;
         std::string pktype_;
         inline Statement(const int& a, const std::string& s)
             : action(a)
-            , sqls(s) {}
+            , sqls(s)
+            , cacheSize(0)
+            , cdcSize(0)
+            , isUpsert(false)
+            , isCalled(false)
+            , isColumnar(false)
+            , isArrow(false)
+            , cardinality(Cardinality::Many)
+            , pageDesc(false) {}
 
         inline auto& addColumn(const std::string& tn, const std::string& cn, const std::string& s, const std::string& c, const std::string& n, const bool& p) {
             colList.emplace_back(tn, cn, s, c, n, p);
@@ -77,11 +153,15 @@ namespace {
         Module& module;
         Database& db;
         bool isDB;
+
+        /// \brief true for a PROCEDURE, whose statements also run in sequence in one transaction
+        bool isProc;
         std::string name;
         std::vector<Statement> stmtList;
         inline Interface(Module& m, Database& d, const bool& idb, const std::string& n)
             : module(m), db(d)
             , isDB(idb)
+            , isProc(false)
             , name(n) {}
 
         inline auto& addStatement(const int& action, const std::string& s) {
@@ -92,11 +172,32 @@ namespace {
             }
             return ls;
         }
+        inline void generateInvalidate(const Statement& stmt, std::ostream& of_src) const;
+        inline void generateListener(std::ostream& of_src, const std::string& ns) const;
         inline void generateEncString(const Module& module, const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
         inline void generateCreateTable(const Statement& stmt, std::ostream& of_hdr) const;
         inline void generateInsert(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline void generateUpsert(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline void generateUpdate(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline void generateUpdateTable(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline bool getLoader(const Statement& stmt, const ForeignKey& fk, const Column*& key) const;
+        inline std::string getLoaderSql(const Statement& stmt, const ForeignKey& fk) const;
+        inline void generateLoaders(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline void generateImport(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline void generateChangeRow(const Statement& stmt, const std::string& fn, std::ostream& of_src) const;
+        inline void generateChanges(std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
         inline void generateDelete(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline void generateRowRead(const Statement& stmt, const std::string& sv, std::ostream& of_src, const std::string& indent, const bool& reuse = false) const;
+        inline void generateParallel(const Statement& stmt, const std::string& rname, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline void generatePage(const Statement& stmt, const std::string& rname, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline bool isTextColumn(const Column& c) const;
+        inline void generateColumnsDecl(const Statement& stmt, std::ostream& of_hdr) const;
+        inline void generateColumns(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline void generateArrow(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
         inline void generateSelect(const Module& module, const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
+        inline std::string getReturnType(const Statement& stmt, const std::string& ns) const;
+        inline std::vector<Variable> getProcVariables() const;
+        inline void generateRun(std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
         inline void generateIfaceDecl(const Module& module, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
         inline void generate(const Module& module, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const;
     };
@@ -117,13 +218,39 @@ namespace {
             assert(interfaceList.size() > 0);
             return interfaceList.back();
         }
+
+        inline bool hasChanges() const {
+            for(auto& iface : interfaceList) {
+                for(auto& s : iface.stmtList) {
+                    if(s.cdcSize > 0) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        inline bool hasCache() const {
+            for(auto& iface : interfaceList) {
+                for(auto& s : iface.stmtList) {
+                    if(s.cacheSize > 0) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
     };
 
     struct EnumType {
         std::string name;
         std::vector<std::string> valueList;
+
+        /// \brief true if columns of this type must be stored as their INTEGER ordinal
+        bool isInteger;
         inline EnumType(const std::string& n)
-            : name(n) {}
+            : name(n)
+            , isInteger(false) {}
     };
 
     struct Module {
@@ -159,6 +286,64 @@ namespace {
             return enumList.back();
         }
 
+        inline const EnumType* getEnumType(const std::string& ntype) const {
+            auto n = ntype.substr((ntype.rfind("::") == std::string::npos) ? 0 : (ntype.rfind("::") + 2));
+            for(auto& e : enumList) {
+                if(e.name == n) {
+                    return &e;
+                }
+            }
+            return nullptr;
+        }
+
+        /// \brief true if ntype is a std::chrono duration or time point
+        inline bool isChrono(const std::string& ntype) const {
+            return (ntype.find("chrono::") != std::string::npos);
+        }
+
+        /// \brief returns the type a value of ntype is bound as, when there is no column to take it from
+        inline std::string storeType(const std::string& ntype) const {
+            if(isChrono(ntype)) {
+                return "int64_t";
+            }
+            auto et = getEnumType(ntype);
+            if(et != nullptr) {
+                return et->isInteger ? "int64_t" : "std::string";
+            }
+            return ntype;
+        }
+
+        /// \brief returns the conversion applied to a native value before it is bound
+        inline std::string storeCast(const std::string& ctype, const std::string& ntype) const {
+            if(ntype == ctype) {
+                return "";
+            }
+            if(ctype == generateBaseNS + "::array_ref") {
+                return generateBaseNS + "::make_array";
+            }
+            if((ctype == "std::string") && (getEnumType(ntype) != nullptr)) {
+                return "to_string";
+            }
+            if((ctype == "int64_t") && isChrono(ntype)) {
+                return generateBaseNS + "::to_epoch";
+            }
+            return "static_cast<" + ctype + ">";
+        }
+
+        /// \brief returns the conversion applied to a column value before it is returned
+        inline std::string nativeCast(const std::string& ctype, const std::string& ntype) const {
+            if(ntype == ctype) {
+                return "";
+            }
+            if((ctype == "std::string") && (getEnumType(ntype) != nullptr)) {
+                return "from_string<" + ntype + ">";
+            }
+            if((ctype == "int64_t") && isChrono(ntype)) {
+                return generateBaseNS + "::from_epoch<" + ntype + ">";
+            }
+            return "static_cast<" + ntype + ">";
+        }
+
         inline auto& db() {
             assert(dbList.size() > 0);
             return dbList.back();
@@ -198,7 +383,8 @@ namespace {
                 auto& cs = getCreateStatement(s.tname);
                 s.pktype_ = "uint64_t";
                 for(auto& c : cs.colList) {
-                    if(c.is_pk) {
+                    // insert() returns the rowid, which is the primary key only if that is an integer
+                    if(c.is_pk && (c.ctype == "int64_t")) {
                         s.pktype_ = c.ntype;
                         break;
                     }
@@ -218,6 +404,331 @@ namespace {
         return p;
     }
 
+    inline std::string upper(const std::string& s) {
+        std::string rv = s;
+        for(auto& c : rv) {
+            c = static_cast<char>(::toupper(c));
+        }
+        return rv;
+    }
+
+    inline bool isIdChar(const char& ch) {
+        return ((ch == '_') || ::isalnum(static_cast<unsigned char>(ch)));
+    }
+
+    /// \brief returns the position of a top-level clause (e.g. "ORDER BY") in sql, or npos
+    /// keywords inside parentheses, quotes and comments are skipped, and the words
+    /// of the clause may be separated by any whitespace
+    inline size_t findClause(const std::string& sql, const std::string& clause) {
+        int depth = 0;
+        for(size_t i = 0; i < sql.length(); ++i) {
+            auto ch = sql.at(i);
+            if((ch == '\'') || (ch == '"') || (ch == '`')) {
+                auto e = sql.find(ch, i + 1);
+                if(e == std::string::npos) {
+                    return std::string::npos;
+                }
+                i = e;
+                continue;
+            }
+            if((ch == '-') && (sql.compare(i, 2, "--") == 0)) {
+                i = sql.find('\n', i);
+                if(i == std::string::npos) {
+                    return std::string::npos;
+                }
+                continue;
+            }
+            if(ch == '(') {
+                ++depth;
+                continue;
+            }
+            if(ch == ')') {
+                --depth;
+                continue;
+            }
+            if((depth > 0) || ((i > 0) && isIdChar(sql.at(i - 1)))) {
+                continue;
+            }
+            size_t j = i;
+            size_t k = 0;
+            while((k < clause.length()) && (j < sql.length())) {
+                if(clause.at(k) == ' ') {
+                    if(!::isspace(static_cast<unsigned char>(sql.at(j)))) {
+                        break;
+                    }
+                    while((j < sql.length()) && ::isspace(static_cast<unsigned char>(sql.at(j)))) {
+                        ++j;
+                    }
+                    ++k;
+                    continue;
+                }
+                if(::toupper(static_cast<unsigned char>(sql.at(j))) != clause.at(k)) {
+                    break;
+                }
+                ++j;
+                ++k;
+            }
+            if((k == clause.length()) && ((j == sql.length()) || !isIdChar(sql.at(j)))) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+    /// \brief returns the position of the parenthesis closing the first one in sql, or npos
+    inline size_t findClose(const std::string& sql) {
+        int depth = 0;
+        for(size_t i = 0; i < sql.length(); ++i) {
+            auto ch = sql.at(i);
+            if((ch == '\'') || (ch == '"') || (ch == '`')) {
+                i = sql.find(ch, i + 1);
+                if(i == std::string::npos) {
+                    return std::string::npos;
+                }
+                continue;
+            }
+            if((ch == '-') && (sql.compare(i, 2, "--") == 0)) {
+                i = sql.find('\n', i);
+                if(i == std::string::npos) {
+                    return std::string::npos;
+                }
+                continue;
+            }
+            if((ch == '/') && (sql.compare(i, 2, "/*") == 0)) {
+                i = sql.find("*/", i + 2);
+                if(i == std::string::npos) {
+                    return std::string::npos;
+                }
+                ++i;
+                continue;
+            }
+            if(ch == '(') {
+                ++depth;
+            } else if((ch == ')') && (--depth == 0)) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+    inline bool hasClause(const std::string& sql, const std::string& clause) {
+        return (findClause(sql, clause) != std::string::npos);
+    }
+
+    /// \brief returns the tokens of sql: words upper cased, parameters with their prefix (e.g. ":id"),
+    /// and each other character on its own, leaving out literals, quoted names and comments
+    inline std::vector<std::string> getTokens(const std::string& sql) {
+        std::vector<std::string> rv;
+        for(size_t i = 0; i < sql.length(); ++i) {
+            auto ch = sql.at(i);
+            if((ch == '\'') || (ch == '"') || (ch == '`')) {
+                i = sql.find(ch, i + 1);
+                if(i == std::string::npos) {
+                    break;
+                }
+                continue;
+            }
+            if((ch == '-') && (sql.compare(i, 2, "--") == 0)) {
+                i = sql.find('\n', i);
+                if(i == std::string::npos) {
+                    break;
+                }
+                continue;
+            }
+            if((ch == '/') && (sql.compare(i, 2, "/*") == 0)) {
+                i = sql.find("*/", i + 2);
+                if(i == std::string::npos) {
+                    break;
+                }
+                ++i;
+                continue;
+            }
+            if(::isspace(static_cast<unsigned char>(ch))) {
+                continue;
+            }
+            bool isParam = (((ch == ':') || (ch == '@') || (ch == '$')) && (i + 1 < sql.length()) && isIdChar(sql.at(i + 1)));
+            if(!isParam && !isIdChar(ch)) {
+                rv.push_back(std::string(1, ch));
+                continue;
+            }
+            auto j = i + 1;
+            while((j < sql.length()) && isIdChar(sql.at(j))) {
+                ++j;
+            }
+            auto tok = sql.substr(i, j - i);
+            rv.push_back(isParam ? tok : upper(tok));
+            i = j - 1;
+        }
+        return rv;
+    }
+
+    /// \brief returns the words of sql, upper cased, leaving out parameters and the contents of
+    /// subqueries. A word followed by '(' keeps it, as in "COUNT("
+    inline std::vector<std::string> getWords(const std::string& sql) {
+        std::vector<std::string> rv;
+        auto tl = getTokens(sql);
+        int depth = 0;
+        int subq = 0;
+        for(size_t i = 0; i < tl.size(); ++i) {
+            auto& t = tl.at(i);
+            if(t == "(") {
+                ++depth;
+                if((subq == 0) && (i + 1 < tl.size()) && (tl.at(i + 1) == "SELECT")) {
+                    subq = depth;
+                }
+                continue;
+            }
+            if(t == ")") {
+                if(depth == subq) {
+                    subq = 0;
+                }
+                --depth;
+                continue;
+            }
+            if((subq > 0) || !isIdChar(t.at(0))) {
+                continue;
+            }
+            rv.push_back(((i + 1 < tl.size()) && (tl.at(i + 1) == "(")) ? (t + "(") : t);
+        }
+        return rv;
+    }
+
+    /// \brief true if the parameter pname (e.g. ":ids") is the argument of sqlch_array() in sql
+    inline bool isArrayParam(const std::vector<std::string>& tl, const std::string& pname) {
+        for(size_t i = 0; i + 3 < tl.size(); ++i) {
+            if((tl.at(i) == "SQLCH_ARRAY") && (tl.at(i + 1) == "(") && (tl.at(i + 2) == pname) && (tl.at(i + 3) == ")")) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// \brief returns the part of a select from a top-level clause up to the next one, or an empty string
+    inline std::string getClause(const std::string& sql, const std::string& clause) {
+        auto spos = findClause(sql, clause);
+        if(spos == std::string::npos) {
+            return "";
+        }
+        spos += clause.length();
+        auto epos = sql.length();
+        for(auto& c : {"FROM", "WHERE", "GROUP BY", "HAVING", "WINDOW", "ORDER BY", "LIMIT"}) {
+            auto pos = findClause(sql.substr(spos), c);
+            if((pos != std::string::npos) && (spos + pos < epos)) {
+                epos = spos + pos;
+            }
+        }
+        return sql.substr(spos, epos - spos);
+    }
+
+    /// \brief true if the select list of a select calls an aggregate function, other than as a
+    /// window function or inside a subquery, so that without a GROUP BY it yields one row
+    inline bool isAggregate(const std::string& sql) {
+        if(hasClause(sql, "GROUP BY") || hasClause(sql, "UNION") || hasClause(sql, "INTERSECT") || hasClause(sql, "EXCEPT")) {
+            return false;
+        }
+        bool rv = false;
+        for(auto& w : getWords(getClause(sql, "SELECT"))) {
+            if((w == "OVER") || (w == "OVER(")) {
+                return false;
+            }
+            if((w == "COUNT(") || (w == "MIN(") || (w == "MAX(") || (w == "SUM(") || (w == "TOTAL(") || (w == "AVG(") || (w == "GROUP_CONCAT(")) {
+                rv = true;
+            }
+        }
+        return rv;
+    }
+
+    /// \brief ANDs pred to the top-level WHERE clause of a select, adding one if required
+    inline std::string addWhere(const std::string& sql, const std::string& pred) {
+        auto epos = sql.length();
+        for(auto& c : {"GROUP BY", "HAVING", "WINDOW", "ORDER BY", "LIMIT"}) {
+            auto pos = findClause(sql, c);
+            if(pos < epos) {
+                epos = pos;
+            }
+        }
+        auto head = sql.substr(0, epos);
+        auto tail = sql.substr(epos);
+        auto wpos = findClause(head, "WHERE");
+        if(wpos == std::string::npos) {
+            return head + " WHERE " + pred + " " + tail;
+        }
+        return head.substr(0, wpos) + "WHERE (" + head.substr(wpos + 5) + ") AND " + pred + " " + tail;
+    }
+
+    /// \brief stand-in for the sqlch_array table valued function of the generated code,
+    /// so that statements using it can be prepared by the Parser; it has no rows
+    struct ArrayCursor {
+        sqlite3_vtab_cursor base;
+    };
+
+    inline int arrayConnect(sqlite3* db, void*, int, const char* const*, sqlite3_vtab** vtab, char**) {
+        int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(value, ptr HIDDEN)");
+        if(rc == SQLITE_OK) {
+            *vtab = new sqlite3_vtab();
+        }
+        return rc;
+    }
+
+    inline int arrayBestIndex(sqlite3_vtab*, sqlite3_index_info* info) {
+        for(int i = 0; i < info->nConstraint; ++i) {
+            if((info->aConstraint[i].iColumn == 1) && (info->aConstraint[i].op == SQLITE_INDEX_CONSTRAINT_EQ) && info->aConstraint[i].usable) {
+                info->aConstraintUsage[i].argvIndex = 1;
+                info->aConstraintUsage[i].omit = 1;
+                info->idxNum = 1;
+                info->estimatedCost = 10;
+                info->estimatedRows = 10;
+                return SQLITE_OK;
+            }
+        }
+        info->estimatedCost = 1e12;
+        return SQLITE_OK;
+    }
+
+    inline int arrayDisconnect(sqlite3_vtab* vtab) {
+        delete vtab;
+        return SQLITE_OK;
+    }
+
+    inline int arrayOpen(sqlite3_vtab*, sqlite3_vtab_cursor** cur) {
+        *cur = &(new ArrayCursor())->base;
+        return SQLITE_OK;
+    }
+
+    inline int arrayClose(sqlite3_vtab_cursor* cur) {
+        delete reinterpret_cast<ArrayCursor*>(cur);
+        return SQLITE_OK;
+    }
+
+    inline int arrayFilter(sqlite3_vtab_cursor*, int, const char*, int, sqlite3_value**) { return SQLITE_OK; }
+    inline int arrayNext(sqlite3_vtab_cursor*) { return SQLITE_OK; }
+    inline int arrayEof(sqlite3_vtab_cursor*) { return 1; }
+    inline int arrayColumn(sqlite3_vtab_cursor*, sqlite3_context* ctx, int) {
+        sqlite3_result_null(ctx);
+        return SQLITE_OK;
+    }
+    inline int arrayRowid(sqlite3_vtab_cursor*, sqlite3_int64* rowid) {
+        *rowid = 0;
+        return SQLITE_OK;
+    }
+
+    inline sqlite3_module getArrayModule() {
+        sqlite3_module m{};
+        m.xConnect = arrayConnect;
+        m.xBestIndex = arrayBestIndex;
+        m.xDisconnect = arrayDisconnect;
+        m.xOpen = arrayOpen;
+        m.xClose = arrayClose;
+        m.xFilter = arrayFilter;
+        m.xNext = arrayNext;
+        m.xEof = arrayEof;
+        m.xColumn = arrayColumn;
+        m.xRowid = arrayRowid;
+        return m;
+    }
+
+    const sqlite3_module arrayModule = getArrayModule();
+
     struct Parser {
         Module& module;
         sqlite3* db;
@@ -229,6 +740,16 @@ namespace {
         std::string qname;
         std::string limit;
         std::string offset;
+        std::string cache;
+        std::string cdc;
+        std::string cardinality;
+        std::vector<std::string> paginate;
+        bool paginateDesc;
+        std::string parallel;
+        std::vector<std::string> readList;
+        bool upsert;
+        bool columnar;
+        bool arrow;
 
         inline int authcb(int actioncode, const std::string& p3, const std::string& /*p4*/, const std::string& /*p5*/, const std::string& /*p6*/) {
 #if SQLCH_TRACE
@@ -258,7 +779,10 @@ namespace {
                     primary_table = p3;
                 }
             } else if(actioncode == SQLITE_UPDATE) {
-                if(p3.substr(0,7) != "sqlite_") {
+                if((last_actioncode == SQLITE_INSERT) && (p3 == primary_table)) {
+                    // INSERT ... ON CONFLICT DO UPDATE
+                    upsert = true;
+                } else if(p3.substr(0,7) != "sqlite_") {
                     assert((last_actioncode == 0) || (last_actioncode == actioncode));
                     last_actioncode = actioncode;
                     primary_table = p3;
@@ -270,10 +794,19 @@ namespace {
                     primary_table = p3;
                 }
             } else if(actioncode == SQLITE_SELECT) {
-                assert(last_actioncode == 0);
-                last_actioncode = actioncode;
+                // subqueries, including IN sqlch_array(...), report a SELECT of their own
+                if(last_actioncode == 0) {
+                    last_actioncode = actioncode;
+                }
             } else if(actioncode == SQLITE_READ) {
-                // no-op
+                if((p3.length() > 0) && (p3.substr(0,7) != "sqlite_") && (p3 != "sqlch_array")) {
+                    for(auto& r : readList) {
+                        if(r == p3) {
+                            return SQLITE_OK;
+                        }
+                    }
+                    readList.push_back(p3);
+                }
             } else if(actioncode == SQLITE_PRAGMA) {
                 // no-op
             } else if(actioncode == SQLITE_FUNCTION) {
@@ -313,8 +846,8 @@ namespace {
         inline bool addVariableByMap(Statement& s, const std::string& v) const {
             auto vit = nmap.find(v);
             if(vit != nmap.end()) {
-                auto& ctype = vit->second;
-                s.addVariable(v, ctype, ctype);
+                auto& ntype = vit->second;
+                s.addVariable(v, module.storeType(ntype), ntype);
                 return true;
             }
             return false;
@@ -357,6 +890,11 @@ namespace {
                         return;
                     }
                 }
+                for(auto& t : s.readList) {
+                    if(addVariableByTable(s, t, v, true) || addVariableByTable(s, t, v, false)) {
+                        return;
+                    }
+                }
                 std::cout << "Error:Unable to get type for select-variable:" << v << std::endl;
                 exit(1);
             }
@@ -368,16 +906,30 @@ namespace {
         }
 
         inline void setColumnInfo(Statement& s);
+        inline void setForeignKeys(Statement& s);
+        inline std::vector<std::string> explain(const std::string& sql);
+        inline bool isUniqueLookup(const Statement& s);
+        inline bool isUniqueKey(const Statement& s);
+        inline Cardinality getCardinality(const Statement& s, const std::string& sql);
 
         inline Parser(Module& m)
             : module(m)
             , db(nullptr)
-            , last_actioncode(0) {
+            , last_actioncode(0)
+            , paginateDesc(false)
+            , upsert(false)
+            , columnar(false)
+            , arrow(false) {
             int rv = ::sqlite3_open_v2(":memory:", &db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, 0);
             if(rv != SQLITE_OK) {
                 std::cout << "Error:Unable to open in-memory Parser" << std::endl;
                 exit(1);
             }
+            rv = sqlite3_create_module(db, "sqlch_array", &arrayModule, nullptr);
+            if(rv != SQLITE_OK) {
+                std::cout << "Error:Unable to register sqlch_array:" << error(db) << std::endl;
+                exit(1);
+            }
             rv = sqlite3_set_authorizer(db, authcb, this);
             if(rv != SQLITE_OK) {
                 std::cout << "Error:Unable to set authorization callback:" << error(db) << std::endl;
@@ -388,6 +940,10 @@ namespace {
             cmap["VARCHAR"] = "std::string";
             cmap["TEXT"] = "std::string";
             cmap["JSON"] = "std::string";
+            cmap["REAL"] = "double";
+            cmap["FLOAT"] = "double";
+            cmap["DOUBLE"] = "double";
+            cmap["BLOB"] = "std::vector<uint8_t>";
         }
 
         inline ~Parser() {
@@ -403,6 +959,16 @@ namespace {
             qname = "";
             limit = "";
             offset = "";
+            cache = "";
+            cdc = "";
+            cardinality = "";
+            paginate.clear();
+            paginateDesc = false;
+            parallel = "";
+            readList.clear();
+            upsert = false;
+            columnar = false;
+            arrow = false;
         }
     };
 
@@ -464,10 +1030,242 @@ namespace {
             int ispk = sqlite3_column_int(cursor.stmt, 5);
             auto ctype = getType(stype);
             auto ntype = getNativeType(cname, ctype);
+            if(module.isChrono(ntype) && (ctype != "int64_t")) {
+                std::cout << "Error:VTYPE " << ntype << " of column " << s.tname << "." << cname << " is stored as a count, the column must be INTEGER, not " << stype << std::endl;
+                exit(1);
+            }
+            if(ctype == "std::vector<uint8_t>") {
+                // blobs are bound and read as their native type, without a copy through a vector
+                ctype = ntype;
+            }
             s.addColumn(s.tname, cname, stype, ctype, ntype, (ispk != 0));
         }
     }
 
+    inline void Parser::setForeignKeys(Statement& s) {
+        Cursor cursor(*this);
+        cursor.open("PRAGMA foreign_key_list('" + s.tname + "')");
+        std::map<int, int> ccount;
+        while(cursor.next()) {
+            ++ccount[sqlite3_column_int(cursor.stmt, 0)];
+        }
+        Cursor fcursor(*this);
+        fcursor.open("PRAGMA foreign_key_list('" + s.tname + "')");
+        while(fcursor.next()) {
+            // composite keys are not loaded
+            if(ccount[sqlite3_column_int(fcursor.stmt, 0)] != 1) {
+                continue;
+            }
+            std::string table = (const char*)sqlite3_column_text(fcursor.stmt, 2);
+            std::string from = (const char*)sqlite3_column_text(fcursor.stmt, 3);
+            auto tx = (const char*)sqlite3_column_text(fcursor.stmt, 4);
+            std::string to = (tx != nullptr) ? tx : "";
+            s.fkList.emplace_back(table, from, to);
+        }
+    }
+
+    /// \brief returns the detail column of the query plan for sql
+    inline std::vector<std::string> Parser::explain(const std::string& sql) {
+        // the authorizer sees the EXPLAIN as a fresh select, so save and restore its state
+        auto ac = last_actioncode;
+        auto pt = primary_table;
+        auto rl = readList;
+        last_actioncode = 0;
+        std::vector<std::string> rv;
+        {
+            Cursor cursor(*this);
+            cursor.open("EXPLAIN QUERY PLAN " + sql);
+            while(cursor.next()) {
+                rv.push_back((const char*)sqlite3_column_text(cursor.stmt, 3));
+            }
+        }
+        last_actioncode = ac;
+        primary_table = pt;
+        readList = rl;
+        return rv;
+    }
+
+    /// \brief true if the plan of a select is a single equality seek on a primary key or unique index
+    inline bool Parser::isUniqueLookup(const Statement& s) {
+        // the plan shows "(a=?)" for "a IN (?,?)" and for "a=? OR a=?" alike
+        for(auto& w : getWords(getClause(s.sqls, "WHERE"))) {
+            if((w == "IN") || (w == "IN(") || (w == "OR") || (w == "OR(")) {
+                return false;
+            }
+        }
+
+        std::string seek;
+        for(auto& d : explain(s.sqls)) {
+            if(d.substr(0, 5) == "SCAN ") {
+                return false;
+            }
+            if(d.substr(0, 7) == "SEARCH ") {
+                if(seek.length() > 0) {
+                    return false;
+                }
+                seek = d;
+            }
+        }
+
+        auto upos = seek.find(" USING ");
+        if(upos == std::string::npos) {
+            return false;
+        }
+        auto using_ = seek.substr(upos + 7);
+        if(using_ == "INTEGER PRIMARY KEY (rowid=?)") {
+            return true;
+        }
+
+        // count the equality terms in the "(a=? AND b=?)" suffix
+        auto ppos = using_.find(" (");
+        if((ppos == std::string::npos) || (using_.back() != ')')) {
+            return false;
+        }
+        auto terms = using_.substr(ppos + 2, using_.length() - ppos - 3);
+        size_t eqc = 0;
+        size_t tpos = 0;
+        while(tpos < terms.length()) {
+            auto epos = terms.find(" AND ", tpos);
+            if(epos == std::string::npos) {
+                epos = terms.length();
+            }
+            auto term = terms.substr(tpos, epos - tpos);
+            if((term.length() < 2) || (term.substr(term.length() - 2) != "=?")) {
+                return false;
+            }
+            ++eqc;
+            tpos = epos + 5;
+        }
+
+        auto iname = using_.substr(0, ppos);
+        if(iname == "PRIMARY KEY") {
+            size_t pkc = 0;
+            for(auto& c : module.getCreateStatement(s.tname).colList) {
+                if(c.is_pk) {
+                    ++pkc;
+                }
+            }
+            return (eqc >= pkc);
+        }
+        if(iname.substr(0, 15) == "COVERING INDEX ") {
+            iname = iname.substr(15);
+        } else if(iname.substr(0, 6) == "INDEX ") {
+            iname = iname.substr(6);
+        } else {
+            return false;
+        }
+
+        bool isUnique = false;
+        {
+            Cursor cursor(*this);
+            cursor.open("PRAGMA index_list('" + s.tname + "')");
+            while(cursor.next()) {
+                std::string n = (const char*)sqlite3_column_text(cursor.stmt, 1);
+                if((n == iname) && (sqlite3_column_int(cursor.stmt, 2) != 0) && (sqlite3_column_int(cursor.stmt, 4) == 0)) {
+                    isUnique = true;
+                }
+            }
+        }
+        if(!isUnique) {
+            return false;
+        }
+
+        size_t icc = 0;
+        Cursor cursor(*this);
+        cursor.open("PRAGMA index_info('" + iname + "')");
+        while(cursor.next()) {
+            ++icc;
+        }
+        return (eqc >= icc);
+    }
+
+    /// \brief checks whether the PAGINATE columns cover the primary key or a unique index of a selected table
+    /// a key that is not unique would skip the rows sharing the value at a page boundary
+    inline bool Parser::isUniqueKey(const Statement& s) {
+        std::map<std::string, std::set<std::string>> keys;
+        for(auto& i : s.pageCols) {
+            auto& c = s.colList.at(i);
+            if(c.tname.length() > 0) {
+                keys[c.tname].insert(c.cname);
+            }
+        }
+        for(auto& k : keys) {
+            size_t pkc = 0;
+            size_t pkm = 0;
+            for(auto& c : module.getCreateStatement(k.first).colList) {
+                if(c.is_pk) {
+                    ++pkc;
+                    if(k.second.count(c.cname) > 0) {
+                        ++pkm;
+                    }
+                }
+            }
+            if((pkc > 0) && (pkm == pkc)) {
+                return true;
+            }
+
+            std::vector<std::string> ilist;
+            {
+                Cursor cursor(*this);
+                cursor.open("PRAGMA index_list('" + k.first + "')");
+                while(cursor.next()) {
+                    if((sqlite3_column_int(cursor.stmt, 2) != 0) && (sqlite3_column_int(cursor.stmt, 4) == 0)) {
+                        ilist.push_back((const char*)sqlite3_column_text(cursor.stmt, 1));
+                    }
+                }
+            }
+            for(auto& iname : ilist) {
+                bool covered = true;
+                Cursor cursor(*this);
+                cursor.open("PRAGMA index_info('" + iname + "')");
+                while(cursor.next()) {
+                    auto cn = (const char*)sqlite3_column_text(cursor.stmt, 2);
+                    if((cn == nullptr) || (k.second.count(cn) == 0)) {
+                        covered = false;
+                    }
+                }
+                if(covered) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /// \brief returns the cardinality set by metacommand, or detects it from the statement
+    inline Cardinality Parser::getCardinality(const Statement& s, const std::string& sql) {
+        if(cardinality == "MANY") {
+            return Cardinality::Many;
+        }
+        if(cardinality == "ONE") {
+            return Cardinality::One;
+        }
+        if(cardinality == "SCALAR") {
+            if(s.colList.size() != 1) {
+                std::cout << "Error:SCALAR select must return exactly one column:" << sql << std::endl;
+                exit(1);
+            }
+            return Cardinality::Scalar;
+        }
+        if(cardinality == "EXISTS") {
+            return Cardinality::Exists;
+        }
+
+        // a single aggregate column without a GROUP BY yields exactly one value
+        if((s.colList.size() == 1) && (s.colList.at(0).tname.length() == 0) && isAggregate(sql)) {
+            return Cardinality::Scalar;
+        }
+        for(auto& v : s.varList) {
+            if(v.isArray) {
+                return Cardinality::Many;
+            }
+        }
+        if((s.sname != "+") && isUniqueLookup(s)) {
+            return Cardinality::One;
+        }
+        return Cardinality::Many;
+    }
+
     inline void Statement::finalize(const std::string& qname) {
         auto n = qname;
         if(n.length() == 0) {
@@ -578,14 +1376,32 @@ namespace {
             auto n = tokList.at(1);
             auto& et = parser.module.addEnumType(n);
             size_t idx = 2;
-            if(tokList.at(idx) != "(") {
+            if((idx == tokList.size()) || (tokList.at(idx) != "(")) {
+                std::cout << "Error:Expected ( after ENUM " << n << std::endl;
+                exit(1);
             }
             ++idx;
             while((idx < tokList.size()) && (tokList.at(idx) != ")")) {
-                et.valueList.push_back(tokList.at(idx));
-                ++idx;
+                if(tokList.at(idx) != ",") {
+                    if(std::find(et.valueList.begin(), et.valueList.end(), tokList.at(idx)) != et.valueList.end()) {
+                        std::cout << "Error:Duplicate value in ENUM " << n << ":" << tokList.at(idx) << std::endl;
+                        exit(1);
+                    }
+                    et.valueList.push_back(tokList.at(idx));
+                }
+                ++idx;
             }
             if(idx == tokList.size()) {
+                std::cout << "Error:Expected ) after values of ENUM " << n << std::endl;
+                exit(1);
+            }
+            ++idx;
+            if(idx < tokList.size()) {
+                if(upper(tokList.at(idx)) != "INTEGER") {
+                    std::cout << "Error:Unknown storage for ENUM " << n << ":" << tokList.at(idx) << std::endl;
+                    exit(1);
+                }
+                et.isInteger = true;
             }
             return true;
         }
@@ -624,6 +1440,66 @@ namespace {
             parser.offset = ":" + tokList.at(1);
             return true;
         }
+        if((tokList.at(0) == "ONE") || (tokList.at(0) == "SCALAR") || (tokList.at(0) == "EXISTS") || (tokList.at(0) == "MANY")) {
+            parser.cardinality = tokList.at(0);
+            return true;
+        }
+        if(tokList.at(0) == "PAGINATE") {
+            // PAGINATE BY a, t.b [ASC|DESC]
+            if((tokList.size() < 3) || (tokList.at(1) != "BY")) {
+                std::cout << "Error:Invalid PAGINATE, expected PAGINATE BY <columns>" << std::endl;
+                exit(1);
+            }
+            std::string k;
+            for(size_t i = 2; i < tokList.size(); ++i) {
+                auto& t = tokList.at(i);
+                if((i == (tokList.size() - 1)) && ((upper(t) == "ASC") || (upper(t) == "DESC"))) {
+                    parser.paginateDesc = (upper(t) == "DESC");
+                } else if(t == ",") {
+                    parser.paginate.push_back(k);
+                    k = "";
+                } else {
+                    k += t;
+                }
+            }
+            if(k.length() > 0) {
+                parser.paginate.push_back(k);
+            }
+            return true;
+        }
+        if(tokList.at(0) == "PARALLEL") {
+            // PARALLEL [BY <integer key>]
+            parser.parallel = "rowid";
+            if((tokList.size() > 2) && (tokList.at(1) == "BY")) {
+                parser.parallel = "";
+                for(size_t i = 2; i < tokList.size(); ++i) {
+                    parser.parallel += tokList.at(i);
+                }
+            }
+            return true;
+        }
+        if(tokList.at(0) == "ARROW") {
+            parser.arrow = true;
+            return true;
+        }
+        if(tokList.at(0) == "COLUMNAR") {
+            parser.columnar = true;
+            return true;
+        }
+        if(tokList.at(0) == "CDC") {
+            parser.cdc = "4096";
+            if(tokList.size() > 1) {
+                parser.cdc = tokList.at(1);
+            }
+            return true;
+        }
+        if(tokList.at(0) == "CACHE") {
+            parser.cache = "64";
+            if(tokList.size() > 1) {
+                parser.cache = tokList.at(1);
+            }
+            return true;
+        }
         if(tokList.at(0) == "DEFINE") {
             if(tokList.at(1) == "DATABASE") {
                 parser.module.addDatabase(tokList.at(2));
@@ -631,8 +1507,39 @@ namespace {
             if(tokList.at(1) == "INTERFACE") {
                 parser.module.db().addInterface(parser.module, false, tokList.at(2));
             }
+            if(tokList.at(1) == "PROCEDURE") {
+                parser.module.db().addInterface(parser.module, false, tokList.at(2)).isProc = true;
+            }
             return true;
         }
+        if(tokList.at(0) == "CALL") {
+            // CALL [interface.]qname, copies a statement defined earlier into the procedure
+            auto& proc = parser.module.db().iface();
+            if(!proc.isProc) {
+                std::cout << "Error:CALL can only be used in a PROCEDURE" << std::endl;
+                exit(1);
+            }
+            std::string iname;
+            auto qname = tokList.at(1);
+            if((tokList.size() > 3) && (tokList.at(2) == ".")) {
+                iname = qname;
+                qname = tokList.at(3);
+            }
+            for(auto& iface : parser.module.db().interfaceList) {
+                if((&iface == &proc) || ((iname.length() > 0) && (iface.name != iname))) {
+                    continue;
+                }
+                for(auto& st : iface.stmtList) {
+                    if(st.qname() == qname) {
+                        proc.stmtList.push_back(st);
+                        proc.stmtList.back().isCalled = true;
+                        return true;
+                    }
+                }
+            }
+            std::cout << "Error:Unknown statement in CALL:" << qname << std::endl;
+            exit(1);
+        }
         if(tokList.at(0) == "END") {
             return true;
         }
@@ -645,6 +1552,294 @@ namespace {
         return true;
     }
 
+    /// \brief rewrites a select into the keyset form used by PAGINATE
+    /// the first page is the select ordered by the key, the next pages add a
+    /// (keys) > (last keys) seek to the WHERE clause, both are limited by :sqlch_limit
+    inline void setPagination(Parser& parser, Statement& s) {
+        auto sql = s.sqls;
+        while((sql.length() > 0) && ::isspace(static_cast<unsigned char>(sql.back()))) {
+            sql.pop_back();
+        }
+        if((s.action != SQLITE_SELECT) || (s.cardinality != Cardinality::Many)) {
+            std::cout << "Error:PAGINATE can only be used on a select returning rows:" << sql << std::endl;
+            exit(1);
+        }
+        for(auto& c : {"LIMIT", "GROUP BY", "UNION", "EXCEPT", "INTERSECT"}) {
+            if(hasClause(sql, c)) {
+                std::cout << "Error:PAGINATE cannot be used on a select with " << c << ":" << sql << std::endl;
+                exit(1);
+            }
+        }
+
+        s.pageList = parser.paginate;
+        s.pageDesc = parser.paginateDesc;
+        std::string keys;
+        std::string sep;
+        for(auto& k : s.pageList) {
+            auto cname = k.substr(k.find_last_of('.') + 1);
+            size_t idx = 0;
+            while((idx < s.colList.size()) && (s.colList.at(idx).cname != cname)) {
+                ++idx;
+            }
+            if(idx == s.colList.size()) {
+                std::cout << "Error:PAGINATE column must be selected:" << k << std::endl;
+                exit(1);
+            }
+            s.pageCols.push_back(idx);
+            keys += sep + k;
+            sep = ", ";
+        }
+        if(!parser.isUniqueKey(s)) {
+            std::cout << "Error:PAGINATE columns must include the primary key or a unique index:" << keys << std::endl;
+            exit(1);
+        }
+
+        // an existing ORDER BY must be the key order, it is replaced by the generated one
+        auto opos = findClause(sql, "ORDER BY");
+        if(opos != std::string::npos) {
+            std::string ob;
+            for(auto& c : sql.substr(opos + 8)) {
+                if(!::isspace(static_cast<unsigned char>(c))) {
+                    ob += static_cast<char>(::toupper(c));
+                }
+            }
+            std::string plain;
+            std::string dir;
+            sep = "";
+            for(auto& k : s.pageList) {
+                plain += sep + upper(k);
+                dir += sep + upper(k) + (s.pageDesc ? "DESC" : "ASC");
+                sep = ",";
+            }
+            if((ob != dir) && ((ob != plain) || s.pageDesc)) {
+                std::cout << "Error:ORDER BY does not match the PAGINATE columns:" << sql << std::endl;
+                exit(1);
+            }
+            sql = sql.substr(0, opos);
+            while((sql.length() > 0) && ::isspace(static_cast<unsigned char>(sql.back()))) {
+                sql.pop_back();
+            }
+        }
+
+        std::string order = " ORDER BY ";
+        std::string lhs;
+        std::string rhs;
+        sep = "";
+        for(size_t i = 0; i < s.pageList.size(); ++i) {
+            order += sep + s.pageList.at(i) + (s.pageDesc ? " DESC" : "");
+            lhs += sep + s.pageList.at(i);
+            rhs += sep + ":sqlch_k" + std::to_string(i);
+            sep = ", ";
+        }
+        if(s.pageList.size() > 1) {
+            lhs = "(" + lhs + ")";
+            rhs = "(" + rhs + ")";
+        }
+        auto seek = lhs + (s.pageDesc ? " < " : " > ") + rhs;
+        order += " LIMIT :sqlch_limit";
+
+        s.pageFirst = sql + order;
+        s.pageNext = addWhere(sql, seek) + order;
+        while((s.pageFirst.length() % 8) != 0) {
+            s.pageFirst += " ";
+        }
+        while((s.pageNext.length() % 8) != 0) {
+            s.pageNext += " ";
+        }
+
+        // validates both queries, and warns if the next page cannot seek
+        parser.explain(s.pageFirst);
+        for(auto& d : parser.explain(s.pageNext)) {
+            if(d.find("USE TEMP B-TREE FOR ORDER BY") != std::string::npos) {
+                std::cout << "Warning:PAGINATE BY " << keys << " is not backed by an index, pages will be sorted:" << sql << std::endl;
+            }
+        }
+    }
+
+    /// \brief rewrites a select into the range-restricted form used by PARALLEL
+    /// each partition binds its own [:sqlch_lo, :sqlch_hi] range of the integer key
+    inline void setParallel(Parser& parser, Statement& s) {
+        auto sql = s.sqls;
+        while((sql.length() > 0) && ::isspace(static_cast<unsigned char>(sql.back()))) {
+            sql.pop_back();
+        }
+        if((s.action != SQLITE_SELECT) || (s.cardinality != Cardinality::Many)) {
+            std::cout << "Error:PARALLEL can only be used on a select returning rows:" << sql << std::endl;
+            exit(1);
+        }
+        for(auto& c : {"LIMIT", "GROUP BY", "UNION", "EXCEPT", "INTERSECT"}) {
+            if(hasClause(sql, c)) {
+                std::cout << "Error:PARALLEL cannot be used on a select with " << c << ":" << sql << std::endl;
+                exit(1);
+            }
+        }
+        if(s.tname.length() == 0) {
+            std::cout << "Error:PARALLEL select must read a table:" << sql << std::endl;
+            exit(1);
+        }
+
+        // the key is qualified with the primary table unless given as alias.column
+        auto key = parser.parallel;
+        auto kcol = key.substr(key.find_last_of('.') + 1);
+        if(key.find('.') == std::string::npos) {
+            key = s.tname + "." + key;
+        }
+        s.partKey = key;
+        s.partRange = "SELECT MIN(" + kcol + "), MAX(" + kcol + ") FROM " + s.tname;
+        s.partSql = addWhere(sql, key + " BETWEEN :sqlch_lo AND :sqlch_hi");
+        while((s.partSql.length() % 8) != 0) {
+            s.partSql += " ";
+        }
+        while((s.partRange.length() % 8) != 0) {
+            s.partRange += " ";
+        }
+
+        // partitions are scanned in key order, so only an ORDER BY other than the key needs a merge
+        auto opos = findClause(sql, "ORDER BY");
+        if(opos != std::string::npos) {
+            auto ob = sql.substr(opos + 8);
+            if(ob.find('(') != std::string::npos) {
+                std::cout << "Error:PARALLEL supports ORDER BY on selected columns only:" << sql << std::endl;
+                exit(1);
+            }
+            std::vector<std::pair<size_t, bool> > order;
+            size_t pos = 0;
+            while(pos <= ob.length()) {
+                auto cpos = ob.find(',', pos);
+                if(cpos == std::string::npos) {
+                    cpos = ob.length();
+                }
+                std::istringstream is(ob.substr(pos, cpos - pos));
+                std::string item;
+                std::string dir;
+                std::string extra;
+                is >> item >> dir >> extra;
+                dir = upper(dir);
+                if((item.length() == 0) || (extra.length() > 0) || ((dir.length() > 0) && (dir != "ASC") && (dir != "DESC"))) {
+                    std::cout << "Error:PARALLEL supports ORDER BY on selected columns only:" << sql << std::endl;
+                    exit(1);
+                }
+                auto cname = item.substr(item.find_last_of('.') + 1);
+                size_t idx = 0;
+                while((idx < s.colList.size()) && (s.colList.at(idx).cname != cname)) {
+                    ++idx;
+                }
+                if(idx == s.colList.size()) {
+                    std::cout << "Error:PARALLEL ORDER BY column must be selected:" << item << std::endl;
+                    exit(1);
+                }
+                order.push_back(std::make_pair(idx, (dir == "DESC")));
+                pos = cpos + 1;
+            }
+
+            auto& c = s.colList.at(order.front().first);
+            size_t pkc = 0;
+            for(auto& pc : parser.module.getCreateStatement(s.tname).colList) {
+                if(pc.is_pk) {
+                    ++pkc;
+                }
+            }
+            auto isRowid = (c.is_pk && (pkc == 1) && (upper(c.stype) == "INTEGER") && (c.tname == s.tname));
+            auto isKey = ((c.cname == kcol) || ((kcol == "rowid") && isRowid));
+            if((order.size() > 1) || order.front().second || !isKey) {
+                s.partOrder = order;
+            }
+        }
+
+        // validates both queries
+        parser.explain(s.partRange);
+        parser.explain(s.partSql);
+    }
+
+    /// \brief true if an INSERT adds at most one row, from a single VALUES tuple or DEFAULT VALUES
+    inline bool isSingleRowInsert(const std::string& sql) {
+        auto pos = findClause(sql, "VALUES");
+        if((pos == std::string::npos) || hasClause(sql, "SELECT")) {
+            return false;
+        }
+        auto tail = sql.substr(pos);
+        for(auto& c : {"ON CONFLICT", "RETURNING"}) {
+            auto e = findClause(tail, c);
+            if(e != std::string::npos) {
+                tail = tail.substr(0, e);
+            }
+        }
+        return (findClause(tail, ",") == std::string::npos);
+    }
+
+    /// \brief FNV-1a hash of an enum name, perturbed by seed
+    inline uint32_t enumHash(const uint32_t& seed, const std::string& s) {
+        uint32_t h = 2166136261u ^ seed;
+        for(auto& c : s) {
+            h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+        }
+        return h;
+    }
+
+    /// \brief finds the smallest power of 2 table and a seed that hash all names without collisions
+    inline uint32_t getEnumTable(const std::vector<std::string>& names, uint32_t& seed) {
+        uint32_t tsize = 1;
+        while(tsize < names.size()) {
+            tsize *= 2;
+        }
+        while(true) {
+            for(seed = 0; seed < 4096; ++seed) {
+                std::vector<bool> used(tsize, false);
+                bool ok = true;
+                for(auto& n : names) {
+                    auto i = enumHash(seed, n) & (tsize - 1);
+                    if(used.at(i)) {
+                        ok = false;
+                        break;
+                    }
+                    used.at(i) = true;
+                }
+                if(ok) {
+                    return tsize;
+                }
+            }
+            tsize *= 2;
+        }
+    }
+
+    /// \brief appends a CHECK constraint on the valid values of each ENUM column to a CREATE TABLE
+    inline void setEnumChecks(Parser& parser, Statement& s, const std::string& sql) {
+        std::string checks;
+        for(auto& c : s.colList) {
+            auto et = parser.module.getEnumType(c.ntype);
+            if(et == nullptr) {
+                continue;
+            }
+            if(et->isInteger && (c.ctype != "int64_t")) {
+                std::cout << "Error:ENUM " << et->name << " is stored as INTEGER, column " << s.tname << "." << c.cname << " is " << c.stype << std::endl;
+                exit(1);
+            }
+            if((c.ctype != "int64_t") && (c.ctype != "std::string")) {
+                continue;
+            }
+            checks += ", CHECK(" + c.cname + " IN (";
+            std::string sep;
+            for(size_t i = 0; i < et->valueList.size(); ++i) {
+                checks += sep + ((c.ctype == "int64_t") ? std::to_string(i) : ("'" + et->valueList.at(i) + "'"));
+                sep = ", ";
+            }
+            checks += "))";
+        }
+        if(checks.size() == 0) {
+            return;
+        }
+        // the end of the column definitions, whatever follows them
+        auto pos = findClose(sql);
+        if(pos == std::string::npos) {
+            std::cout << "Error:Unable to find the end of the columns of " << s.tname << std::endl;
+            exit(1);
+        }
+        s.sqls = sql.substr(0, pos) + checks + sql.substr(pos);
+        while((s.sqls.length() % 8) != 0) {
+            s.sqls += " ";
+        }
+    }
+
     inline void processSqlStatement(Parser& parser, const std::string& sql) {
 #if SQLCH_TRACE
         std::cout << "processStatement:" << sql << std::endl;
@@ -656,6 +1851,11 @@ namespace {
             auto& s = parser.module.db().db().addStatement(parser.last_actioncode, sql);
             s.tname = parser.primary_table;
             parser.setColumnInfo(s);
+            parser.setForeignKeys(s);
+            setEnumChecks(parser, s, sql);
+            if(parser.cdc.length() > 0) {
+                s.cdcSize = std::stoul(parser.cdc);
+            }
             parser.module.finalize(s, parser.qname);
             parser.reset();
         } else if(parser.last_actioncode == SQLITE_CREATE_INDEX) {
@@ -665,6 +1865,10 @@ namespace {
             parser.module.finalize(s, parser.qname);
             parser.reset();
         } else if(parser.last_actioncode != 0) {
+            if(parser.cdc.length() > 0) {
+                std::cout << "Error:CDC can only be used on a CREATE TABLE:" << sql << std::endl;
+                exit(1);
+            }
             auto& s = parser.module.db().iface().addStatement(parser.last_actioncode, sql);
             s.tname = parser.primary_table;
 
@@ -680,8 +1884,15 @@ namespace {
                 auto cit = parser.nmap.find(cn);
                 if(cit != parser.nmap.end()) {
                     auto ntype = cit->second;
-                    s.addColumn(t, c, ntype, ntype, ntype, false);
-                }else {
+                    s.addColumn(t, c, ntype, parser.module.storeType(ntype), ntype, false);
+                } else if(t.length() == 0) {
+                    // expression column, only counts (or columns of an EXISTS) can be typed without a VTYPE
+                    if((upper(cn).substr(0, 6) != "COUNT(") && (parser.cardinality != "EXISTS")) {
+                        std::cout << "Error:Unable to get type for expression column:" << cn << ", use VTYPE" << std::endl;
+                        exit(1);
+                    }
+                    s.addColumn(t, c, "INTEGER", "int64_t", "int64_t", false);
+                } else {
                     auto& col = parser.module.getColumnInfo(t, cn);
                     s.addColumn(t, c, col.stype, col.ctype, col.ntype, col.is_pk);
                 }
@@ -690,7 +1901,9 @@ namespace {
                 }
 
                 std::string dt = parser.module.db().db().name + "::" + t;
-                if(s.sname.size() == 0) {
+                if(t.length() == 0) {
+                    s.sname = "+";
+                } else if(s.sname.size() == 0) {
                     s.sname = dt;
                 } else {
                     if((s.sname != dt) && (s.sname != "+")) {
@@ -699,11 +1912,66 @@ namespace {
                 }
             }
 
+            s.readList = parser.readList;
+            if((s.tname.size() == 0) && (s.readList.size() > 0)) {
+                s.tname = s.readList.front();
+            }
+
+            auto tokList = getTokens(sql);
             int vc = sqlite3_bind_parameter_count(cursor.stmt);
             for(int i = 0; i < vc; ++i) {
-                std::string n = sqlite3_bind_parameter_name(cursor.stmt, i + 1);
-                n = n.substr(1); // skip past the initial ":"
+                std::string pname = sqlite3_bind_parameter_name(cursor.stmt, i + 1);
+                auto n = pname.substr(1); // skip past the initial ":"
                 parser.addVariable(s, n);
+                if(isArrayParam(tokList, pname)) {
+                    // the variable is typed as an element, and bound as a list of them
+                    auto& v = s.varList.back();
+                    v.ntype = "std::vector<" + v.ntype + ">";
+                    v.ctype = parser.module.generateBaseNS + "::array_ref";
+                    v.isArray = true;
+                }
+            }
+
+            s.isUpsert = (parser.upsert || ((s.action == SQLITE_INSERT) && hasClause(sql, "ON CONFLICT")));
+            if(s.action == SQLITE_SELECT) {
+                s.cardinality = parser.getCardinality(s, sql);
+            } else if(s.colList.size() > 0) {
+                // a write with a RETURNING clause is generated like a select
+                if(parser.cardinality.length() > 0) {
+                    s.cardinality = parser.getCardinality(s, sql);
+                } else if((s.action == SQLITE_INSERT) && isSingleRowInsert(sql)) {
+                    s.cardinality = Cardinality::One;
+                }
+            } else if(parser.cardinality.length() > 0) {
+                std::cout << "Error:" << parser.cardinality << " can only be used on a select or a RETURNING clause:" << sql << std::endl;
+                exit(1);
+            }
+            if(parser.paginate.size() > 0) {
+                setPagination(parser, s);
+            }
+            if(parser.parallel.length() > 0) {
+                setParallel(parser, s);
+            }
+            if(parser.cache.length() > 0) {
+                if(s.action != SQLITE_SELECT) {
+                    std::cout << "Error:CACHE can only be used on a select:" << sql << std::endl;
+                    exit(1);
+                }
+                s.cacheSize = std::stoul(parser.cache);
+            }
+            if(parser.columnar) {
+                if((s.action != SQLITE_SELECT) || (s.cardinality != Cardinality::Many)) {
+                    std::cout << "Error:COLUMNAR can only be used on a select returning rows:" << sql << std::endl;
+                    exit(1);
+                }
+                s.isColumnar = true;
+            }
+            if(parser.arrow) {
+                if((s.action != SQLITE_SELECT) || (s.cardinality != Cardinality::Many)) {
+                    std::cout << "Error:ARROW can only be used on a select returning rows:" << sql << std::endl;
+                    exit(1);
+                }
+                s.isArrow = true;
             }
 
             parser.module.finalize(s, parser.qname);
@@ -1012,6 +2280,13 @@ namespace {
         of_src << std::endl;
     }
 
+    inline void Interface::generateInvalidate(const Statement& stmt, std::ostream& of_src) const {
+        if(db.hasCache()) {
+            of_src << "  ++db." << stmt.tname << "_ver_;" << std::endl;
+            of_src << "  db." << stmt.tname << "_dirty_ = true;" << std::endl;
+        }
+    }
+
     inline void Interface::generateCreateTable(const Statement& stmt, std::ostream& of_hdr) const {
         of_hdr << "      struct " << stmt.tname << " {" << std::endl;
         for(auto& c : stmt.colList) {
@@ -1050,22 +2325,29 @@ namespace {
         of_src << ") {" << std::endl;
         of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
         for(auto& v : stmt.varList) {
-            auto ctype = "static_cast<" + v.ctype + ">";
-            if(v.ntype == v.ctype) {
-                ctype = "";
-            }
+            auto ctype = module.storeCast(v.ctype, v.ntype);
             of_src << "  " << stmt.qname() << "_.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << "));" << std::endl;
         }
-        of_src << "  return " << stmt.qname() << "_.insert();" << std::endl;
+        if(!db.hasCache()) {
+            of_src << "  return " << stmt.qname() << "_.insert();" << std::endl;
+        } else if(module.isAutoIncrement) {
+            of_src << "  auto rv = " << stmt.qname() << "_.insert();" << std::endl;
+            generateInvalidate(stmt, of_src);
+            of_src << "  return rv;" << std::endl;
+        } else {
+            of_src << "  " << stmt.qname() << "_.insert();" << std::endl;
+            generateInvalidate(stmt, of_src);
+        }
         of_src << "}" << std::endl;
         of_src << std::endl;
     }
 
-    inline void Interface::generateDelete(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+    inline void Interface::generateUpsert(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
         std::string sep;
+        auto rtype = module.generateBaseNS + "::upsert_result";
 
         of_hdr << "    " << module.generateBaseNS << "::exstatement " << stmt.qname() << "_;" << std::endl;
-        of_hdr << "    void " << stmt.qname() << "(";
+        of_hdr << "    " << rtype << " " << stmt.qname() << "(";
         for(auto& v : stmt.varList) {
             of_hdr << sep << "const " << v.ntype << "& " << v.name;
             sep = ", ";
@@ -1075,7 +2357,7 @@ namespace {
 
         auto fqname = ns + name + "::" + stmt.qname();
         sep = "";
-        of_src << "void " << fqname << "(";
+        of_src << rtype << " " << fqname << "(";
         for(auto& v : stmt.varList) {
             of_src << sep << "const " << v.ntype << "& " << v.name;
             sep = ", ";
@@ -1083,50 +2365,21 @@ namespace {
         of_src << ") {" << std::endl;
         of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
         for(auto& v : stmt.varList) {
-            auto ctype = "static_cast<" + v.ctype + ">";
-            if(v.ntype == v.ctype) {
-                ctype = "";
-            }
+            auto ctype = module.storeCast(v.ctype, v.ntype);
             of_src << "  " << stmt.qname() << "_.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
         }
-        of_src << "  " << stmt.qname() << "_.xdelete();" << std::endl;
+        of_src << "  auto rv = " << stmt.qname() << "_.upsert();" << std::endl;
+        generateInvalidate(stmt, of_src);
+        of_src << "  return rv;" << std::endl;
         of_src << "}" << std::endl;
         of_src << std::endl;
     }
 
-    inline void Interface::generateSelect(const Module& /*module*/, const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+    inline void Interface::generateUpdate(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
         std::string sep;
-        auto sname = stmt.sname;
-        if(sname == "+") {
-            sname = "row";
-        }
-
-        auto fqname = ns + name + "::" + stmt.qname();
-        auto rname = sname;
-        if(sname == "row") {
-            rname = fqname + "_c::row";
-        } else {
-            rname = ns + sname;
-        }
-
-        of_hdr << "    struct " << stmt.qname() << "_c : public " << module.generateBaseNS << "::statement {" << std::endl;
-        of_hdr << "      friend struct " << name << ";" << std::endl;
-        if(sname == "row") {
-            of_hdr << "      struct row {" << std::endl;
-            for(auto& c : stmt.colList) {
-                of_hdr << "        " << c.ntype << " " << c.cname << ";" << std::endl;
-            }
-            of_hdr << "      };" << std::endl;
-        }
-
-        of_hdr << "      inline " << stmt.qname() << "_c(" << module.generateBaseNS << "::database& pdb) : statement(pdb) {}" << std::endl;
-        of_hdr << "    };" << std::endl;
-        of_hdr << "    " << stmt.qname() << "_c " << stmt.qname() << "_;" << std::endl;
-
-        of_hdr << "    "
-               << "std::vector<" << rname << "> " << stmt.qname() << "(";
 
-        sep = "";
+        of_hdr << "    " << module.generateBaseNS << "::exstatement " << stmt.qname() << "_;" << std::endl;
+        of_hdr << "    size_t " << stmt.qname() << "(";
         for(auto& v : stmt.varList) {
             of_hdr << sep << "const " << v.ntype << "& " << v.name;
             sep = ", ";
@@ -1134,595 +2387,4898 @@ namespace {
         of_hdr << ");" << std::endl;
         of_hdr << std::endl;
 
+        auto fqname = ns + name + "::" + stmt.qname();
         sep = "";
-        of_src << "std::vector<" << rname << "> " << fqname << "(";
+        of_src << "size_t " << fqname << "(";
         for(auto& v : stmt.varList) {
             of_src << sep << "const " << v.ntype << "& " << v.name;
             sep = ", ";
         }
         of_src << ") {" << std::endl;
-
-        of_src << "  " << module.generateBaseNS << "::guard lk(db.db);" << std::endl;
         of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
         for(auto& v : stmt.varList) {
-            auto ctype = "static_cast<" + v.ctype + ">";
-            if(v.ntype == v.ctype) {
-                ctype = "";
-            }
+            auto ctype = module.storeCast(v.ctype, v.ntype);
             of_src << "  " << stmt.qname() << "_.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
         }
-        of_src << "  std::vector<" << rname << "> rv;" << std::endl;
-        of_src << "  while(" << stmt.qname() << "_.next()){" << std::endl;
-        of_src << "    rv.push_back(" << rname << "());" << std::endl;
-        of_src << "    auto& s = rv.back();" << std::endl;
-        size_t idx = 0;
-        for(auto& c : stmt.colList) {
-            auto ntype = "static_cast<" + c.ntype + ">";
-            if(c.ntype == c.ctype) {
-                ntype = "";
-            }
-            of_src << "    s." << c.cname << " = " << ntype << "(" << stmt.qname() << "_.getColumn<" << c.ctype << ">(" << idx << "));" << std::endl;
-            ++idx;
-        }
-        of_src << "  }" << std::endl;
+        of_src << "  auto rv = " << stmt.qname() << "_.update();" << std::endl;
+        generateInvalidate(stmt, of_src);
         of_src << "  return rv;" << std::endl;
         of_src << "}" << std::endl;
         of_src << std::endl;
     }
 
-
-    inline void Interface::generateIfaceDecl(const Module& module, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
-        if (isDB) {
+    /// \brief generates <table>_changes, a set of column values with a dirty bit each,
+    /// and update<table>(pk, changes), which prepares one UPDATE per set of dirty columns
+    inline void Interface::generateUpdateTable(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        std::vector<const Column*> pkList;
+        std::vector<const Column*> colList;
+        for(auto& c : stmt.colList) {
+            if(c.is_pk) {
+                pkList.push_back(&c);
+            } else {
+                colList.push_back(&c);
+            }
+        }
+        if((colList.size() == 0) || (colList.size() > 64)) {
             return;
         }
-        of_hdr << "  struct " << name << ";" << std::endl;
-    }
+        Column rowid(stmt.tname, "rowid", "INTEGER", "int64_t", "int64_t", true);
+        if(pkList.size() == 0) {
+            pkList.push_back(&rowid);
+        }
 
-    inline void Interface::generate(const Module& module, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
-        of_hdr << "  struct " << name << " {" << std::endl;
-        if(isDB) {
-            of_hdr << "    " << module.generateBaseNS << "::database db;" << std::endl;
-            of_hdr << "    std::string name;" << std::endl;
-        } else {
-            of_hdr << "    typedef " << module.generateBaseNS << "::pool<" << db.db().name << ", " << name << ">::guard guard;" << std::endl;
-            of_hdr << "    " << db.db().name << "& db;" << std::endl;
+        auto cname = stmt.tname + "_changes";
+        of_hdr << "      struct " << cname << " {" << std::endl;
+        of_hdr << "        uint64_t dirty{0};" << std::endl;
+        for(auto& c : colList) {
+            of_hdr << "        " << c->ntype << " " << c->cname << "{};" << std::endl;
         }
+        size_t bit = 0;
+        for(auto& c : colList) {
+            of_hdr << "        inline " << cname << "& set_" << c->cname << "(const " << c->ntype << "& val) { " << c->cname << " = val; dirty |= (1ull << " << bit << "); return *this; }" << std::endl;
+            ++bit;
+        }
+        of_hdr << "      };" << std::endl;
 
-        for(auto& s : stmtList) {
-            switch(s.action) {
-            case SQLITE_CREATE_TABLE:
-                generateCreateTable(s, of_hdr);
-                break;
-            case SQLITE_INSERT:
-            case SQLITE_UPDATE:
-                generateInsert(s, of_hdr, of_src, ns);
-                break;
-            case SQLITE_DELETE:
-                generateDelete(s, of_hdr, of_src, ns);
-                break;
-            case SQLITE_SELECT:
-                generateSelect(module, s, of_hdr, of_src, ns);
-                break;
-            }
+        std::string sep;
+        of_hdr << "    std::map<uint64_t, std::unique_ptr<" << module.generateBaseNS << "::exstatement>> " << stmt.tname << "_update_;" << std::endl;
+        of_hdr << "    size_t update" << stmt.tname << "(";
+        for(auto& c : pkList) {
+            of_hdr << sep << "const " << c->ntype << "& " << c->cname;
+            sep = ", ";
         }
+        of_hdr << ", const " << cname << "& changes);" << std::endl;
 
-        if(isDB) {
-            of_hdr << "    void create(const std::string& filename, const char* vfs = nullptr);" << std::endl;
-            of_hdr << "    void openrw(const std::string& filename, const char* vfs = nullptr);" << std::endl;
-            of_hdr << "    void openro(const std::string& filename, const char* vfs = nullptr);" << std::endl;
-        } else {
-            of_hdr << "    void open();" << std::endl;
+        sep = "";
+        of_src << "size_t " << ns << name << "::update" << stmt.tname << "(";
+        for(auto& c : pkList) {
+            of_src << sep << "const " << c->ntype << "& " << c->cname;
+            sep = ", ";
         }
-        of_hdr << "    inline " << name << "& operator=(const " << name << "&) = delete;" << std::endl;
-        of_hdr << "    inline " << name << "(const " << name << "&) = delete;" << std::endl;
-        of_hdr << "    inline " << name << "& operator=(" << name << "&&) = delete;" << std::endl;
-        of_hdr << "    inline " << name << "(" << name << "&&) = delete;" << std::endl;
-
-        std::string sep;
-        if(isDB) {
-            of_hdr << "    inline " << name << "()";
-            sep = ":";
-            for (auto& db : module.dbList) {
-                for (auto& iface : db.interfaceList) {
-                    if (!iface.isDB) {
-                        of_hdr << sep << iface.name << "Pool(*this)";
-                        sep = ",";
-                    }
-                }
-            }
-        } else {
-            of_hdr << "    inline " << name << "(" << db.db().name << "& d, const bool& doOpen = true) : db(d)";
+        of_src << ", const " << cname << "& changes) {" << std::endl;
+        of_src << "  if(changes.dirty == 0){" << std::endl;
+        of_src << "    return 0;" << std::endl;
+        of_src << "  }" << std::endl;
+        // the statements are shared by every thread using the database, and created on first use
+        of_src << "  " << module.generateBaseNS << "::connection_lock lk(db);" << std::endl;
+        of_src << "  auto& st = " << stmt.tname << "_update_[changes.dirty];" << std::endl;
+        of_src << "  if(!st){" << std::endl;
+        of_src << "    static const char* const cols[] = {";
+        sep = "";
+        for(auto& c : colList) {
+            of_src << sep << "\"" << c->cname << "\"";
             sep = ", ";
         }
-        for(auto& s : stmtList) {
-            switch(s.action) {
-            case SQLITE_CREATE_TABLE:
-                break;
-            case SQLITE_INSERT:
-            case SQLITE_UPDATE:
-            case SQLITE_DELETE:
-            case SQLITE_SELECT:
-                of_hdr << sep << s.qname() << "_(db.db)";
-                sep = ", ";
-                break;
-            }
+        of_src << "};" << std::endl;
+        of_src << "    std::string sql = \"UPDATE " << stmt.tname << " SET \";" << std::endl;
+        of_src << "    std::string sep;" << std::endl;
+        of_src << "    for(size_t i = 0; i < " << colList.size() << "; ++i){" << std::endl;
+        of_src << "      if(changes.dirty & (1ull << i)){" << std::endl;
+        of_src << "        sql += sep + cols[i] + \" = :\" + cols[i];" << std::endl;
+        of_src << "        sep = \", \";" << std::endl;
+        of_src << "      }" << std::endl;
+        of_src << "    }" << std::endl;
+        of_src << "    sql += \" WHERE ";
+        sep = "";
+        size_t k = 0;
+        for(auto& c : pkList) {
+            of_src << sep << c->cname << " = :sqlch_pk" << k;
+            sep = " AND ";
+            ++k;
+        }
+        of_src << "\";" << std::endl;
+        of_src << "    st = std::make_unique<" << module.generateBaseNS << "::exstatement>(db);" << std::endl;
+        of_src << "    st->open(sql, \"" << name << ".update" << stmt.tname << "\");" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  st->reset();" << std::endl;
+        bit = 0;
+        for(auto& c : colList) {
+            auto ctype = module.storeCast(c->ctype, c->ntype);
+            of_src << "  if(changes.dirty & (1ull << " << bit << ")){" << std::endl;
+            of_src << "    st->setParam<" << c->ctype << ">(\":" << c->cname << "\", " << ctype << "(changes." << c->cname << "));" << std::endl;
+            of_src << "  }" << std::endl;
+            ++bit;
+        }
+        k = 0;
+        for(auto& c : pkList) {
+            auto ctype = module.storeCast(c->ctype, c->ntype);
+            of_src << "  st->setParam<" << c->ctype << ">(\":sqlch_pk" << k << "\", " << ctype << "(" << c->cname << "));" << std::endl;
+            ++k;
         }
+        of_src << "  auto rv = st->update();" << std::endl;
+        if(db.hasCache()) {
+            of_src << "  ++" << stmt.tname << "_ver_;" << std::endl;
+            of_src << "  " << stmt.tname << "_dirty_ = true;" << std::endl;
+        }
+        of_src << "  return rv;" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
 
-        if (isDB) {
-            of_hdr << " {}" << std::endl;
-            for (auto& db : module.dbList) {
-                for (auto& iface : db.interfaceList) {
-                    if (!iface.isDB) {
-                        of_hdr << "    " << module.generateBaseNS << "::pool<" << name << "," << iface.name << "> " << iface.name << "Pool;" << std::endl;
-                    }
+    /// \brief finds the parent column of a foreign key, returns false if no loader can be generated for it
+    inline bool Interface::getLoader(const Statement& stmt, const ForeignKey& fk, const Column*& key) const {
+        key = nullptr;
+        for(auto& ps : stmtList) {
+            if((ps.action != SQLITE_CREATE_TABLE) || (ps.tname != fk.table)) {
+                continue;
+            }
+            for(auto& c : ps.colList) {
+                if((fk.to.length() > 0) ? (c.cname == fk.to) : c.is_pk) {
+                    key = &c;
                 }
             }
-        }else{
-            of_hdr << " {if(doOpen){open();}}" << std::endl;
         }
-        of_hdr << "  };" << std::endl;
-        of_hdr << std::endl;
+        // the parent key is the key of a hash map
+        if((key == nullptr) || ((key->ctype != "int64_t") && (key->ctype != "std::string")) || module.isChrono(key->ntype)) {
+            return false;
+        }
+        for(auto& c : stmt.colList) {
+            if(c.cname == fk.from) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-        for(auto& s : stmtList) {
-            generateEncString(module, s, of_hdr, of_src, ns);
+    inline std::string Interface::getLoaderSql(const Statement& stmt, const ForeignKey& fk) const {
+        auto sql = "SELECT * FROM " + stmt.tname + " WHERE " + fk.from + " IN sqlch_array(:keys)";
+        while((sql.length() % 8) != 0) {
+            sql += " ";
         }
+        return sql;
+    }
 
-        if(isDB) {
-            of_src << "void " << ns << name << "::create(const std::string& filename, const char* vfs) {" << std::endl;
-            of_src << "  FILE* fp = ::fopen(filename.c_str(), \"r\");" << std::endl;
-            of_src << "  if(fp){" << std::endl;
-            of_src << "    ::fclose(fp);" << std::endl;
-            of_src << "    ::remove(filename.c_str());" << std::endl;
-            of_src << "  }" << std::endl;
-            of_src << "  db.create(filename, vfs);" << std::endl;
-            of_src << "  db.exec(\"PRAGMA page_size = 4096;\");" << std::endl;
-            of_src << "  " << module.generateBaseNS << "::transaction t(db);" << std::endl;
-            for(auto& s : stmtList) {
-                switch(s.action) {
-                case SQLITE_CREATE_TABLE:
-                case SQLITE_CREATE_INDEX:
-                    of_src << "  db.exec(" << s.qname() << "_s());" << std::endl;
-                    break;
-                }
+    /// \brief generates load<table>_<column>(parents), which fetches the rows referencing
+    /// a set of parent rows in one query, grouped by the parent key
+    inline void Interface::generateLoaders(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        for(auto& fk : stmt.fkList) {
+            const Column* key = nullptr;
+            if(!getLoader(stmt, fk, key)) {
+                continue;
             }
-            of_src << "  t.commit();" << std::endl;
-            of_src << "  if(name.size() == 0){" << std::endl;
-            of_src << "    name = filename;" << std::endl;
-            of_src << "  }" << std::endl;
-            of_src << "}" << std::endl;
-            of_src << std::endl;
-            of_src << "void " << ns << name << "::openrw(const std::string& filename, const char* vfs) {" << std::endl;
-            of_src << "  db.openrw(filename, vfs);" << std::endl;
-            of_src << "  if(name.size() == 0){" << std::endl;
-            of_src << "    name = filename;" << std::endl;
+            auto lname = "load" + stmt.tname + "_" + fk.from;
+            auto mtype = "std::unordered_map<" + key->ntype + ", std::vector<" + stmt.tname + "> >";
+            of_hdr << "    typedef " << mtype << " " << lname << "_t;" << std::endl;
+            of_hdr << "    std::unique_ptr<" << module.generateBaseNS << "::exstatement> " << lname << "_;" << std::endl;
+            of_hdr << "    " << lname << "_t " << lname << "(const std::vector<" << fk.table << ">& parents);" << std::endl;
+
+            of_src << ns << name << "::" << lname << "_t " << ns << name << "::" << lname << "(const std::vector<" << fk.table << ">& parents) {" << std::endl;
+            of_src << "  std::vector<" << key->ntype << "> keys;" << std::endl;
+            of_src << "  keys.reserve(parents.size());" << std::endl;
+            of_src << "  for(auto& p : parents){" << std::endl;
+            of_src << "    keys.push_back(p." << key->cname << ");" << std::endl;
             of_src << "  }" << std::endl;
-            of_src << "}" << std::endl;
-            of_src << std::endl;
-            of_src << "void " << ns << name << "::openro(const std::string& filename, const char* vfs) {" << std::endl;
-            of_src << "  db.openro(filename, vfs);" << std::endl;
-            of_src << "  if(name.size() == 0){" << std::endl;
-            of_src << "    name = filename;" << std::endl;
+            of_src << "  " << lname << "_t rv;" << std::endl;
+            // the statement is shared by every thread using the database, and created on first use
+            of_src << "  " << module.generateBaseNS << "::connection_lock lk(db);" << std::endl;
+            of_src << "  if(!" << lname << "_){" << std::endl;
+            of_src << "    " << lname << "_ = std::make_unique<" << module.generateBaseNS << "::exstatement>(db);" << std::endl;
+            of_src << "    " << lname << "_->open(" << lname << "_s(), \"" << name << "." << lname << "\");" << std::endl;
             of_src << "  }" << std::endl;
-            of_src << "}" << std::endl;
-            of_src << std::endl;
-        } else {
-            of_src << "void " << ns << name << "::open() {" << std::endl;
-            for(auto& s : stmtList) {
-                switch(s.action) {
-                case SQLITE_INSERT:
-                case SQLITE_UPDATE:
-                case SQLITE_DELETE:
-                case SQLITE_SELECT:
-                    of_src << "  " << s.qname() << "_.open(" << s.qname() << "_s());" << std::endl;
-                    break;
+            of_src << "  auto& st = *" << lname << "_;" << std::endl;
+            of_src << "  st.reset();" << std::endl;
+            of_src << "  st.setParam<" << module.generateBaseNS << "::array_ref>(\":keys\", " << module.generateBaseNS << "::make_array(keys));" << std::endl;
+            of_src << "  while(st.next()){" << std::endl;
+            of_src << "    " << stmt.tname << " s;" << std::endl;
+            generateRowRead(stmt, "st", of_src, "    ");
+            for(auto& c : stmt.colList) {
+                if(c.cname == fk.from) {
+                    auto cast = (c.ntype == key->ntype) ? std::string() : ("static_cast<" + key->ntype + ">");
+                    of_src << "    rv[" << cast << "(s." << c.cname << ")].push_back(std::move(s));" << std::endl;
                 }
             }
+            of_src << "  }" << std::endl;
+            of_src << "  return rv;" << std::endl;
             of_src << "}" << std::endl;
             of_src << std::endl;
         }
-        of_src << std::endl;
     }
 
-    inline void generate(const std::string& odir, const Module& module) {
-        auto bname = odir + module.name;
-        std::cout << "Generating:[" << bname + ".hpp"
-                  << "] and [" << bname + ".cpp"
-                  << "]" << std::endl;
+    inline void Interface::generateDelete(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        std::string sep;
 
-        // open src and hdr files
-        std::ofstream of_hdr(bname + ".hpp");
-        if(!of_hdr.is_open()) {
-            std::cout << "Error:Unable to open file:" << bname << ".hpp" << std::endl;
-            exit(1);
+        of_hdr << "    " << module.generateBaseNS << "::exstatement " << stmt.qname() << "_;" << std::endl;
+        of_hdr << "    void " << stmt.qname() << "(";
+        for(auto& v : stmt.varList) {
+            of_hdr << sep << "const " << v.ntype << "& " << v.name;
+            sep = ", ";
         }
-        std::ofstream of_src(bname + ".cpp");
-        if(!of_src.is_open()) {
-            std::cout << "Error:Unable to open file:" << bname << ".cpp" << std::endl;
-            exit(1);
+        of_hdr << ");" << std::endl;
+        of_hdr << std::endl;
+
+        auto fqname = ns + name + "::" + stmt.qname();
+        sep = "";
+        of_src << "void " << fqname << "(";
+        for(auto& v : stmt.varList) {
+            of_src << sep << "const " << v.ntype << "& " << v.name;
+            sep = ", ";
+        }
+        of_src << ") {" << std::endl;
+        of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
+        for(auto& v : stmt.varList) {
+            auto ctype = module.storeCast(v.ctype, v.ntype);
+            of_src << "  " << stmt.qname() << "_.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
         }
+        of_src << "  " << stmt.qname() << "_.xdelete();" << std::endl;
+        generateInvalidate(stmt, of_src);
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
 
-        // HDR:generate includes
-        of_hdr << "#pragma once" << std::endl;
+    inline void Interface::generateRowRead(const Statement& stmt, const std::string& sv, std::ostream& of_src, const std::string& indent, const bool& reuse) const {
+        size_t idx = 0;
+        for(auto& c : stmt.colList) {
+            if(reuse && (c.ntype == c.ctype) && ((c.ctype == "std::string") || (c.ctype == "std::vector<uint8_t>"))) {
+                // read into the existing value, keeping its capacity
+                of_src << indent << sv << ".getColumn(" << idx << ", s." << c.cname << ");" << std::endl;
+                ++idx;
+                continue;
+            }
+            auto ntype = module.nativeCast(c.ctype, c.ntype);
+            of_src << indent << "s." << c.cname << " = " << ntype << "(" << sv << ".getColumn<" << c.ctype << ">(" << idx << "));" << std::endl;
+            ++idx;
+        }
+    }
+
+    inline void Interface::generatePage(const Statement& stmt, const std::string& rname, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        auto pname = stmt.qname() + "_page";
+        of_hdr << "    " << stmt.qname() << "_c " << stmt.qname() << "_first_;" << std::endl;
+        of_hdr << "    " << stmt.qname() << "_c " << stmt.qname() << "_next_;" << std::endl;
+        of_hdr << "    struct " << pname << " {" << std::endl;
+        of_hdr << "      bool started;" << std::endl;
+        of_hdr << "      bool done;" << std::endl;
+        for(auto& i : stmt.pageCols) {
+            auto& c = stmt.colList.at(i);
+            of_hdr << "      " << c.ntype << " " << c.cname << ";" << std::endl;
+        }
+        of_hdr << "      inline " << pname << "() : started(false), done(false) {}" << std::endl;
+        of_hdr << "    };" << std::endl;
+
+        std::string sep;
+        of_hdr << "    std::vector<" << rname << "> " << stmt.qname() << "Page(" << pname << "& page, const int64_t& limit";
+        for(auto& v : stmt.varList) {
+            of_hdr << ", const " << v.ntype << "& " << v.name;
+        }
+        of_hdr << ");" << std::endl;
         of_hdr << std::endl;
-        of_hdr << "#include <string>" << std::endl;
-        of_hdr << "#include <vector>" << std::endl;
-        of_hdr << "#include <sqlite3.h>" << std::endl;
-        for(auto& i : module.includeList) {
-            of_hdr << "#include \"" << i << "\"" << std::endl;
+
+        auto fqname = ns + name + "::" + stmt.qname();
+        of_src << "std::vector<" << rname << "> " << fqname << "Page(" << pname << "& page, const int64_t& limit";
+        for(auto& v : stmt.varList) {
+            of_src << ", const " << v.ntype << "& " << v.name;
+        }
+        of_src << ") {" << std::endl;
+        of_src << "  if(limit <= 0){" << std::endl;
+        of_src << "    throw std::invalid_argument(\"" << stmt.qname() << "Page: limit must be positive\");" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  std::vector<" << rname << "> rv;" << std::endl;
+        of_src << "  if(page.done){" << std::endl;
+        of_src << "    return rv;" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  " << module.generateBaseNS << "::guard lk(db.db);" << std::endl;
+        of_src << "  auto& st = page.started ? " << stmt.qname() << "_next_ : " << stmt.qname() << "_first_;" << std::endl;
+        of_src << "  st.reset();" << std::endl;
+        for(auto& v : stmt.varList) {
+            auto ctype = module.storeCast(v.ctype, v.ntype);
+            of_src << "  st.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
+        }
+        of_src << "  if(page.started){" << std::endl;
+        size_t k = 0;
+        for(auto& i : stmt.pageCols) {
+            auto& c = stmt.colList.at(i);
+            auto ctype = module.storeCast(c.ctype, c.ntype);
+            of_src << "    st.setParam<" << c.ctype << ">(\":sqlch_k" << k << "\", " << ctype << "(page." << c.cname << "));" << std::endl;
+            ++k;
+        }
+        of_src << "  }" << std::endl;
+        of_src << "  st.setParam<int64_t>(\":sqlch_limit\", limit);" << std::endl;
+        of_src << "  while(st.next()){" << std::endl;
+        of_src << "    rv.push_back(" << rname << "());" << std::endl;
+        of_src << "    auto& s = rv.back();" << std::endl;
+        generateRowRead(stmt, "st", of_src, "    ");
+        of_src << "  }" << std::endl;
+        of_src << "  if(rv.size() > 0){" << std::endl;
+        of_src << "    page.started = true;" << std::endl;
+        for(auto& i : stmt.pageCols) {
+            auto& c = stmt.colList.at(i);
+            of_src << "    page." << c.cname << " = rv.back()." << c.cname << ";" << std::endl;
+        }
+        of_src << "  }" << std::endl;
+        of_src << "  page.done = (rv.size() == 0) || (static_cast<int64_t>(rv.size()) < limit);" << std::endl;
+        of_src << "  return rv;" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
+
+    inline void Interface::generateParallel(const Statement& stmt, const std::string& rname, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        of_hdr << "    std::vector<" << rname << "> " << stmt.qname() << "Parallel(const size_t& nThreads";
+        for(auto& v : stmt.varList) {
+            of_hdr << ", const " << v.ntype << "& " << v.name;
         }
+        of_hdr << ");" << std::endl;
         of_hdr << std::endl;
 
-        // SRC:generate includes
-        of_src << "#include <iostream>" << std::endl;
-        for(auto& i : module.importList) {
-            of_src << "#include \"" << i << "\"" << std::endl;
+        auto fqname = ns + name + "::" + stmt.qname();
+        of_src << "std::vector<" << rname << "> " << fqname << "Parallel(const size_t& nThreads";
+        for(auto& v : stmt.varList) {
+            of_src << ", const " << v.ntype << "& " << v.name;
         }
-        of_src << "#include \"" << module.name << ".hpp\"" << std::endl;
+        of_src << ") {" << std::endl;
+        of_src << "  int64_t lo = 0;" << std::endl;
+        of_src << "  int64_t hi = -1;" << std::endl;
+        of_src << "  " << module.generateBaseNS << "::snapshot snap(db.readers);" << std::endl;
+        of_src << "  {" << std::endl;
+        of_src << "    " << module.generateBaseNS << "::snapshot::reader rr(snap);" << std::endl;
+        of_src << "    " << module.generateBaseNS << "::exstatement rs(rr.conn());" << std::endl;
+        of_src << "    rs.open(" << stmt.qname() << "_range_s(), \"" << name << "." << stmt.qname() << "\");" << std::endl;
+        of_src << "    if(rs.next() && (rs.getColumnType(0) != SQLITE_NULL)){" << std::endl;
+        of_src << "      lo = rs.getColumn<int64_t>(0);" << std::endl;
+        of_src << "      hi = rs.getColumn<int64_t>(1);" << std::endl;
+        of_src << "    }" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  std::vector<" << rname << "> rv;" << std::endl;
+        of_src << "  if(hi < lo){" << std::endl;
+        of_src << "    return rv;" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << std::endl;
+        of_src << "  uint64_t span = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);" << std::endl;
+        of_src << "  uint64_t n = (nThreads > 0) ? nThreads : 1;" << std::endl;
+        of_src << "  if(span < n){" << std::endl;
+        of_src << "    n = span + 1;" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  uint64_t step = (span / n) + 1;" << std::endl;
+        of_src << "  std::vector<std::vector<" << rname << "> > parts(n);" << std::endl;
+        of_src << "  auto scan = [&](const uint64_t i) {" << std::endl;
+        of_src << "    auto plo = static_cast<int64_t>(static_cast<uint64_t>(lo) + (i * step));" << std::endl;
+        of_src << "    auto phi = (i == (n - 1)) ? hi : static_cast<int64_t>(static_cast<uint64_t>(plo) + step - 1);" << std::endl;
+        of_src << "    " << module.generateBaseNS << "::snapshot::reader rg(snap);" << std::endl;
+        of_src << "    " << stmt.qname() << "_c st(rg.conn());" << std::endl;
+        of_src << "    st.open(" << stmt.qname() << "_part_s(), \"" << name << "." << stmt.qname() << "\");" << std::endl;
+        for(auto& v : stmt.varList) {
+            auto ctype = module.storeCast(v.ctype, v.ntype);
+            of_src << "    st.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
+        }
+        of_src << "    st.setParam<int64_t>(\":sqlch_lo\", plo);" << std::endl;
+        of_src << "    st.setParam<int64_t>(\":sqlch_hi\", phi);" << std::endl;
+        of_src << "    auto& pv = parts.at(i);" << std::endl;
+        of_src << "    while(st.next()){" << std::endl;
+        of_src << "      pv.push_back(" << rname << "());" << std::endl;
+        of_src << "      auto& s = pv.back();" << std::endl;
+        generateRowRead(stmt, "st", of_src, "      ");
+        of_src << "    }" << std::endl;
+        of_src << "  };" << std::endl;
+        // an exception leaving a thread would terminate the process, so each part keeps its
+        // own, and the first one is thrown again here once every thread has been joined
+        of_src << "  std::vector<std::exception_ptr> errors(n);" << std::endl;
+        of_src << "  auto run = [&](const uint64_t i) {" << std::endl;
+        of_src << "    try {" << std::endl;
+        of_src << "      scan(i);" << std::endl;
+        of_src << "    } catch(...) {" << std::endl;
+        of_src << "      errors.at(i) = std::current_exception();" << std::endl;
+        of_src << "    }" << std::endl;
+        of_src << "  };" << std::endl;
+        of_src << "  std::vector<std::thread> tl;" << std::endl;
+        of_src << "  for(uint64_t i = 1; i < n; ++i){" << std::endl;
+        of_src << "    tl.emplace_back(run, i);" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  run(0);" << std::endl;
+        of_src << "  for(auto& t : tl){" << std::endl;
+        of_src << "    t.join();" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  for(auto& e : errors){" << std::endl;
+        of_src << "    if(e){" << std::endl;
+        of_src << "      std::rethrow_exception(e);" << std::endl;
+        of_src << "    }" << std::endl;
+        of_src << "  }" << std::endl;
         of_src << std::endl;
 
-        // HDR:generate declaration for common structs required by sqlch
-        if(module.generateBase != false) {
-            // SQLCH_COMMON used is to ensure that the structs are not redefined when more than one
-            // of the generated files are included in the same cpp file
-            of_hdr << "#if !defined(SQLCH_COMMON)" << std::endl;
-            of_hdr << "#define SQLCH_COMMON 1" << std::endl;
-            of_hdr << "namespace " << module.generateBaseNS << " {" << std::endl;
-            of_hdr << "  std::string error(sqlite3* db);" << std::endl;
-            of_hdr << "  struct database;" << std::endl;
-            of_hdr << "  struct statement {" << std::endl;
-            of_hdr << "    database& db_;" << std::endl;
-            of_hdr << "    sqlite3_stmt* val_;" << std::endl;
-            of_hdr << "    void open(const std::string& sql);" << std::endl;
-            of_hdr << "    void close();" << std::endl;
-            of_hdr << "    bool next();" << std::endl;
-            if(module.isAutoIncrement){
-                of_hdr << "    uint64_t insert();" << std::endl;
-            }else{
-                of_hdr << "    void insert();" << std::endl;
+        if(stmt.partOrder.size() > 0) {
+            of_src << "  auto less = [](const " << rname << "& a, const " << rname << "& b) {" << std::endl;
+            for(auto& o : stmt.partOrder) {
+                auto& cn = stmt.colList.at(o.first).cname;
+                of_src << "    if(a." << cn << " != b." << cn << "){" << std::endl;
+                of_src << "      return (a." << cn << (o.second ? " > " : " < ") << "b." << cn << ");" << std::endl;
+                of_src << "    }" << std::endl;
             }
-            of_hdr << "    void xdelete();" << std::endl;
-            of_hdr << "    void reset();" << std::endl;
-            of_hdr << "    size_t getColumnCount();" << std::endl;
-            of_hdr << "    int getColumnType(const size_t& idx);" << std::endl;
-            of_hdr << "    void setParamFloat(const std::string& key, const double& val);" << std::endl;
-            of_hdr << "    double getColumnFloat(const int& idx);" << std::endl;
-            of_hdr << "    void setParamLong(const std::string& key, const int64_t& val);" << std::endl;
-            of_hdr << "    int64_t getColumnLong(const int& idx);" << std::endl;
-            of_hdr << "    void setParamText(const std::string& key, const std::string& val);" << std::endl;
-            of_hdr << "    std::string getColumnText(const int& idx);" << std::endl;
-            of_hdr << "    template <typename T> inline void setParam(const std::string& key, const T& val);" << std::endl;
-            of_hdr << "    template <typename T> inline T getColumn(const int& idx);" << std::endl;
-            of_hdr << "  protected:" << std::endl;
-            of_hdr << "    inline statement(database& db) : db_(db), val_(nullptr){}" << std::endl;
-            of_hdr << "    inline statement(const statement&) = delete;" << std::endl;
-            of_hdr << "    inline statement(statement&&) = delete;" << std::endl;
-            of_hdr << "    inline ~statement() {close();}" << std::endl;
-            of_hdr << "  };" << std::endl;
-            of_hdr << "  template <> inline void statement::setParam<double>(const std::string& key, const double& val) { return setParamFloat(key, val); }" << std::endl;
-            of_hdr << "  template <> inline double statement::getColumn<double>(const int& idx) { return getColumnFloat(idx); }" << std::endl;
-            of_hdr << "  template <> inline void statement::setParam<int64_t>(const std::string& key, const int64_t& val) { return setParamLong(key, val); }" << std::endl;
-            of_hdr << "  template <> inline int64_t statement::getColumn<int64_t>(const int& idx) { return getColumnLong(idx); }" << std::endl;
-            of_hdr << "  template <> inline void statement::setParam<std::string>(const std::string& key, const std::string& val) { return setParamText(key, val); }" << std::endl;
-            of_hdr << "  template <> inline std::string statement::getColumn<std::string>(const int& idx) { return getColumnText(idx); }" << std::endl;
-            of_hdr << std::endl;
-
-            of_hdr << "  struct exstatement : public " << module.generateBaseNS << "::statement {" << std::endl;
-            of_hdr << "    inline exstatement(database& db) : statement(db){}" << std::endl;
-            of_hdr << "  };" << std::endl;
-            of_hdr << std::endl;
-
-            of_hdr << "  struct database {" << std::endl;
-            of_hdr << "    sqlite3* val_;" << std::endl;
-            of_hdr << "    exstatement beginTx_;" << std::endl;
-            of_hdr << "    exstatement commitTx_;" << std::endl;
-            of_hdr << "    std::string filename_;" << std::endl;
-            //if(module.mutexName.length() > 0) {
-            //    of_hdr << "#if " << module.mutexName << std::endl;
-            //    of_hdr << "    std::mutex mx_;" << std::endl;
-            //    of_hdr << "#endif //" << module.mutexName << std::endl;
-            //}
-            of_hdr << "    inline database(const database&) = delete;" << std::endl;
-            of_hdr << "    inline database(database&&) = delete;" << std::endl;
-            of_hdr << "    void open(const std::string& filename, const int& flags, const char* vfs);" << std::endl;
-            of_hdr << "    void close();" << std::endl;
-            of_hdr << "    inline void begin(){beginTx_.reset();beginTx_.next();}" << std::endl;
-            of_hdr << "    inline void commit(){commitTx_.reset();commitTx_.next();}" << std::endl;
-            of_hdr << "    void exec(const std::string& sqls);" << std::endl;
-            of_hdr << "    inline void create(const std::string& filename, const char* vfs){open(filename, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, vfs);}" << std::endl;
-            of_hdr << "    inline void openro(const std::string& filename, const char* vfs){open(filename, SQLITE_OPEN_READONLY, vfs);}" << std::endl;
-            of_hdr << "    inline void openrw(const std::string& filename, const char* vfs){open(filename, SQLITE_OPEN_READWRITE, vfs);}" << std::endl;
-            of_hdr << "    inline auto isOpen() {return (val_ != nullptr);}" << std::endl;
-            of_hdr << "    inline auto& filename() const {return filename_;}" << std::endl;
-            of_hdr << "    inline database() : val_(nullptr), beginTx_(*this), commitTx_(*this) {}" << std::endl;
-            of_hdr << "    inline ~database() {close();}" << std::endl;
-            of_hdr << "  };" << std::endl;
-            of_hdr << std::endl;
+            of_src << "    return false;" << std::endl;
+            of_src << "  };" << std::endl;
+        }
+        of_src << "  size_t total = 0;" << std::endl;
+        of_src << "  for(auto& pv : parts){" << std::endl;
+        of_src << "    total += pv.size();" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  rv.reserve(total);" << std::endl;
+        of_src << "  for(auto& pv : parts){" << std::endl;
+        if(stmt.partOrder.size() > 0) {
+            of_src << "    auto mid = rv.size();" << std::endl;
+        }
+        of_src << "    rv.insert(rv.end(), std::make_move_iterator(pv.begin()), std::make_move_iterator(pv.end()));" << std::endl;
+        if(stmt.partOrder.size() > 0) {
+            of_src << "    std::inplace_merge(rv.begin(), rv.begin() + static_cast<std::ptrdiff_t>(mid), rv.end(), less);" << std::endl;
+        }
+        of_src << "  }" << std::endl;
+        of_src << "  return rv;" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
 
-            of_hdr << "  struct guard {" << std::endl;
-            //if(module.mutexName.length() > 0) {
-            //    of_hdr << "#if " << module.mutexName << std::endl;
-            //    of_hdr << "    std::lock_guard<std::mutex> lk_;" << std::endl;
-            //    of_hdr << "#endif //" << module.mutexName << std::endl;
-            //    of_hdr << "#if " << module.mutexName << std::endl;
-            //    of_hdr << "    inline guard(database& db) : lk_(db.mx_){}" << std::endl;
-            //    of_hdr << "#else" << std::endl;
-            //    of_hdr << "    inline guard(database&){}" << std::endl;
-            //    of_hdr << "#endif //" << module.mutexName << std::endl;
-            //} else {
-            //    of_hdr << "    inline guard(database&){}" << std::endl;
-            //}
-            of_hdr << "    inline guard(database&){}" << std::endl;
-            of_hdr << "  };" << std::endl;
-            of_hdr << std::endl;
+    /// \brief returns true if a column is read into a text_column of a columnar result, rather than a column of values
+    inline bool Interface::isTextColumn(const Column& c) const {
+        return ((c.ntype == c.ctype) && ((c.ctype == "std::string") || (c.ctype == "std::vector<uint8_t>")));
+    }
 
-            //////
-            of_hdr << "  template <typename DbT, typename ConnT>" << std::endl;
-            of_hdr << "  class pool {" << std::endl;
-            of_hdr << "      DbT& db_;" << std::endl;
-            of_hdr << "      std::vector<std::unique_ptr<ConnT> > pool_;" << std::endl;
-            of_hdr << "      std::vector<ConnT*> free_;" << std::endl;
-            if (module.mutexName.length() > 0) {
-                of_hdr << "#if " << module.mutexName << std::endl;
-                of_hdr << "       std::mutex mx_;" << std::endl;
-                of_hdr << "#endif //" << module.mutexName << std::endl;
-            }
-            of_hdr << "  public:" << std::endl;
-            of_hdr << "      inline ConnT* get() {" << std::endl;
-            if (module.mutexName.length() > 0) {
-                of_hdr << "#if " << module.mutexName << std::endl;
-                of_hdr << "          std::lock_guard<std::mutex> lg(mx_);" << std::endl;
-                of_hdr << "#endif //" << module.mutexName << std::endl;
+    /// \brief generates the struct of per-column arrays of a COLUMNAR select
+    inline void Interface::generateColumnsDecl(const Statement& stmt, std::ostream& of_hdr) const {
+        of_hdr << "      struct columns {" << std::endl;
+        of_hdr << "        size_t size = 0;" << std::endl;
+        for(auto& c : stmt.colList) {
+            if(isTextColumn(c)) {
+                of_hdr << "        " << module.generateBaseNS << "::text_column " << c.cname << ";" << std::endl;
+            } else {
+                of_hdr << "        " << module.generateBaseNS << "::column<" << c.ntype << "> " << c.cname << ";" << std::endl;
             }
-            of_hdr << "          if (free_.size() > 0) {" << std::endl;
-            of_hdr << "              auto r = free_.back();" << std::endl;
-            of_hdr << "              free_.pop_back();" << std::endl;
-            of_hdr << "              return r;" << std::endl;
-            of_hdr << "          }" << std::endl;
-            of_hdr << "          std::unique_ptr<ConnT> ro(new ConnT(db_));" << std::endl;
-            of_hdr << "          ro->open();" << std::endl;
-            of_hdr << "          pool_.push_back(std::move(ro));" << std::endl;
-            of_hdr << "          return pool_.back().get();" << std::endl;
-            of_hdr << "      }" << std::endl;
+        }
+        of_hdr << "        inline void clear() {size = 0;";
+        for(auto& c : stmt.colList) {
+            of_hdr << c.cname << ".clear();";
+        }
+        of_hdr << "}" << std::endl;
+        of_hdr << "      };" << std::endl;
+    }
 
-            of_hdr << "      inline void release(ConnT* r) {" << std::endl;
-            if (module.mutexName.length() > 0) {
-                of_hdr << "#if " << module.mutexName << std::endl;
-                of_hdr << "          std::lock_guard<std::mutex> lg(mx_);" << std::endl;
-                of_hdr << "#endif //" << module.mutexName << std::endl;
-            }
-            of_hdr << "          free_.push_back(r);" << std::endl;
-            of_hdr << "      }" << std::endl;
+    /// \brief generates qnameColumns(), which reads the rows of a select straight into per-column arrays
+    inline void Interface::generateColumns(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        auto cname = stmt.qname() + "_c::columns";
+        of_hdr << "    " << cname << " " << stmt.qname() << "Columns(";
+        std::string sep;
+        for(auto& v : stmt.varList) {
+            of_hdr << sep << "const " << v.ntype << "& " << v.name;
+            sep = ", ";
+        }
+        of_hdr << ");" << std::endl;
+        of_hdr << "    size_t " << stmt.qname() << "Columns(" << cname << "& out";
+        for(auto& v : stmt.varList) {
+            of_hdr << ", const " << v.ntype << "& " << v.name;
+        }
+        of_hdr << ");" << std::endl;
 
-            of_hdr << "      inline pool(DbT& db) : db_(db) {}" << std::endl;
+        auto fqname = ns + name + "::" + stmt.qname();
+        of_src << ns << name << "::" << cname << " " << fqname << "Columns(";
+        sep = "";
+        for(auto& v : stmt.varList) {
+            of_src << sep << "const " << v.ntype << "& " << v.name;
+            sep = ", ";
+        }
+        of_src << ") {" << std::endl;
+        of_src << "  " << cname << " rv;" << std::endl;
+        of_src << "  " << stmt.qname() << "Columns(rv";
+        for(auto& v : stmt.varList) {
+            of_src << ", " << v.name;
+        }
+        of_src << ");" << std::endl;
+        of_src << "  return rv;" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
 
-            of_hdr << "      class guard {" << std::endl;
-            of_hdr << "          pool& cp_;" << std::endl;
-            of_hdr << "          ConnT* iface_;" << std::endl;
-            of_hdr << "      public:" << std::endl;
-            of_hdr << "          inline guard(pool& cp) : cp_(cp), iface_(nullptr) {" << std::endl;
-            of_hdr << "              iface_ = cp_.get();" << std::endl;
-            of_hdr << "          }" << std::endl;
-            of_hdr << "          inline ~guard() {" << std::endl;
-            of_hdr << "              cp_.release(iface_);" << std::endl;
-            of_hdr << "          }" << std::endl;
-            of_hdr << "          inline auto& conn() {" << std::endl;
-            of_hdr << "              return *iface_;" << std::endl;
-            of_hdr << "          }" << std::endl;
-            of_hdr << "          inline operator bool() {" << std::endl;
-            of_hdr << "              return (iface_ == nullptr);" << std::endl;
-            of_hdr << "          }" << std::endl;
-            of_hdr << "      };" << std::endl;
-            of_hdr << "  };" << std::endl;
-            //////
+        // clearing keeps the capacity of the arrays, so refilling the same columns does not allocate
+        of_src << "size_t " << fqname << "Columns(" << cname << "& out";
+        for(auto& v : stmt.varList) {
+            of_src << ", const " << v.ntype << "& " << v.name;
+        }
+        of_src << ") {" << std::endl;
+        of_src << "  " << module.generateBaseNS << "::guard lk(db.db);" << std::endl;
+        of_src << "  auto& st = " << stmt.qname() << "_;" << std::endl;
+        of_src << "  st.reset();" << std::endl;
+        for(auto& v : stmt.varList) {
+            auto ctype = module.storeCast(v.ctype, v.ntype);
+            of_src << "  st.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
+        }
+        of_src << "  out.clear();" << std::endl;
+        of_src << "  while(st.next()){" << std::endl;
+        int idx = 0;
+        for(auto& c : stmt.colList) {
+            if(isTextColumn(c)) {
+                auto fn = (c.ctype == "std::string") ? "appendText" : "appendBlob";
+                of_src << "    st." << fn << "(" << idx << ", out." << c.cname << ");" << std::endl;
+            } else {
+                auto ntype = module.nativeCast(c.ctype, c.ntype);
+                of_src << "    out." << c.cname << ".push(" << ntype << "(st.getColumn<" << c.ctype << ">(" << idx << ")), (st.getColumnType(" << idx << ") == SQLITE_NULL));" << std::endl;
+            }
+            ++idx;
+        }
+        of_src << "    ++out.size;" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  return out.size;" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
 
-            of_hdr << "  struct transaction {" << std::endl;
-            of_hdr << "    database& db_;" << std::endl;
-            of_hdr << "    bool committed_;" << std::endl;
-            of_hdr << "    inline void begin(){db_.begin();}" << std::endl;
-            of_hdr << "    inline void commit(){db_.commit();committed_ = true;}" << std::endl;
-            of_hdr << "    inline void rollback(){db_.exec(\"ROLLBACK;\");}" << std::endl;
-            of_hdr << "    inline transaction& operator=(const transaction& src) = delete;" << std::endl;
-            of_hdr << "    inline transaction(database& db) : db_(db), committed_(false) { begin(); }" << std::endl;
-            of_hdr << "    inline ~transaction() { if (!committed_) rollback(); }" << std::endl;
-            of_hdr << "    " << std::endl;
-            of_hdr << "  };" << std::endl;
-            of_hdr << std::endl;
+    /// \brief generates qnameArrow(), which streams the rows of a select to an arrow_writer in record batches.
+    /// Values are exported as they are stored, integers as int64, reals as float64, text as utf8 and the rest as binary
+    inline void Interface::generateArrow(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        of_hdr << "    size_t " << stmt.qname() << "Arrow(" << module.generateBaseNS << "::arrow_writer& out, const size_t& batchRows";
+        for(auto& v : stmt.varList) {
+            of_hdr << ", const " << v.ntype << "& " << v.name;
+        }
+        of_hdr << ");" << std::endl;
 
-            of_hdr << "  template <typename T, typename I> struct iterator_base {" << std::endl;
-            of_hdr << "    T& stmt;" << std::endl;
-            of_hdr << "    bool last;" << std::endl;
-            //if(module.mutexName.length() > 0) {
-            //    of_hdr << "#if " << module.mutexName << std::endl;
-            //    of_hdr << "      std::unique_lock<std::mutex> lk;" << std::endl;
-            //    of_hdr << "#endif //" << module.mutexName << std::endl;
-            //}
-            of_hdr << "    inline void next() {last = (stmt.next() == false);}" << std::endl;
-            of_hdr << "    inline bool operator  =(const iterator_base& rhs) = delete;" << std::endl;
-            of_hdr << "    inline bool operator !=(const iterator_base& rhs) {return last != rhs.last;}" << std::endl;
-            of_hdr << "    inline bool operator ==(const iterator_base& rhs) {return last == rhs.last;}" << std::endl;
-            of_hdr << "    inline I& operator++() {next();return static_cast<I&>(*this);}" << std::endl;
-            of_hdr << "    inline I& operator*() {return static_cast<I&>(*this);}" << std::endl;
+        auto fqname = ns + name + "::" + stmt.qname();
+        of_src << "size_t " << fqname << "Arrow(" << module.generateBaseNS << "::arrow_writer& out, const size_t& batchRows";
+        for(auto& v : stmt.varList) {
+            of_src << ", const " << v.ntype << "& " << v.name;
+        }
+        of_src << ") {" << std::endl;
+        of_src << "  if(batchRows == 0){" << std::endl;
+        of_src << "    throw std::invalid_argument(\"" << stmt.qname() << "Arrow: batchRows must be positive\");" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  " << module.generateBaseNS << "::guard lk(db.db);" << std::endl;
+        of_src << "  auto& st = " << stmt.qname() << "_;" << std::endl;
+        of_src << "  st.reset();" << std::endl;
+        for(auto& v : stmt.varList) {
+            auto ctype = module.storeCast(v.ctype, v.ntype);
+            of_src << "  st.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
+        }
+        std::string sep;
+        of_src << "  out.begin({";
+        for(auto& c : stmt.colList) {
+            std::string atype = "binary";
+            if(c.ctype == "int64_t") {
+                atype = "int64";
+            } else if(c.ctype == "double") {
+                atype = "float64";
+            } else if(c.ctype == "std::string") {
+                atype = "utf8";
+            }
+            of_src << sep << "{\"" << c.cname << "\", " << module.generateBaseNS << "::arrow_type::" << atype << "}";
+            sep = ", ";
+        }
+        of_src << "});" << std::endl;
+        for(size_t i = 0; i < stmt.colList.size(); ++i) {
+            auto& c = stmt.colList.at(i);
+            if((c.ctype == "int64_t") || (c.ctype == "double")) {
+                of_src << "  " << module.generateBaseNS << "::column<" << c.ctype << "> c" << i << ";" << std::endl;
+            } else {
+                of_src << "  " << module.generateBaseNS << "::text_column c" << i << ";" << std::endl;
+            }
+        }
+        // the columns are cleared after each batch, so memory stays at one batch whatever the size of the result
+        of_src << "  size_t rows = 0;" << std::endl;
+        of_src << "  size_t n = 0;" << std::endl;
+        of_src << "  auto flush = [&](){" << std::endl;
+        for(size_t i = 0; i < stmt.colList.size(); ++i) {
+            of_src << "    out.add(c" << i << ");" << std::endl;
+        }
+        of_src << "    out.batch(n);" << std::endl;
+        for(size_t i = 0; i < stmt.colList.size(); ++i) {
+            of_src << "    c" << i << ".clear();" << std::endl;
+        }
+        of_src << "    rows += n;" << std::endl;
+        of_src << "    n = 0;" << std::endl;
+        of_src << "  };" << std::endl;
+        of_src << "  while(st.next()){" << std::endl;
+        for(size_t i = 0; i < stmt.colList.size(); ++i) {
+            auto& c = stmt.colList.at(i);
+            if((c.ctype == "int64_t") || (c.ctype == "double")) {
+                of_src << "    c" << i << ".push(st.getColumn<" << c.ctype << ">(" << i << "), (st.getColumnType(" << i << ") == SQLITE_NULL));" << std::endl;
+            } else if(c.ctype == "std::string") {
+                of_src << "    st.appendText(" << i << ", c" << i << ");" << std::endl;
+            } else {
+                of_src << "    st.appendBlob(" << i << ", c" << i << ");" << std::endl;
+            }
+        }
+        of_src << "    if(++n == batchRows){" << std::endl;
+        of_src << "      flush();" << std::endl;
+        of_src << "    }" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  if(n > 0){" << std::endl;
+        of_src << "    flush();" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  out.end();" << std::endl;
+        of_src << "  return rows;" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
 
-            of_hdr << "    inline iterator_base(T& s) : stmt(s), last(false) ";
-            //if(module.mutexName.length() > 0) {
-            //    of_hdr << std::endl;
-            //    of_hdr << "#if " << module.mutexName << std::endl;
-            //    of_hdr << "    , lk(s.db_.mx_)" << std::endl;
-            //    of_hdr << "#endif //" << module.mutexName << std::endl;
-            //    of_hdr << "    ";
-            //}
-            of_hdr << "{next();}" << std::endl;
+    inline void Interface::generateSelect(const Module& /*module*/, const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        std::string sep;
+        auto sname = stmt.sname;
+        if(sname == "+") {
+            sname = "row";
+        }
 
-            of_hdr << "    inline iterator_base(T& s, const bool& l) : stmt(s), last(l) " << std::endl;
-            //if(module.mutexName.length() > 0) {
-            //    of_hdr << std::endl;
-            //    of_hdr << "#if " << module.mutexName << std::endl;
-            //    of_hdr << "    , lk(s.db_.mx_, std::defer_lock)" << std::endl;
-            //    of_hdr << "#endif //" << module.mutexName << std::endl;
-            //    of_hdr << "    ";
-            //}
-            of_hdr << "{}" << std::endl;
+        auto fqname = ns + name + "::" + stmt.qname();
+        auto rname = sname;
+        if(sname == "row") {
+            rname = fqname + "_c::row";
+        } else {
+            rname = ns + sname;
+        }
 
-            of_hdr << "    inline iterator_base(const iterator_base&) = delete;" << std::endl;
-            of_hdr << "    inline iterator_base(iterator_base&& src) : stmt(src.stmt)";
-            //if(module.mutexName.length() > 0) {
-            //    of_hdr << std::endl;
-            //    of_hdr << "#if " << module.mutexName << std::endl;
-            //    of_hdr << "    , lk(stmt.db_.mx_)" << std::endl;
-            //    of_hdr << "#endif //" << module.mutexName << std::endl;
-            //    of_hdr << "    ";
-            //}
-            of_hdr << " {assert(false);}" << std::endl;
-            of_hdr << "    inline ~iterator_base() {}" << std::endl;
-            of_hdr << "  };" << std::endl;
-            of_hdr << "}" << std::endl;
-            of_hdr << std::endl;
-            of_hdr << "#endif // !defined(SQLCH_COMMON)" << std::endl;
-            of_hdr << std::endl;
-        } else if(module.generateBase != false) {
-            of_hdr << "#include \"" << module.generateBaseNS << "\"" << std::endl;
+        std::string rtype;
+        switch(stmt.cardinality) {
+        case Cardinality::Many:
+            rtype = "std::vector<" + rname + ">";
+            break;
+        case Cardinality::One:
+            rtype = "std::optional<" + rname + ">";
+            break;
+        case Cardinality::Scalar:
+            rtype = stmt.colList.at(0).ntype;
+            break;
+        case Cardinality::Exists:
+            rtype = "bool";
+            break;
         }
+        auto hasRow = ((stmt.cardinality == Cardinality::Many) || (stmt.cardinality == Cardinality::One));
 
-        // HDR:open namespace in header file
-        std::string ns;
-        std::string nsx;
-        if(module.nsList.size() > 0) {
-            std::string nsep;
-            for(auto& n : module.nsList) {
-                of_hdr << "namespace " << n << " { ";
-                nsx += nsep;
-                nsx += n;
-                nsep = "::";
+        of_hdr << "    struct " << stmt.qname() << "_c : public " << module.generateBaseNS << "::statement {" << std::endl;
+        of_hdr << "      friend struct " << name << ";" << std::endl;
+        if((sname == "row") && hasRow) {
+            of_hdr << "      struct row {" << std::endl;
+            for(auto& c : stmt.colList) {
+                of_hdr << "        " << c.ntype << " " << c.cname << ";" << std::endl;
             }
-            ns = nsx + nsep; // appending terminating ::, if ns is defined
-            of_hdr << std::endl;
+            of_hdr << "      };" << std::endl;
+        }
+        if(stmt.isColumnar) {
+            generateColumnsDecl(stmt, of_hdr);
         }
 
-        // HDR: generate enum's
-        for(auto& e : module.enumList) {
-            of_hdr << "  enum class " << e.name << "{" << std::endl;
-            std::string sep = " ";
-            for(auto& v : e.valueList) {
-                of_hdr << "   " << sep << v << std::endl;
-                sep = ",";
+        of_hdr << "      inline " << stmt.qname() << "_c(" << module.generateBaseNS << "::database& pdb) : statement(pdb) {}" << std::endl;
+        of_hdr << "    };" << std::endl;
+        of_hdr << "    " << stmt.qname() << "_c " << stmt.qname() << "_;" << std::endl;
+
+        std::string ktype;
+        if(stmt.cacheSize > 0) {
+            ktype = "std::tuple<";
+            sep = "";
+            for(auto& v : stmt.varList) {
+                ktype += sep + v.ntype;
+                sep = ", ";
             }
-            of_hdr << "  };// enum" << e.name << std::endl;
-            of_hdr << "  std::string to_string(const " << e.name << "& val);" << std::endl;
-            of_hdr << "  inline std::ostream& operator<<(std::ostream& os, const " << e.name << "& val){" << std::endl;
-            of_hdr << "    os << to_string(val);" << std::endl;
-            of_hdr << "    return os;" << std::endl;
-            of_hdr << "  }" << std::endl;
+            ktype += ">";
+            of_hdr << "    " << module.generateBaseNS << "::lru<" << ktype << ", " << rtype << " > " << stmt.qname() << "_cache_;" << std::endl;
         }
 
-        // SRC:generate definition for common structs required by sqlch
-        // the ---SQLCH metacommand is used to ensure that it is defined only once
-        // in the whole project
-        if(module.generateBase != false) {
-            // SRC: generate code
-            of_src << module.scode << std::endl;
+        if(stmt.pageList.size() > 0) {
+            generatePage(stmt, rname, of_hdr, of_src, ns);
+        }
+        if(stmt.partSql.length() > 0) {
+            generateParallel(stmt, rname, of_hdr, of_src, ns);
+        }
+
+        of_hdr << "    " << rtype << " " << stmt.qname() << "(";
+
+        sep = "";
+        for(auto& v : stmt.varList) {
+            of_hdr << sep << "const " << v.ntype << "& " << v.name;
+            sep = ", ";
+        }
+        of_hdr << ");" << std::endl;
+        auto hasOut = ((stmt.cardinality == Cardinality::Many) && (stmt.cacheSize == 0));
+        if(hasOut) {
+            of_hdr << "    size_t " << stmt.qname() << "(" << rtype << "& out";
+            for(auto& v : stmt.varList) {
+                of_hdr << ", const " << v.ntype << "& " << v.name;
+            }
+            of_hdr << ");" << std::endl;
+        }
+        if(stmt.isColumnar) {
+            generateColumns(stmt, of_hdr, of_src, ns);
+        }
+        if(stmt.isArrow) {
+            generateArrow(stmt, of_hdr, of_src, ns);
+        }
+        of_hdr << std::endl;
+
+        sep = "";
+        of_src << rtype << " " << fqname << "(";
+        for(auto& v : stmt.varList) {
+            of_src << sep << "const " << v.ntype << "& " << v.name;
+            sep = ", ";
+        }
+        of_src << ") {" << std::endl;
+
+        if(stmt.cacheSize > 0) {
+            // the stamp is read before the query runs, so that a write racing
+            // with the query leaves the new entry stale rather than the cache
+            of_src << "  uint64_t stamp = db.db.epoch_";
+            for(auto& t : stmt.readList) {
+                of_src << " + db." << t << "_ver_";
+            }
+            of_src << ";" << std::endl;
+            of_src << "  " << ktype << " key{";
+            sep = "";
+            for(auto& v : stmt.varList) {
+                of_src << sep << v.name;
+                sep = ", ";
+            }
+            of_src << "};" << std::endl;
+            of_src << "  auto cv = " << stmt.qname() << "_cache_.get(key, stamp);" << std::endl;
+            of_src << "  if(cv != nullptr){" << std::endl;
+            of_src << "    return *cv;" << std::endl;
+            of_src << "  }" << std::endl;
+        }
+
+        of_src << "  " << module.generateBaseNS << "::guard lk(db.db);" << std::endl;
+        of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
+        for(auto& v : stmt.varList) {
+            auto ctype = module.storeCast(v.ctype, v.ntype);
+            of_src << "  " << stmt.qname() << "_.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
+        }
+        switch(stmt.cardinality) {
+        case Cardinality::Many:
+            of_src << "  " << rtype << " rv;" << std::endl;
+            of_src << "  while(" << stmt.qname() << "_.next()){" << std::endl;
+            of_src << "    rv.push_back(" << rname << "());" << std::endl;
+            of_src << "    auto& s = rv.back();" << std::endl;
+            generateRowRead(stmt, stmt.qname() + "_", of_src, "    ");
+            of_src << "  }" << std::endl;
+            break;
+        case Cardinality::One:
+            // reset after the first row, so that the statement does not hold the read lock
+            of_src << "  " << rtype << " rv;" << std::endl;
+            of_src << "  if(" << stmt.qname() << "_.next()){" << std::endl;
+            of_src << "    rv.emplace();" << std::endl;
+            of_src << "    auto& s = *rv;" << std::endl;
+            generateRowRead(stmt, stmt.qname() + "_", of_src, "    ");
+            of_src << "  }" << std::endl;
+            of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
+            break;
+        case Cardinality::Scalar: {
+            auto& c = stmt.colList.at(0);
+            auto ntype = module.nativeCast(c.ctype, c.ntype);
+            of_src << "  " << rtype << " rv{};" << std::endl;
+            of_src << "  if(" << stmt.qname() << "_.next()){" << std::endl;
+            of_src << "    rv = " << ntype << "(" << stmt.qname() << "_.getColumn<" << c.ctype << ">(0));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
+            break;
+        }
+        case Cardinality::Exists:
+            of_src << "  " << rtype << " rv = " << stmt.qname() << "_.next();" << std::endl;
+            of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
+            break;
+        }
+        if(stmt.cacheSize > 0) {
+            of_src << "  " << stmt.qname() << "_cache_.put(key, rv, stamp);" << std::endl;
+        }
+        if(stmt.action != SQLITE_SELECT) {
+            generateInvalidate(stmt, of_src);
+        }
+        of_src << "  return rv;" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+
+        if(hasOut) {
+            // refills the caller's rows in place, so that a steady state loop does not allocate
+            of_src << "size_t " << fqname << "(" << rtype << "& out";
+            for(auto& v : stmt.varList) {
+                of_src << ", const " << v.ntype << "& " << v.name;
+            }
+            of_src << ") {" << std::endl;
+            of_src << "  " << module.generateBaseNS << "::guard lk(db.db);" << std::endl;
+            of_src << "  " << stmt.qname() << "_.reset();" << std::endl;
+            for(auto& v : stmt.varList) {
+                auto ctype = module.storeCast(v.ctype, v.ntype);
+                of_src << "  " << stmt.qname() << "_.setParam<" << v.ctype << ">(\":" << v.name << "\", " << ctype << "(" << v.name << ")" << ");" << std::endl;
+            }
+            of_src << "  size_t n = 0;" << std::endl;
+            of_src << "  while(" << stmt.qname() << "_.next()){" << std::endl;
+            of_src << "    if(n == out.size()){" << std::endl;
+            of_src << "      out.emplace_back();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto& s = out[n];" << std::endl;
+            generateRowRead(stmt, stmt.qname() + "_", of_src, "    ", true);
+            of_src << "    ++n;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  out.resize(n);" << std::endl;
+            if(stmt.action != SQLITE_SELECT) {
+                generateInvalidate(stmt, of_src);
+            }
+            of_src << "  return n;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+        }
+    }
+
+
+    /// \brief generates importT(path, cfg), which bulk loads a CSV file into a table, each column bound as it is stored
+    inline void Interface::generateImport(const Statement& stmt, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        of_hdr << "    size_t import" << stmt.tname << "(const std::string& path, const " << module.generateBaseNS << "::import_config& cfg = " << module.generateBaseNS << "::import_config());" << std::endl;
+
+        of_src << "size_t " << ns << name << "::import" << stmt.tname << "(const std::string& path, const " << module.generateBaseNS << "::import_config& cfg) {" << std::endl;
+        of_src << "  static const std::vector<" << module.generateBaseNS << "::import_column> cols = {";
+        std::string sep;
+        for(auto& c : stmt.colList) {
+            std::string type = "SQLITE_BLOB";
+            if(c.ctype == "int64_t") {
+                type = "SQLITE_INTEGER";
+            } else if(c.ctype == "double") {
+                type = "SQLITE_FLOAT";
+            } else if(c.ctype == "std::string") {
+                type = "SQLITE_TEXT";
+            }
+            of_src << sep << "{\"" << c.cname << "\", " << type << "}";
+            sep = ", ";
+        }
+        of_src << "};" << std::endl;
+        of_src << "  auto rv = " << module.generateBaseNS << "::importCsv(db, path, \"" << stmt.tname << "\", cols, cfg);" << std::endl;
+        if(db.hasCache()) {
+            of_src << "  ++" << stmt.tname << "_ver_;" << std::endl;
+            of_src << "  " << stmt.tname << "_dirty_ = true;" << std::endl;
+        }
+        of_src << "  return rv;" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
+
+    /// \brief generates the commit listener of the database, which bumps the versions of the
+    /// tables written by the transaction and pushes its changes to the rings once it has committed
+    inline void Interface::generateListener(std::ostream& of_src, const std::string& ns) const {
+        of_src << "void " << ns << name << "::committed() {" << std::endl;
+        for(auto& s : stmtList) {
+            if(s.action != SQLITE_CREATE_TABLE) {
+                continue;
+            }
+            if(db.hasCache()) {
+                of_src << "  if(" << s.tname << "_dirty_.exchange(false)){" << std::endl;
+                of_src << "    ++" << s.tname << "_ver_;" << std::endl;
+                of_src << "  }" << std::endl;
+            }
+            if(s.cdcSize > 0) {
+                of_src << "  for(auto& ch : " << s.tname << "_pending_){" << std::endl;
+                of_src << "    " << s.tname << "_events.push(std::move(ch));" << std::endl;
+                of_src << "  }" << std::endl;
+                of_src << "  " << s.tname << "_pending_.clear();" << std::endl;
+            }
+        }
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+        // the connection has bumped its epoch, which every stamp includes
+        of_src << "void " << ns << name << "::rolledBack() {" << std::endl;
+        for(auto& s : stmtList) {
+            if(s.action != SQLITE_CREATE_TABLE) {
+                continue;
+            }
+            if(db.hasCache()) {
+                of_src << "  " << s.tname << "_dirty_ = false;" << std::endl;
+            }
+            if(s.cdcSize > 0) {
+                of_src << "  " << s.tname << "_pending_.clear();" << std::endl;
+            }
+        }
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
+
+    /// \brief generates the read of a row of a table from the preupdate hook, fn is sqlite3_preupdate_old or _new
+    inline void Interface::generateChangeRow(const Statement& stmt, const std::string& fn, std::ostream& of_src) const {
+        of_src << "        " << stmt.tname << " s;" << std::endl;
+        int idx = 0;
+        for(auto& c : stmt.colList) {
+            auto ntype = module.nativeCast(c.ctype, c.ntype);
+            of_src << "        ::" << fn << "(conn, " << idx << ", &v);" << std::endl;
+            of_src << "        s." << c.cname << " = " << ntype << "(" << module.generateBaseNS << "::getValue<" << c.ctype << ">(v));" << std::endl;
+            ++idx;
+        }
+    }
+
+    /// \brief generates enableChanges(), which captures the changes to the CDC tables of the database.
+    /// Changes are collected as they happen, and the commit listener pushes them to the rings once
+    /// the transaction has committed
+    inline void Interface::generateChanges(std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        of_hdr << "    void enableChanges();" << std::endl;
+
+        of_src << "void " << ns << name << "::enableChanges() {" << std::endl;
+        of_src << "#if defined(SQLITE_ENABLE_PREUPDATE_HOOK)" << std::endl;
+        of_src << "  if(!db.ownPreupdate(this, \"enableChanges\")){" << std::endl;
+        of_src << "    return;" << std::endl;
+        of_src << "  }" << std::endl;
+        of_src << "  ::sqlite3_preupdate_hook(db.val_, [](void* ctx, sqlite3* conn, int op, const char* dbname, const char* table, sqlite3_int64 oldKey, sqlite3_int64 newKey){" << std::endl;
+        of_src << "    auto self = static_cast<" << name << "*>(ctx);" << std::endl;
+        of_src << "    if(::strcmp(dbname, \"main\") != 0){" << std::endl;
+        of_src << "      return;" << std::endl;
+        of_src << "    }" << std::endl;
+        of_src << "    sqlite3_value* v = nullptr;" << std::endl;
+        for(auto& s : stmtList) {
+            if(s.cdcSize == 0) {
+                continue;
+            }
+            of_src << "    if(::strcmp(table, \"" << s.tname << "\") == 0){" << std::endl;
+            of_src << "      " << s.tname << "_change ch{};" << std::endl;
+            of_src << "      ch.op = (op == SQLITE_INSERT) ? " << module.generateBaseNS << "::change_op::insert : ((op == SQLITE_DELETE) ? " << module.generateBaseNS << "::change_op::remove : " << module.generateBaseNS << "::change_op::update);" << std::endl;
+            of_src << "      ch.rowid = (op == SQLITE_DELETE) ? oldKey : newKey;" << std::endl;
+            of_src << "      if(op != SQLITE_INSERT){" << std::endl;
+            generateChangeRow(s, "sqlite3_preupdate_old", of_src);
+            of_src << "        ch.before = std::move(s);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if(op != SQLITE_DELETE){" << std::endl;
+            generateChangeRow(s, "sqlite3_preupdate_new", of_src);
+            of_src << "        ch.after = std::move(s);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      self->" << s.tname << "_pending_.push_back(std::move(ch));" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+        }
+        of_src << "  }, this);" << std::endl;
+        of_src << "#else" << std::endl;
+        // without the preupdate hook, only the operation and the rowid are known
+        of_src << "  ::sqlite3_update_hook(db.val_, [](void* ctx, int op, const char* dbname, const char* table, sqlite3_int64 rowid){" << std::endl;
+        of_src << "    auto self = static_cast<" << name << "*>(ctx);" << std::endl;
+        of_src << "    if(::strcmp(dbname, \"main\") != 0){" << std::endl;
+        of_src << "      return;" << std::endl;
+        of_src << "    }" << std::endl;
+        for(auto& s : stmtList) {
+            if(s.cdcSize == 0) {
+                continue;
+            }
+            of_src << "    if(::strcmp(table, \"" << s.tname << "\") == 0){" << std::endl;
+            of_src << "      " << s.tname << "_change ch{};" << std::endl;
+            of_src << "      ch.op = (op == SQLITE_INSERT) ? " << module.generateBaseNS << "::change_op::insert : ((op == SQLITE_DELETE) ? " << module.generateBaseNS << "::change_op::remove : " << module.generateBaseNS << "::change_op::update);" << std::endl;
+            of_src << "      ch.rowid = rowid;" << std::endl;
+            of_src << "      self->" << s.tname << "_pending_.push_back(std::move(ch));" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+        }
+        of_src << "  }, this);" << std::endl;
+        of_src << "#endif" << std::endl;
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
+
+    /// \brief returns the type returned by the generated method of a statement
+    inline std::string Interface::getReturnType(const Statement& stmt, const std::string& ns) const {
+        if(stmt.colList.size() > 0) {
+            auto rname = (stmt.sname == "+") ? (ns + name + "::" + stmt.qname() + "_c::row") : (ns + stmt.sname);
+            switch(stmt.cardinality) {
+            case Cardinality::Many:
+                return "std::vector<" + rname + ">";
+            case Cardinality::One:
+                return "std::optional<" + rname + ">";
+            case Cardinality::Scalar:
+                return stmt.colList.at(0).ntype;
+            case Cardinality::Exists:
+                return "bool";
+            }
+        }
+        if(stmt.isUpsert) {
+            return module.generateBaseNS + "::upsert_result";
+        }
+        switch(stmt.action) {
+        case SQLITE_INSERT:
+            return module.isAutoIncrement ? stmt.pktype() : "void";
+        case SQLITE_UPDATE:
+            return "size_t";
+        }
+        return "void";
+    }
+
+    /// \brief returns the parameters of a procedure, a variable used by more than one statement is passed once
+    inline std::vector<Variable> Interface::getProcVariables() const {
+        std::vector<Variable> vlist;
+        for(auto& s : stmtList) {
+            for(auto& v : s.varList) {
+                bool found = false;
+                for(auto& pv : vlist) {
+                    if(pv.name == v.name) {
+                        if(pv.ntype != v.ntype) {
+                            std::cout << "Error:Variable " << v.name << " has different types in PROCEDURE " << name << std::endl;
+                            exit(1);
+                        }
+                        found = true;
+                    }
+                }
+                if(!found) {
+                    vlist.push_back(v);
+                }
+            }
+        }
+        return vlist;
+    }
+
+    /// \brief generates run(), which runs all statements of a procedure in one IMMEDIATE transaction,
+    /// holding the connection for its duration, and returns the result of the last one
+    inline void Interface::generateRun(std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        if(stmtList.size() == 0) {
+            std::cout << "Error:PROCEDURE " << name << " has no statements" << std::endl;
+            exit(1);
+        }
+        auto rtype = getReturnType(stmtList.back(), ns);
+        auto vlist = getProcVariables();
+        std::string sep;
+        of_hdr << "    " << rtype << " run(";
+        for(auto& v : vlist) {
+            of_hdr << sep << "const " << v.ntype << "& " << v.name;
+            sep = ", ";
+        }
+        of_hdr << ");" << std::endl;
+
+        sep = "";
+        of_src << rtype << " " << ns << name << "::run(";
+        for(auto& v : vlist) {
+            of_src << sep << "const " << v.ntype << "& " << v.name;
+            sep = ", ";
+        }
+        of_src << ") {" << std::endl;
+        std::string conn = "db.db";
+        of_src << "  " << module.generateBaseNS << "::connection_lock lk(" << conn << ");" << std::endl;
+        of_src << "  " << module.generateBaseNS << "::transaction t(" << conn << ", true);" << std::endl;
+        for(size_t i = 0; i < stmtList.size(); ++i) {
+            auto& st = stmtList.at(i);
+            of_src << "  ";
+            if((i + 1 == stmtList.size()) && (rtype != "void")) {
+                of_src << "auto rv = ";
+            }
+            of_src << st.qname() << "(";
+            sep = "";
+            for(auto& v : st.varList) {
+                of_src << sep << v.name;
+                sep = ", ";
+            }
+            of_src << ");" << std::endl;
+        }
+        of_src << "  t.commit();" << std::endl;
+        if(rtype != "void") {
+            of_src << "  return rv;" << std::endl;
+        }
+        of_src << "}" << std::endl;
+        of_src << std::endl;
+    }
+
+    inline void Interface::generateIfaceDecl(const Module& module, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        if (isDB) {
+            return;
+        }
+        of_hdr << "  struct " << name << ";" << std::endl;
+    }
+
+    inline void Interface::generate(const Module& module, std::ostream& of_hdr, std::ostream& of_src, const std::string& ns) const {
+        // the sql strings are used by the generated methods, so they come first
+        for(auto& s : stmtList) {
+            if(s.isCalled) {
+                continue;
+            }
+            generateEncString(module, s, of_hdr, of_src, ns);
+            for(auto& fk : s.fkList) {
+                const Column* key = nullptr;
+                if(getLoader(s, fk, key)) {
+                    Statement ls(SQLITE_SELECT, getLoaderSql(s, fk));
+                    ls.qname_ = "load" + s.tname + "_" + fk.from;
+                    generateEncString(module, ls, of_hdr, of_src, ns);
+                }
+            }
+            if(s.pageList.size() > 0) {
+                Statement fs(s.action, s.pageFirst);
+                fs.qname_ = s.qname() + "_first";
+                generateEncString(module, fs, of_hdr, of_src, ns);
+                Statement ns_(s.action, s.pageNext);
+                ns_.qname_ = s.qname() + "_next";
+                generateEncString(module, ns_, of_hdr, of_src, ns);
+            }
+            if(s.partSql.length() > 0) {
+                Statement rs(s.action, s.partRange);
+                rs.qname_ = s.qname() + "_range";
+                generateEncString(module, rs, of_hdr, of_src, ns);
+                Statement ps(s.action, s.partSql);
+                ps.qname_ = s.qname() + "_part";
+                generateEncString(module, ps, of_hdr, of_src, ns);
+            }
+        }
+
+        if(isDB && (db.hasCache() || db.hasChanges())) {
+            of_hdr << "  struct " << name << " : public " << module.generateBaseNS << "::commit_listener {" << std::endl;
+        } else {
+            of_hdr << "  struct " << name << " {" << std::endl;
+        }
+        if(isDB) {
+            of_hdr << "    " << module.generateBaseNS << "::database db;" << std::endl;
+            of_hdr << "    std::string name;" << std::endl;
+            of_hdr << "    " << module.generateBaseNS << "::readers readers;" << std::endl;
+            of_hdr << "    " << module.generateBaseNS << "::maintenance maintenance;" << std::endl;
+            of_hdr << "    " << module.generateBaseNS << "::replication replication;" << std::endl;
+            if(db.hasCache()) {
+                // bumped by every generated write, checked by cached selects. A write inside
+                // a transaction leaves its table dirty, to be bumped again when it commits, so
+                // that results cached meanwhile from other connections are dropped
+                for(auto& s : stmtList) {
+                    if(s.action == SQLITE_CREATE_TABLE) {
+                        of_hdr << "    std::atomic<uint64_t> " << s.tname << "_ver_{0};" << std::endl;
+                        of_hdr << "    std::atomic<bool> " << s.tname << "_dirty_{false};" << std::endl;
+                    }
+                }
+            }
+            if(db.hasCache() || db.hasChanges()) {
+                of_hdr << "    void committed() override;" << std::endl;
+                of_hdr << "    void rolledBack() override;" << std::endl;
+                generateListener(of_src, ns);
+            }
+        } else {
+            of_hdr << "    typedef " << module.generateBaseNS << "::pool<" << db.db().name << ", " << name << ">::guard guard;" << std::endl;
+            of_hdr << "    " << db.db().name << "& db;" << std::endl;
+        }
+
+        for(auto& s : stmtList) {
+            switch(s.action) {
+            case SQLITE_CREATE_TABLE:
+                generateCreateTable(s, of_hdr);
+                generateUpdateTable(s, of_hdr, of_src, ns);
+                generateLoaders(s, of_hdr, of_src, ns);
+                generateImport(s, of_hdr, of_src, ns);
+                if(s.cdcSize > 0) {
+                    of_hdr << "    typedef " << module.generateBaseNS << "::change<" << s.tname << "> " << s.tname << "_change;" << std::endl;
+                    of_hdr << "    " << module.generateBaseNS << "::ring<" << s.tname << "_change> " << s.tname << "_events;" << std::endl;
+                    of_hdr << "    std::vector<" << s.tname << "_change> " << s.tname << "_pending_;" << std::endl;
+                }
+                break;
+            case SQLITE_INSERT:
+            case SQLITE_UPDATE:
+            case SQLITE_DELETE:
+                if(s.colList.size() > 0) {
+                    generateSelect(module, s, of_hdr, of_src, ns);
+                } else if(s.isUpsert) {
+                    generateUpsert(s, of_hdr, of_src, ns);
+                } else if(s.action == SQLITE_INSERT) {
+                    generateInsert(s, of_hdr, of_src, ns);
+                } else if(s.action == SQLITE_UPDATE) {
+                    generateUpdate(s, of_hdr, of_src, ns);
+                } else {
+                    generateDelete(s, of_hdr, of_src, ns);
+                }
+                break;
+            case SQLITE_SELECT:
+                generateSelect(module, s, of_hdr, of_src, ns);
+                break;
+            }
+        }
+
+        if(isProc) {
+            generateRun(of_hdr, of_src, ns);
+        }
+
+        if(isDB && db.hasChanges()) {
+            generateChanges(of_hdr, of_src, ns);
+        }
+
+        if(isDB) {
+            of_hdr << "    void create(const std::string& filename, const char* vfs = nullptr);" << std::endl;
+            of_hdr << "    void openrw(const std::string& filename, const char* vfs = nullptr);" << std::endl;
+            of_hdr << "    void openro(const std::string& filename, const char* vfs = nullptr);" << std::endl;
+            // a procedure runs on an instance taken from its pool
+            for(auto& iface : db.interfaceList) {
+                if(!iface.isProc) {
+                    continue;
+                }
+                auto rtype = iface.getReturnType(iface.stmtList.back(), ns);
+                auto vlist = iface.getProcVariables();
+                std::string sep;
+                of_hdr << "    " << rtype << " run" << iface.name << "(";
+                for(auto& v : vlist) {
+                    of_hdr << sep << "const " << v.ntype << "& " << v.name;
+                    sep = ", ";
+                }
+                of_hdr << ");" << std::endl;
+
+                sep = "";
+                of_src << rtype << " " << ns << name << "::run" << iface.name << "(";
+                for(auto& v : vlist) {
+                    of_src << sep << "const " << v.ntype << "& " << v.name;
+                    sep = ", ";
+                }
+                of_src << ") {" << std::endl;
+                of_src << "  " << iface.name << "::guard g(" << iface.name << "Pool);" << std::endl;
+                of_src << "  return g.conn().run(";
+                sep = "";
+                for(auto& v : vlist) {
+                    of_src << sep << v.name;
+                    sep = ", ";
+                }
+                of_src << ");" << std::endl;
+                of_src << "}" << std::endl;
+                of_src << std::endl;
+            }
+        } else {
+            of_hdr << "    void open();" << std::endl;
+        }
+        of_hdr << "    inline " << name << "& operator=(const " << name << "&) = delete;" << std::endl;
+        of_hdr << "    inline " << name << "(const " << name << "&) = delete;" << std::endl;
+        of_hdr << "    inline " << name << "& operator=(" << name << "&&) = delete;" << std::endl;
+        of_hdr << "    inline " << name << "(" << name << "&&) = delete;" << std::endl;
+
+        std::string sep;
+        if(isDB) {
+            of_hdr << "    inline " << name << "() : readers(db), maintenance(db), replication(db)";
+            for(auto& s : stmtList) {
+                if(s.cdcSize > 0) {
+                    of_hdr << ", " << s.tname << "_events(" << s.cdcSize << ")";
+                }
+            }
+            sep = ", ";
+            for (auto& db : module.dbList) {
+                for (auto& iface : db.interfaceList) {
+                    if (!iface.isDB) {
+                        of_hdr << sep << iface.name << "Pool(*this)";
+                        sep = ",";
+                    }
+                }
+            }
+        } else {
+            // the second constructor prepares the statements on another connection, such as a pinned reader
+            of_hdr << "    inline " << name << "(" << db.db().name << "& d, const bool& doOpen = true) : " << name << "(d, d.db, doOpen) {}" << std::endl;
+            of_hdr << "    inline " << name << "(" << db.db().name << "& d, " << module.generateBaseNS << "::database& conn, const bool& doOpen = true) : db(d)";
+            sep = ", ";
+        }
+        for(auto& s : stmtList) {
+            switch(s.action) {
+            case SQLITE_CREATE_TABLE:
+                break;
+            case SQLITE_INSERT:
+            case SQLITE_UPDATE:
+            case SQLITE_DELETE:
+            case SQLITE_SELECT:
+                of_hdr << sep << s.qname() << "_(conn)";
+                sep = ", ";
+                if(s.cacheSize > 0) {
+                    of_hdr << sep << s.qname() << "_cache_(" << s.cacheSize << ")";
+                }
+                if(s.pageList.size() > 0) {
+                    of_hdr << sep << s.qname() << "_first_(conn)";
+                    of_hdr << sep << s.qname() << "_next_(conn)";
+                }
+                break;
+            }
+        }
+
+        if (isDB) {
+            if(db.hasCache() || db.hasChanges()) {
+                of_hdr << " {db.listen(this);}" << std::endl;
+            } else {
+                of_hdr << " {}" << std::endl;
+            }
+            for (auto& db : module.dbList) {
+                for (auto& iface : db.interfaceList) {
+                    if (!iface.isDB) {
+                        of_hdr << "    " << module.generateBaseNS << "::pool<" << name << "," << iface.name << "> " << iface.name << "Pool;" << std::endl;
+                    }
+                }
+            }
+        }else{
+            of_hdr << " {if(doOpen){open();}}" << std::endl;
+        }
+        of_hdr << "  };" << std::endl;
+        of_hdr << std::endl;
+
+        if(isDB) {
+            of_src << "void " << ns << name << "::create(const std::string& filename, const char* vfs) {" << std::endl;
+            of_src << "  FILE* fp = ::fopen(filename.c_str(), \"r\");" << std::endl;
+            of_src << "  if(fp){" << std::endl;
+            of_src << "    ::fclose(fp);" << std::endl;
+            of_src << "    ::remove(filename.c_str());" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  db.create(filename, vfs);" << std::endl;
+            of_src << "  db.exec(\"PRAGMA page_size = 4096;\");" << std::endl;
+            of_src << "  " << module.generateBaseNS << "::transaction t(db);" << std::endl;
+            for(auto& s : stmtList) {
+                switch(s.action) {
+                case SQLITE_CREATE_TABLE:
+                case SQLITE_CREATE_INDEX:
+                    of_src << "  db.exec(" << s.qname() << "_s());" << std::endl;
+                    break;
+                }
+            }
+            of_src << "  t.commit();" << std::endl;
+            of_src << "  if(name.size() == 0){" << std::endl;
+            of_src << "    name = filename;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << ns << name << "::openrw(const std::string& filename, const char* vfs) {" << std::endl;
+            of_src << "  db.openrw(filename, vfs);" << std::endl;
+            of_src << "  if(name.size() == 0){" << std::endl;
+            of_src << "    name = filename;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << ns << name << "::openro(const std::string& filename, const char* vfs) {" << std::endl;
+            of_src << "  db.openro(filename, vfs);" << std::endl;
+            of_src << "  if(name.size() == 0){" << std::endl;
+            of_src << "    name = filename;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+        } else {
+            of_src << "void " << ns << name << "::open() {" << std::endl;
+            for(auto& s : stmtList) {
+                switch(s.action) {
+                case SQLITE_INSERT:
+                case SQLITE_UPDATE:
+                case SQLITE_DELETE:
+                case SQLITE_SELECT:
+                    of_src << "  " << s.qname() << "_.open(" << s.qname() << "_s(), \"" << name << "." << s.qname() << "\");" << std::endl;
+                    if(s.pageList.size() > 0) {
+                        of_src << "  " << s.qname() << "_first_.open(" << s.qname() << "_first_s(), \"" << name << "." << s.qname() << "\");" << std::endl;
+                        of_src << "  " << s.qname() << "_next_.open(" << s.qname() << "_next_s(), \"" << name << "." << s.qname() << "\");" << std::endl;
+                    }
+                    break;
+                }
+            }
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+        }
+        of_src << std::endl;
+    }
+
+    inline void generate(const std::string& odir, const Module& module) {
+        auto bname = odir + module.name;
+        std::cout << "Generating:[" << bname + ".hpp"
+                  << "] and [" << bname + ".cpp"
+                  << "]" << std::endl;
+
+        // open src and hdr files
+        std::ofstream of_hdr(bname + ".hpp");
+        if(!of_hdr.is_open()) {
+            std::cout << "Error:Unable to open file:" << bname << ".hpp" << std::endl;
+            exit(1);
+        }
+        std::ofstream of_src(bname + ".cpp");
+        if(!of_src.is_open()) {
+            std::cout << "Error:Unable to open file:" << bname << ".cpp" << std::endl;
+            exit(1);
+        }
+
+        // HDR:generate includes
+        of_hdr << "#pragma once" << std::endl;
+        of_hdr << std::endl;
+        of_hdr << "#include <string>" << std::endl;
+        of_hdr << "#include <vector>" << std::endl;
+        of_hdr << "#include <optional>" << std::endl;
+        of_hdr << "#include <list>" << std::endl;
+        of_hdr << "#include <map>" << std::endl;
+        of_hdr << "#include <unordered_map>" << std::endl;
+        of_hdr << "#include <tuple>" << std::endl;
+        of_hdr << "#include <memory>" << std::endl;
+        of_hdr << "#include <atomic>" << std::endl;
+        of_hdr << "#include <mutex>" << std::endl;
+        of_hdr << "#include <condition_variable>" << std::endl;
+        of_hdr << "#include <chrono>" << std::endl;
+        of_hdr << "#include <thread>" << std::endl;
+        of_hdr << "#include <exception>" << std::endl;
+        of_hdr << "#include <stdexcept>" << std::endl;
+        of_hdr << "#include <algorithm>" << std::endl;
+        of_hdr << "#include <iterator>" << std::endl;
+        of_hdr << "#include <array>" << std::endl;
+        of_hdr << "#include <cstdint>" << std::endl;
+        of_hdr << "#include <cstring>" << std::endl;
+        of_hdr << "#include <string_view>" << std::endl;
+        of_hdr << "#include <cstdio>" << std::endl;
+        of_hdr << "#include <cerrno>" << std::endl;
+        of_hdr << "#include <type_traits>" << std::endl;
+        of_hdr << "#include <cassert>" << std::endl;
+        of_hdr << "#include <sqlite3.h>" << std::endl;
+        for(auto& i : module.includeList) {
+            of_hdr << "#include \"" << i << "\"" << std::endl;
+        }
+        of_hdr << std::endl;
+
+        // SRC:generate includes
+        of_src << "#include <iostream>" << std::endl;
+        for(auto& i : module.importList) {
+            of_src << "#include \"" << i << "\"" << std::endl;
+        }
+        of_src << "#include \"" << module.name << ".hpp\"" << std::endl;
+        of_src << std::endl;
+
+        // HDR:generate declaration for common structs required by sqlch
+        if(module.generateBase != false) {
+            // SQLCH_COMMON used is to ensure that the structs are not redefined when more than one
+            // of the generated files are included in the same cpp file
+            of_hdr << "#if !defined(SQLCH_COMMON)" << std::endl;
+            of_hdr << "#define SQLCH_COMMON 1" << std::endl;
+            // declared by sqlite3.h only with SQLITE_ENABLE_SESSION
+            of_hdr << "typedef struct sqlite3_session sqlite3_session;" << std::endl;
+            of_hdr << "namespace " << module.generateBaseNS << " {" << std::endl;
+            of_hdr << "  std::string error(sqlite3* db);" << std::endl;
+            of_hdr << "  struct database;" << std::endl;
+            of_hdr << "  class replication;" << std::endl;
+            of_hdr << "  enum class upsert_result { none, inserted, updated };" << std::endl;
+            of_hdr << "  struct array_ref;" << std::endl;
+            of_hdr << "  struct io_counters;" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // the values of one column of a result, valid has a bit set for each value that is not NULL" << std::endl;
+            of_hdr << "  template <typename T>" << std::endl;
+            of_hdr << "  struct column {" << std::endl;
+            of_hdr << "    std::vector<T> values;" << std::endl;
+            of_hdr << "    std::vector<uint64_t> valid;" << std::endl;
+            of_hdr << "    inline size_t size() const {return values.size();}" << std::endl;
+            of_hdr << "    inline const T& operator[](const size_t& i) const {return values[i];}" << std::endl;
+            of_hdr << "    inline bool isNull(const size_t& i) const {return (((valid[i >> 6] >> (i & 63)) & 1) == 0);}" << std::endl;
+            of_hdr << "    inline void clear() {values.clear();valid.clear();}" << std::endl;
+            of_hdr << "    inline void push(T&& val, const bool& isNull) {" << std::endl;
+            of_hdr << "      auto i = values.size();" << std::endl;
+            of_hdr << "      if ((i & 63) == 0) {" << std::endl;
+            of_hdr << "        valid.push_back(0);" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      if (!isNull) {" << std::endl;
+            of_hdr << "        valid.back() |= (uint64_t(1) << (i & 63));" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      values.push_back(std::move(val));" << std::endl;
+            of_hdr << "    }" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // the values of a text or blob column packed in one arena, value i is at [offsets[i], offsets[i + 1])" << std::endl;
+            of_hdr << "  struct text_column {" << std::endl;
+            of_hdr << "    std::vector<int32_t> offsets;" << std::endl;
+            of_hdr << "    std::string arena;" << std::endl;
+            of_hdr << "    std::vector<uint64_t> valid;" << std::endl;
+            of_hdr << "    inline size_t size() const {return (offsets.size() > 0) ? (offsets.size() - 1) : 0;}" << std::endl;
+            of_hdr << "    inline std::string_view operator[](const size_t& i) const {return std::string_view(arena.data() + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i]));}" << std::endl;
+            of_hdr << "    inline bool isNull(const size_t& i) const {return (((valid[i >> 6] >> (i & 63)) & 1) == 0);}" << std::endl;
+            of_hdr << "    inline void clear() {offsets.clear();arena.clear();valid.clear();}" << std::endl;
+            of_hdr << "    inline void push(const void* data, const size_t& len, const bool& isNull) {" << std::endl;
+            of_hdr << "      if (offsets.size() == 0) {" << std::endl;
+            of_hdr << "        offsets.push_back(0);" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      auto i = offsets.size() - 1;" << std::endl;
+            of_hdr << "      if ((i & 63) == 0) {" << std::endl;
+            of_hdr << "        valid.push_back(0);" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      if (!isNull) {" << std::endl;
+            of_hdr << "        valid.back() |= (uint64_t(1) << (i & 63));" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      if (len > 0) {" << std::endl;
+            of_hdr << "        arena.append(static_cast<const char*>(data), len);" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      offsets.push_back(static_cast<int32_t>(arena.size()));" << std::endl;
+            of_hdr << "    }" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            // the types without a specialization of setParam and getColumn, bound and read as the bytes of their elements
+            of_hdr << "  template <typename T, typename = void> struct is_blob : std::false_type {};" << std::endl;
+            of_hdr << "  template <typename T> struct is_blob<T, std::void_t<decltype(std::data(std::declval<T&>())), decltype(std::size(std::declval<T&>()))>>" << std::endl;
+            of_hdr << "    : std::is_trivially_copyable<typename std::remove_pointer<decltype(std::data(std::declval<T&>()))>::type> {};" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct statement {" << std::endl;
+            of_hdr << "    database& db_;" << std::endl;
+            of_hdr << "    sqlite3_stmt* val_;" << std::endl;
+            of_hdr << "    io_counters* io_;" << std::endl;
+            of_hdr << "    void open(const std::string& sql, const char* name = nullptr);" << std::endl;
+            of_hdr << "    void close();" << std::endl;
+            of_hdr << "    bool next();" << std::endl;
+            if(module.isAutoIncrement){
+                of_hdr << "    uint64_t insert();" << std::endl;
+            }else{
+                of_hdr << "    void insert();" << std::endl;
+            }
+            of_hdr << "    size_t update();" << std::endl;
+            of_hdr << "    upsert_result upsert();" << std::endl;
+            of_hdr << "    void xdelete();" << std::endl;
+            of_hdr << "    void reset();" << std::endl;
+            of_hdr << "    size_t getColumnCount();" << std::endl;
+            of_hdr << "    int getColumnType(const size_t& idx);" << std::endl;
+            of_hdr << "    void setParamFloat(const std::string& key, const double& val);" << std::endl;
+            of_hdr << "    double getColumnFloat(const int& idx);" << std::endl;
+            of_hdr << "    void setParamLong(const std::string& key, const int64_t& val);" << std::endl;
+            of_hdr << "    int64_t getColumnLong(const int& idx);" << std::endl;
+            of_hdr << "    void setParamText(const std::string& key, const std::string& val);" << std::endl;
+            of_hdr << "    std::string getColumnText(const int& idx);" << std::endl;
+            of_hdr << "    void setParamBlob(const std::string& key, const void* val, const size_t& len);" << std::endl;
+            of_hdr << "    std::vector<uint8_t> getColumnBlob(const int& idx);" << std::endl;
+            of_hdr << "    size_t getColumnBlob(const int& idx, void* val, const size_t& len);" << std::endl;
+            of_hdr << "    void setParamArray(const std::string& key, const array_ref& val);" << std::endl;
+            of_hdr << "    void getColumn(const int& idx, std::string& val);" << std::endl;
+            of_hdr << "    void getColumn(const int& idx, std::vector<uint8_t>& val);" << std::endl;
+            of_hdr << "    void appendText(const int& idx, text_column& col);" << std::endl;
+            of_hdr << "    void appendBlob(const int& idx, text_column& col);" << std::endl;
+            of_hdr << "    template <typename T> inline void setParam(const std::string& key, const T& val);" << std::endl;
+            of_hdr << "    template <typename T> inline T getColumn(const int& idx);" << std::endl;
+            of_hdr << "  protected:" << std::endl;
+            of_hdr << "    inline statement(database& db) : db_(db), val_(nullptr), io_(nullptr){}" << std::endl;
+            of_hdr << "    inline statement(const statement&) = delete;" << std::endl;
+            of_hdr << "    inline statement(statement&&) = delete;" << std::endl;
+            of_hdr << "    inline ~statement() {close();}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            // any other type is a fixed size byte container, such as std::array<uint8_t, 16>, bound as a blob of its bytes
+            of_hdr << "  template <typename T> inline void statement::setParam(const std::string& key, const T& val) {" << std::endl;
+            of_hdr << "    static_assert(is_blob<const T>::value, \"setParam: T is not a column type, nor a contiguous container of trivially copyable elements\");" << std::endl;
+            of_hdr << "    return setParamBlob(key, std::data(val), std::size(val) * sizeof(*std::data(val)));" << std::endl;
+            of_hdr << "  }" << std::endl;
+            of_hdr << "  template <typename T> inline T statement::getColumn(const int& idx) {" << std::endl;
+            of_hdr << "    static_assert(is_blob<T>::value, \"getColumn: T is not a column type, nor a contiguous container of trivially copyable elements\");" << std::endl;
+            of_hdr << "    T val{};" << std::endl;
+            of_hdr << "    getColumnBlob(idx, std::data(val), std::size(val) * sizeof(*std::data(val)));" << std::endl;
+            of_hdr << "    return val;" << std::endl;
+            of_hdr << "  }" << std::endl;
+            of_hdr << "  template <> inline void statement::setParam<double>(const std::string& key, const double& val) { return setParamFloat(key, val); }" << std::endl;
+            of_hdr << "  template <> inline double statement::getColumn<double>(const int& idx) { return getColumnFloat(idx); }" << std::endl;
+            of_hdr << "  template <> inline void statement::setParam<int64_t>(const std::string& key, const int64_t& val) { return setParamLong(key, val); }" << std::endl;
+            of_hdr << "  template <> inline int64_t statement::getColumn<int64_t>(const int& idx) { return getColumnLong(idx); }" << std::endl;
+            of_hdr << "  template <> inline void statement::setParam<std::string>(const std::string& key, const std::string& val) { return setParamText(key, val); }" << std::endl;
+            of_hdr << "  template <> inline std::string statement::getColumn<std::string>(const int& idx) { return getColumnText(idx); }" << std::endl;
+            of_hdr << "  template <> inline void statement::setParam<std::vector<uint8_t>>(const std::string& key, const std::vector<uint8_t>& val) { return setParamBlob(key, val.data(), val.size()); }" << std::endl;
+            of_hdr << "  template <> inline std::vector<uint8_t> statement::getColumn<std::vector<uint8_t>>(const int& idx) { return getColumnBlob(idx); }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // a value from a hook, such as sqlite3_preupdate_old(), read like a column" << std::endl;
+            of_hdr << "  template <typename T> inline T getValue(sqlite3_value* v) {" << std::endl;
+            of_hdr << "    T val{};" << std::endl;
+            of_hdr << "    auto len = std::min(static_cast<size_t>(::sqlite3_value_bytes(v)), std::size(val) * sizeof(*std::data(val)));" << std::endl;
+            of_hdr << "    if (len > 0) {" << std::endl;
+            of_hdr << "      ::memcpy(std::data(val), ::sqlite3_value_blob(v), len);" << std::endl;
+            of_hdr << "    }" << std::endl;
+            of_hdr << "    return val;" << std::endl;
+            of_hdr << "  }" << std::endl;
+            of_hdr << "  template <> inline double getValue<double>(sqlite3_value* v) { return ::sqlite3_value_double(v); }" << std::endl;
+            of_hdr << "  template <> inline int64_t getValue<int64_t>(sqlite3_value* v) { return ::sqlite3_value_int64(v); }" << std::endl;
+            of_hdr << "  template <> inline std::string getValue<std::string>(sqlite3_value* v) {" << std::endl;
+            of_hdr << "    auto p = ::sqlite3_value_text(v);" << std::endl;
+            of_hdr << "    return (p != nullptr) ? std::string(reinterpret_cast<const char*>(p), static_cast<size_t>(::sqlite3_value_bytes(v))) : std::string();" << std::endl;
+            of_hdr << "  }" << std::endl;
+            of_hdr << "  template <> inline std::vector<uint8_t> getValue<std::vector<uint8_t>>(sqlite3_value* v) {" << std::endl;
+            of_hdr << "    auto p = static_cast<const uint8_t*>(::sqlite3_value_blob(v));" << std::endl;
+            of_hdr << "    return (p != nullptr) ? std::vector<uint8_t>(p, p + ::sqlite3_value_bytes(v)) : std::vector<uint8_t>();" << std::endl;
+            of_hdr << "  }" << std::endl;
+            of_hdr << std::endl;
+
+            // chrono durations and time points are stored as INTEGER counts of their own duration (since the epoch)
+            of_hdr << "  template <typename T> struct epoch {" << std::endl;
+            of_hdr << "    static inline T from(const int64_t& val) { return T(static_cast<typename T::rep>(val)); }" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << "  template <typename C, typename D> struct epoch<std::chrono::time_point<C, D>> {" << std::endl;
+            of_hdr << "    static inline std::chrono::time_point<C, D> from(const int64_t& val) { return std::chrono::time_point<C, D>(epoch<D>::from(val)); }" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << "  template <typename R, typename P> inline int64_t to_epoch(const std::chrono::duration<R, P>& val) { return static_cast<int64_t>(val.count()); }" << std::endl;
+            of_hdr << "  template <typename C, typename D> inline int64_t to_epoch(const std::chrono::time_point<C, D>& val) { return to_epoch(val.time_since_epoch()); }" << std::endl;
+            of_hdr << "  template <typename T> inline T from_epoch(const int64_t& val) { return epoch<T>::from(val); }" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  // a list bound to sqlch_array(:name); it points into the caller's vector, and get() reads an element" << std::endl;
+            of_hdr << "  struct array_ref {" << std::endl;
+            of_hdr << "    const void* data;" << std::endl;
+            of_hdr << "    size_t size;" << std::endl;
+            of_hdr << "    void (*get)(sqlite3_context* ctx, const void* data, const size_t& idx);" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << "  template <typename T> inline void array_get(sqlite3_context* ctx, const void* data, const size_t& idx) {" << std::endl;
+            of_hdr << "    auto& val = static_cast<const T*>(data)[idx];" << std::endl;
+            of_hdr << "    if constexpr(std::is_same<T, std::string>::value) {" << std::endl;
+            of_hdr << "      ::sqlite3_result_text(ctx, val.c_str(), static_cast<int>(val.length()), nullptr);" << std::endl;
+            of_hdr << "    } else if constexpr(std::is_floating_point<T>::value) {" << std::endl;
+            of_hdr << "      ::sqlite3_result_double(ctx, static_cast<double>(val));" << std::endl;
+            of_hdr << "    } else if constexpr(std::is_integral<T>::value || std::is_enum<T>::value) {" << std::endl;
+            of_hdr << "      ::sqlite3_result_int64(ctx, static_cast<int64_t>(val));" << std::endl;
+            of_hdr << "    } else {" << std::endl;
+            of_hdr << "      ::sqlite3_result_int64(ctx, to_epoch(val));" << std::endl;
+            of_hdr << "    }" << std::endl;
+            of_hdr << "  }" << std::endl;
+            of_hdr << "  template <typename T> inline array_ref make_array(const std::vector<T>& val) { return array_ref{val.data(), val.size(), &array_get<T>}; }" << std::endl;
+            of_hdr << "  template <> inline void statement::setParam<array_ref>(const std::string& key, const array_ref& val) { return setParamArray(key, val); }" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  struct exstatement : public " << module.generateBaseNS << "::statement {" << std::endl;
+            of_hdr << "    inline exstatement(database& db) : statement(db){}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  struct runtime_config {" << std::endl;
+            of_hdr << "    bool poolAllocator;" << std::endl;
+            of_hdr << "    bool countAllocs;" << std::endl;
+            of_hdr << "    int lookasideSize;" << std::endl;
+            of_hdr << "    int lookasideCount;" << std::endl;
+            of_hdr << "    int64_t softHeapLimit;" << std::endl;
+            of_hdr << "    int64_t hardHeapLimit;" << std::endl;
+            of_hdr << "    int64_t pageCacheBudget;" << std::endl;
+            of_hdr << "    int64_t mmapSize;" << std::endl;
+            of_hdr << "    inline runtime_config() : poolAllocator(false), countAllocs(false), lookasideSize(0), lookasideCount(0), softHeapLimit(0), hardHeapLimit(0), pageCacheBudget(0), mmapSize(0) {}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct alloc_stats {" << std::endl;
+            of_hdr << "    uint64_t mallocs;" << std::endl;
+            of_hdr << "    uint64_t reallocs;" << std::endl;
+            of_hdr << "    uint64_t frees;" << std::endl;
+            of_hdr << "    uint64_t pooled;" << std::endl;
+            of_hdr << "    int64_t used;" << std::endl;
+            of_hdr << "    int64_t highwater;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  bool initialize(const runtime_config& cfg = runtime_config());" << std::endl;
+            of_hdr << "  alloc_stats allocStats();" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct pcache_stats {" << std::endl;
+            of_hdr << "    uint64_t hits;" << std::endl;
+            of_hdr << "    uint64_t misses;" << std::endl;
+            of_hdr << "    uint64_t evictions;" << std::endl;
+            of_hdr << "    size_t pages;" << std::endl;
+            of_hdr << "    int64_t bytes;" << std::endl;
+            of_hdr << "    int64_t budget;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  pcache_stats pageCacheStats();" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct io_counters {" << std::endl;
+            of_hdr << "    std::atomic<uint64_t> reads;" << std::endl;
+            of_hdr << "    std::atomic<uint64_t> readBytes;" << std::endl;
+            of_hdr << "    std::atomic<uint64_t> writes;" << std::endl;
+            of_hdr << "    std::atomic<uint64_t> writeBytes;" << std::endl;
+            of_hdr << "    std::atomic<uint64_t> syncs;" << std::endl;
+            of_hdr << "    inline io_counters() : reads(0), readBytes(0), writes(0), writeBytes(0), syncs(0) {}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct io_stats {" << std::endl;
+            of_hdr << "    uint64_t reads;" << std::endl;
+            of_hdr << "    uint64_t readBytes;" << std::endl;
+            of_hdr << "    uint64_t writes;" << std::endl;
+            of_hdr << "    uint64_t writeBytes;" << std::endl;
+            of_hdr << "    uint64_t syncs;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // the VFS counting the I/O done while each statement runs, to pass to create, openrw or openro" << std::endl;
+            of_hdr << "  const char* const statsVfs = \"sqlch-stats\";" << std::endl;
+            of_hdr << "  bool registerStatsVfs(const char* root = nullptr);" << std::endl;
+            of_hdr << "  io_counters* ioCounters(const std::string& name);" << std::endl;
+            of_hdr << "  std::map<std::string, io_stats> ioStats();" << std::endl;
+            of_hdr << "#if SQLCH_IO_URING" << std::endl;
+            of_hdr << "  // the VFS doing its reads, writes and syncs through io_uring, to pass to create, openrw or openro" << std::endl;
+            of_hdr << "  const char* const uringVfs = \"sqlch-uring\";" << std::endl;
+            of_hdr << "  bool registerUringVfs(const bool& makeDefault = false);" << std::endl;
+            of_hdr << "#endif" << std::endl;
+            of_hdr << std::endl;
+            // told once a transaction on the connection has committed or rolled back
+            of_hdr << "  struct commit_listener {" << std::endl;
+            of_hdr << "    virtual void committed() = 0;" << std::endl;
+            of_hdr << "    virtual void rolledBack() = 0;" << std::endl;
+            of_hdr << "  protected:" << std::endl;
+            of_hdr << "    inline ~commit_listener() = default;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct database {" << std::endl;
+            of_hdr << "    sqlite3* val_;" << std::endl;
+            of_hdr << "    exstatement beginTx_;" << std::endl;
+            of_hdr << "    exstatement beginImmTx_;" << std::endl;
+            of_hdr << "    exstatement commitTx_;" << std::endl;
+            of_hdr << "    std::string filename_;" << std::endl;
+            of_hdr << "    std::atomic<uint64_t> epoch_;" << std::endl;
+            of_hdr << "    std::string vfs_;" << std::endl;
+            of_hdr << "    replication* repl_;" << std::endl;
+            of_hdr << "    std::atomic<bool> committed_;" << std::endl;
+            of_hdr << "    std::vector<commit_listener*> listeners_;" << std::endl;
+            // the one preupdate hook of the connection, wanted by both replication (its session) and enableChanges()
+            of_hdr << "    void* preupdate_;" << std::endl;
+            //if(module.mutexName.length() > 0) {
+            //    of_hdr << "#if " << module.mutexName << std::endl;
+            //    of_hdr << "    std::mutex mx_;" << std::endl;
+            //    of_hdr << "#endif //" << module.mutexName << std::endl;
+            //}
+            of_hdr << "    inline database(const database&) = delete;" << std::endl;
+            of_hdr << "    inline database(database&&) = delete;" << std::endl;
+            of_hdr << "    void open(const std::string& filename, const int& flags, const char* vfs);" << std::endl;
+            of_hdr << "    void close();" << std::endl;
+            of_hdr << "    inline void begin(){beginTx_.reset();beginTx_.next();}" << std::endl;
+            of_hdr << "    inline void beginImmediate(){beginImmTx_.reset();beginImmTx_.next();}" << std::endl;
+            of_hdr << "    void commit();" << std::endl;
+            of_hdr << "    void exec(const std::string& sqls);" << std::endl;
+            // the commit hook runs before COMMIT is done, so the listeners are told only once
+            // a statement has returned with the connection back in autocommit mode
+            of_hdr << "    inline void afterStep(){if(committed_.load(std::memory_order_relaxed)){onCommitted();}}" << std::endl;
+            of_hdr << "    void onCommitted();" << std::endl;
+            of_hdr << "    void listen(commit_listener* l);" << std::endl;
+            of_hdr << "    void unlisten(commit_listener* l);" << std::endl;
+            of_hdr << "    bool ownPreupdate(void* owner, const std::string& src);" << std::endl;
+            of_hdr << "    inline void releasePreupdate(void* owner){if(preupdate_ == owner){preupdate_ = nullptr;}}" << std::endl;
+            of_hdr << "    inline void create(const std::string& filename, const char* vfs){open(filename, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, vfs);}" << std::endl;
+            of_hdr << "    inline void openro(const std::string& filename, const char* vfs){open(filename, SQLITE_OPEN_READONLY, vfs);}" << std::endl;
+            of_hdr << "    inline void openrw(const std::string& filename, const char* vfs){open(filename, SQLITE_OPEN_READWRITE, vfs);}" << std::endl;
+            of_hdr << "    inline auto isOpen() {return (val_ != nullptr);}" << std::endl;
+            of_hdr << "    inline auto& filename() const {return filename_;}" << std::endl;
+            of_hdr << "    inline const char* vfs() const {return (vfs_.length() > 0) ? vfs_.c_str() : nullptr;}" << std::endl;
+            of_hdr << "    inline database() : val_(nullptr), beginTx_(*this), beginImmTx_(*this), commitTx_(*this), epoch_(0), repl_(nullptr), committed_(false), preupdate_(nullptr) {}" << std::endl;
+            of_hdr << "    inline ~database() {close();}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  struct guard {" << std::endl;
+            //if(module.mutexName.length() > 0) {
+            //    of_hdr << "#if " << module.mutexName << std::endl;
+            //    of_hdr << "    std::lock_guard<std::mutex> lk_;" << std::endl;
+            //    of_hdr << "#endif //" << module.mutexName << std::endl;
+            //    of_hdr << "#if " << module.mutexName << std::endl;
+            //    of_hdr << "    inline guard(database& db) : lk_(db.mx_){}" << std::endl;
+            //    of_hdr << "#else" << std::endl;
+            //    of_hdr << "    inline guard(database&){}" << std::endl;
+            //    of_hdr << "#endif //" << module.mutexName << std::endl;
+            //} else {
+            //    of_hdr << "    inline guard(database&){}" << std::endl;
+            //}
+            of_hdr << "    inline guard(database&){}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            //////
+            of_hdr << "  struct pool_config {" << std::endl;
+            of_hdr << "    size_t maxSize;" << std::endl;
+            of_hdr << "    size_t maxIdle;" << std::endl;
+            of_hdr << "    std::chrono::milliseconds idleTimeout;" << std::endl;
+            of_hdr << "    int64_t stmtBudget;" << std::endl;
+            of_hdr << "    inline pool_config() : maxSize(0), maxIdle(64), idleTimeout(0), stmtBudget(0) {}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct pool_stats {" << std::endl;
+            of_hdr << "    size_t size;" << std::endl;
+            of_hdr << "    size_t idle;" << std::endl;
+            of_hdr << "    uint64_t waits;" << std::endl;
+            of_hdr << "    uint64_t timeouts;" << std::endl;
+            of_hdr << "    uint64_t evictions;" << std::endl;
+            of_hdr << "    int cacheUsed;" << std::endl;
+            of_hdr << "    int stmtUsed;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  template <typename DbT, typename ConnT>" << std::endl;
+            of_hdr << "  class pool {" << std::endl;
+            of_hdr << "      struct entry {" << std::endl;
+            of_hdr << "          ConnT conn;" << std::endl;
+            // steady_clock ticks of the last release, read by evict() while the entry may be in use
+            of_hdr << "          std::atomic<int64_t> used;" << std::endl;
+            of_hdr << "          inline entry(DbT& db) : conn(db), used(0) {}" << std::endl;
+            of_hdr << "      };" << std::endl;
+            of_hdr << "      DbT& db_;" << std::endl;
+            of_hdr << "      pool_config cfg_;" << std::endl;
+            of_hdr << "      size_t slots_;" << std::endl;
+            of_hdr << "      std::unique_ptr<std::atomic<entry*>[]> free_;" << std::endl;
+            of_hdr << "      std::atomic<size_t> size_;" << std::endl;
+            of_hdr << "      std::atomic<size_t> waiting_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> waits_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> timeouts_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> evictions_;" << std::endl;
+            of_hdr << "      std::atomic<int64_t> lastEvict_;" << std::endl;
+            of_hdr << "      std::mutex mx_;" << std::endl;
+            of_hdr << "      std::condition_variable cv_;" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline entry* take() {" << std::endl;
+            of_hdr << "          for (size_t i = 0; i < slots_; ++i) {" << std::endl;
+            of_hdr << "              if (free_[i].load(std::memory_order_relaxed) != nullptr) {" << std::endl;
+            of_hdr << "                  auto e = free_[i].exchange(nullptr, std::memory_order_acquire);" << std::endl;
+            of_hdr << "                  if (e != nullptr) {" << std::endl;
+            of_hdr << "                      return e;" << std::endl;
+            of_hdr << "                  }" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          return nullptr;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline entry* create() {" << std::endl;
+            of_hdr << "          auto n = size_.load();" << std::endl;
+            of_hdr << "          while ((cfg_.maxSize == 0) || (n < cfg_.maxSize)) {" << std::endl;
+            of_hdr << "              if (size_.compare_exchange_weak(n, n + 1)) {" << std::endl;
+            of_hdr << "                  auto e = new entry(db_);" << std::endl;
+            of_hdr << "                  return e;" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          return nullptr;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline void destroy(entry* e) {" << std::endl;
+            of_hdr << "          delete e;" << std::endl;
+            of_hdr << "          --size_;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            // a waiter counts itself and looks at the slots with mx_ held, so checking under mx_ too
+            // means that either it sees the entry just released, or it is waiting and gets woken
+            of_hdr << "      inline void notify() {" << std::endl;
+            of_hdr << "          std::lock_guard<std::mutex> lk(mx_);" << std::endl;
+            of_hdr << "          if (waiting_.load(std::memory_order_relaxed) > 0) {" << std::endl;
+            of_hdr << "              cv_.notify_one();" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      inline entry* acquire(const std::chrono::milliseconds& timeout = std::chrono::milliseconds(-1)) {" << std::endl;
+            of_hdr << "          auto e = take();" << std::endl;
+            of_hdr << "          if (e == nullptr) {" << std::endl;
+            of_hdr << "              e = create();" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          if (e != nullptr) {" << std::endl;
+            of_hdr << "              return e;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "          std::unique_lock<std::mutex> lk(mx_);" << std::endl;
+            of_hdr << "          ++waiting_;" << std::endl;
+            of_hdr << "          ++waits_;" << std::endl;
+            of_hdr << "          auto ready = [this, &e]() {" << std::endl;
+            of_hdr << "              e = take();" << std::endl;
+            of_hdr << "              if (e == nullptr) {" << std::endl;
+            of_hdr << "                  e = create();" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "              return (e != nullptr);" << std::endl;
+            of_hdr << "          };" << std::endl;
+            of_hdr << "          if (timeout.count() < 0) {" << std::endl;
+            of_hdr << "              cv_.wait(lk, ready);" << std::endl;
+            of_hdr << "          } else if (!cv_.wait_for(lk, timeout, ready)) {" << std::endl;
+            of_hdr << "              ++timeouts_;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          --waiting_;" << std::endl;
+            of_hdr << "          return e;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline void release(entry* e) {" << std::endl;
+            of_hdr << "          e->used.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);" << std::endl;
+            of_hdr << "          bool keep = true;" << std::endl;
+            of_hdr << "          if (cfg_.stmtBudget > 0) {" << std::endl;
+            of_hdr << "              keep = (stats().stmtUsed <= cfg_.stmtBudget);" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          for (size_t i = 0; (keep && (i < slots_)); ++i) {" << std::endl;
+            of_hdr << "              entry* x = nullptr;" << std::endl;
+            of_hdr << "              if (free_[i].compare_exchange_strong(x, e, std::memory_order_acq_rel)) {" << std::endl;
+            of_hdr << "                  e = nullptr;" << std::endl;
+            of_hdr << "                  break;" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          if (e != nullptr) {" << std::endl;
+            of_hdr << "              destroy(e);" << std::endl;
+            of_hdr << "              ++evictions_;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          notify();" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "          if (cfg_.idleTimeout.count() > 0) {" << std::endl;
+            of_hdr << "              auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();" << std::endl;
+            of_hdr << "              auto last = lastEvict_.load();" << std::endl;
+            of_hdr << "              if (((now - last) > (cfg_.idleTimeout.count() / 2)) && lastEvict_.compare_exchange_strong(last, now)) {" << std::endl;
+            of_hdr << "                  evict();" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline void evict() {" << std::endl;
+            of_hdr << "          auto now = std::chrono::steady_clock::now().time_since_epoch().count();" << std::endl;
+            of_hdr << "          auto idle = std::chrono::duration_cast<std::chrono::steady_clock::duration>(cfg_.idleTimeout).count();" << std::endl;
+            of_hdr << "          for (size_t i = 0; i < slots_; ++i) {" << std::endl;
+            of_hdr << "              auto e = free_[i].load(std::memory_order_acquire);" << std::endl;
+            of_hdr << "              if ((e == nullptr) || ((now - e->used.load(std::memory_order_relaxed)) <= idle) || !free_[i].compare_exchange_strong(e, nullptr)) {" << std::endl;
+            of_hdr << "                  continue;" << std::endl;
+            of_hdr << "              }" << std::endl;
+            // the entry may have been taken and released again before the claim, so it is checked once it is ours
+            of_hdr << "              entry* x = nullptr;" << std::endl;
+            of_hdr << "              if (((now - e->used.load(std::memory_order_relaxed)) <= idle) && free_[i].compare_exchange_strong(x, e, std::memory_order_acq_rel)) {" << std::endl;
+            of_hdr << "                  continue;" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "              destroy(e);" << std::endl;
+            of_hdr << "              ++evictions_;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline pool_stats stats() const {" << std::endl;
+            of_hdr << "          pool_stats s;" << std::endl;
+            of_hdr << "          s.size = size_.load();" << std::endl;
+            of_hdr << "          s.idle = 0;" << std::endl;
+            of_hdr << "          for (size_t i = 0; i < slots_; ++i) {" << std::endl;
+            of_hdr << "              if (free_[i].load(std::memory_order_relaxed) != nullptr) {" << std::endl;
+            of_hdr << "                  ++s.idle;" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          s.waits = waits_.load();" << std::endl;
+            of_hdr << "          s.timeouts = timeouts_.load();" << std::endl;
+            of_hdr << "          s.evictions = evictions_.load();" << std::endl;
+            of_hdr << "          int hi = 0;" << std::endl;
+            of_hdr << "          s.cacheUsed = 0;" << std::endl;
+            of_hdr << "          s.stmtUsed = 0;" << std::endl;
+            of_hdr << "          if (db_.db.val_ != nullptr) {" << std::endl;
+            of_hdr << "              ::sqlite3_db_status(db_.db.val_, SQLITE_DBSTATUS_CACHE_USED, &s.cacheUsed, &hi, 0);" << std::endl;
+            of_hdr << "              ::sqlite3_db_status(db_.db.val_, SQLITE_DBSTATUS_STMT_USED, &s.stmtUsed, &hi, 0);" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          return s;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline void configure(const pool_config& cfg) {" << std::endl;
+            of_hdr << "          assert(size_.load() == 0);" << std::endl;
+            of_hdr << "          cfg_ = cfg;" << std::endl;
+            of_hdr << "          slots_ = ((cfg_.maxSize > 0) && (cfg_.maxSize < cfg_.maxIdle)) ? cfg_.maxSize : cfg_.maxIdle;" << std::endl;
+            of_hdr << "          free_.reset(new std::atomic<entry*>[slots_]);" << std::endl;
+            of_hdr << "          for (size_t i = 0; i < slots_; ++i) {" << std::endl;
+            of_hdr << "              free_[i] = nullptr;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline pool(DbT& db) : db_(db), slots_(0), size_(0), waiting_(0), waits_(0), timeouts_(0), evictions_(0), lastEvict_(0) {" << std::endl;
+            of_hdr << "          configure(pool_config());" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      inline ~pool() {" << std::endl;
+            of_hdr << "          for (size_t i = 0; i < slots_; ++i) {" << std::endl;
+            of_hdr << "              auto e = free_[i].exchange(nullptr);" << std::endl;
+            of_hdr << "              if (e != nullptr) {" << std::endl;
+            of_hdr << "                  destroy(e);" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "      class guard {" << std::endl;
+            of_hdr << "          pool& cp_;" << std::endl;
+            of_hdr << "          entry* e_;" << std::endl;
+            of_hdr << "      public:" << std::endl;
+            of_hdr << "          inline guard(pool& cp) : cp_(cp), e_(cp.acquire()) {}" << std::endl;
+            of_hdr << "          inline guard(pool& cp, const std::chrono::milliseconds& timeout) : cp_(cp), e_(cp.acquire(timeout)) {}" << std::endl;
+            of_hdr << "          inline ~guard() {" << std::endl;
+            of_hdr << "              if (e_ != nullptr) {" << std::endl;
+            of_hdr << "                  cp_.release(e_);" << std::endl;
+            of_hdr << "              }" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          inline auto& conn() {" << std::endl;
+            of_hdr << "              return e_->conn;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          inline operator bool() {" << std::endl;
+            of_hdr << "              return (e_ != nullptr);" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "      };" << std::endl;
+            of_hdr << "  };" << std::endl;
+            //////
+
+            of_hdr << "  template <typename K, typename V>" << std::endl;
+            of_hdr << "  class lru {" << std::endl;
+            of_hdr << "      typedef std::list<std::pair<K, V> > list_t;" << std::endl;
+            of_hdr << "      size_t max_;" << std::endl;
+            of_hdr << "      uint64_t stamp_;" << std::endl;
+            of_hdr << "      list_t list_;" << std::endl;
+            of_hdr << "      std::map<K, typename list_t::iterator> map_;" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      inline const V* get(const K& key, const uint64_t& stamp) {" << std::endl;
+            of_hdr << "          if (stamp != stamp_) {" << std::endl;
+            of_hdr << "              clear();" << std::endl;
+            of_hdr << "              stamp_ = stamp;" << std::endl;
+            of_hdr << "              return nullptr;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          auto it = map_.find(key);" << std::endl;
+            of_hdr << "          if (it == map_.end()) {" << std::endl;
+            of_hdr << "              return nullptr;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          list_.splice(list_.begin(), list_, it->second);" << std::endl;
+            of_hdr << "          return &(it->second->second);" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      inline void put(const K& key, const V& val, const uint64_t& stamp) {" << std::endl;
+            of_hdr << "          if (stamp != stamp_) {" << std::endl;
+            of_hdr << "              return;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          auto it = map_.find(key);" << std::endl;
+            of_hdr << "          if (it != map_.end()) {" << std::endl;
+            of_hdr << "              it->second->second = val;" << std::endl;
+            of_hdr << "              list_.splice(list_.begin(), list_, it->second);" << std::endl;
+            of_hdr << "              return;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          if (list_.size() >= max_) {" << std::endl;
+            of_hdr << "              map_.erase(list_.back().first);" << std::endl;
+            of_hdr << "              list_.pop_back();" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          list_.emplace_front(key, val);" << std::endl;
+            of_hdr << "          map_[key] = list_.begin();" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      inline void clear() {" << std::endl;
+            of_hdr << "          map_.clear();" << std::endl;
+            of_hdr << "          list_.clear();" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      inline lru(const size_t& m) : max_(m), stamp_(0) {}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  class readers {" << std::endl;
+            of_hdr << "      database& db_;" << std::endl;
+            of_hdr << "      std::mutex mx_;" << std::endl;
+            of_hdr << "      std::vector<std::unique_ptr<database> > pool_;" << std::endl;
+            of_hdr << "      std::vector<database*> free_;" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      inline database* get() {" << std::endl;
+            of_hdr << "          std::lock_guard<std::mutex> lg(mx_);" << std::endl;
+            of_hdr << "          database* r = nullptr;" << std::endl;
+            of_hdr << "          if (free_.size() > 0) {" << std::endl;
+            of_hdr << "              r = free_.back();" << std::endl;
+            of_hdr << "              free_.pop_back();" << std::endl;
+            of_hdr << "          } else {" << std::endl;
+            of_hdr << "              pool_.push_back(std::unique_ptr<database>(new database()));" << std::endl;
+            of_hdr << "              r = pool_.back().get();" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          if (r->filename() != db_.filename()) {" << std::endl;
+            of_hdr << "              r->openro(db_.filename(), db_.vfs());" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          return r;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      inline void release(database* r) {" << std::endl;
+            of_hdr << "          std::lock_guard<std::mutex> lg(mx_);" << std::endl;
+            of_hdr << "          free_.push_back(r);" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      inline readers(database& db) : db_(db) {}" << std::endl;
+            of_hdr << "      class guard {" << std::endl;
+            of_hdr << "          readers& rs_;" << std::endl;
+            of_hdr << "          database* conn_;" << std::endl;
+            of_hdr << "      public:" << std::endl;
+            of_hdr << "          inline guard(readers& rs) : rs_(rs), conn_(rs.get()) {}" << std::endl;
+            of_hdr << "          inline ~guard() {rs_.release(conn_);}" << std::endl;
+            of_hdr << "          inline database& conn() {return *conn_;}" << std::endl;
+            of_hdr << "      };" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  class snapshot {" << std::endl;
+            of_hdr << "      readers& rs_;" << std::endl;
+            of_hdr << "      database* holder_;" << std::endl;
+            of_hdr << "      sqlite3_snapshot* val_;" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      void pin(database& conn);" << std::endl;
+            of_hdr << "      void unpin(database& conn);" << std::endl;
+            of_hdr << "      inline bool isValid() const {return (val_ != nullptr);}" << std::endl;
+            of_hdr << "      snapshot(readers& rs);" << std::endl;
+            of_hdr << "      ~snapshot();" << std::endl;
+            of_hdr << "      inline snapshot(const snapshot&) = delete;" << std::endl;
+            of_hdr << "      inline snapshot& operator=(const snapshot&) = delete;" << std::endl;
+            of_hdr << "      class reader {" << std::endl;
+            of_hdr << "          snapshot& snap_;" << std::endl;
+            of_hdr << "          readers::guard g_;" << std::endl;
+            of_hdr << "      public:" << std::endl;
+            of_hdr << "          inline reader(snapshot& snap) : snap_(snap), g_(snap.rs_) {snap_.pin(g_.conn());}" << std::endl;
+            of_hdr << "          inline ~reader() {snap_.unpin(g_.conn());}" << std::endl;
+            of_hdr << "          inline database& conn() {return g_.conn();}" << std::endl;
+            of_hdr << "      };" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  struct maintenance_config {" << std::endl;
+            of_hdr << "    std::chrono::milliseconds checkpointInterval;" << std::endl;
+            of_hdr << "    int walFrames;" << std::endl;
+            of_hdr << "    int truncateFrames;" << std::endl;
+            of_hdr << "    std::chrono::milliseconds optimizeInterval;" << std::endl;
+            of_hdr << "    std::chrono::milliseconds vacuumInterval;" << std::endl;
+            of_hdr << "    int vacuumPages;" << std::endl;
+            of_hdr << "    inline maintenance_config() : checkpointInterval(1000), walFrames(1000), truncateFrames(4000), optimizeInterval(3600000), vacuumInterval(10000), vacuumPages(64) {}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct maintenance_stats {" << std::endl;
+            of_hdr << "    uint64_t checkpoints;" << std::endl;
+            of_hdr << "    uint64_t truncates;" << std::endl;
+            of_hdr << "    uint64_t busy;" << std::endl;
+            of_hdr << "    int walFrames;" << std::endl;
+            of_hdr << "    int backfilled;" << std::endl;
+            of_hdr << "    std::chrono::microseconds lastCheckpoint;" << std::endl;
+            of_hdr << "    std::chrono::microseconds maxCheckpoint;" << std::endl;
+            of_hdr << "    uint64_t optimizes;" << std::endl;
+            of_hdr << "    uint64_t vacuumedPages;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  class maintenance {" << std::endl;
+            of_hdr << "      database& db_;" << std::endl;
+            of_hdr << "      database conn_;" << std::endl;
+            of_hdr << "      maintenance_config cfg_;" << std::endl;
+            of_hdr << "      std::thread thread_;" << std::endl;
+            of_hdr << "      std::mutex mx_;" << std::endl;
+            of_hdr << "      std::condition_variable cv_;" << std::endl;
+            of_hdr << "      bool stop_;" << std::endl;
+            of_hdr << "      bool incremental_;" << std::endl;
+            of_hdr << "      int autoCheckpoint_;" << std::endl;
+            of_hdr << "      std::atomic<int> frames_;" << std::endl;
+            of_hdr << "      std::atomic<int> ckptFrames_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> checkpoints_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> truncates_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> busy_;" << std::endl;
+            of_hdr << "      std::atomic<int> backfilled_;" << std::endl;
+            of_hdr << "      std::atomic<int64_t> lastCheckpoint_;" << std::endl;
+            of_hdr << "      std::atomic<int64_t> maxCheckpoint_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> optimizes_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> vacuumed_;" << std::endl;
+            of_hdr << "      static int onWal(void* ctx, sqlite3* db, const char* name, int frames);" << std::endl;
+            of_hdr << "      inline bool isWalDue() const {" << std::endl;
+            of_hdr << "          auto f = frames_.load();" << std::endl;
+            of_hdr << "          auto c = ckptFrames_.load();" << std::endl;
+            of_hdr << "          return (((f < c) ? f : (f - c)) >= cfg_.walFrames);" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      int pragma(const char* sql);" << std::endl;
+            of_hdr << "      void checkpoint(const bool& truncate);" << std::endl;
+            of_hdr << "      void optimize();" << std::endl;
+            of_hdr << "      void vacuum();" << std::endl;
+            of_hdr << "      void run();" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      void start(const maintenance_config& cfg = maintenance_config());" << std::endl;
+            of_hdr << "      void stop();" << std::endl;
+            of_hdr << "      maintenance_stats stats() const;" << std::endl;
+            of_hdr << "      inline bool isRunning() const {return thread_.joinable();}" << std::endl;
+            of_hdr << "      inline maintenance(database& db) : db_(db), stop_(false), incremental_(false), autoCheckpoint_(0), frames_(0), ckptFrames_(0), checkpoints_(0), truncates_(0), busy_(0), backfilled_(0), lastCheckpoint_(0), maxCheckpoint_(0), optimizes_(0), vacuumed_(0) {}" << std::endl;
+            of_hdr << "      inline ~maintenance() {stop();}" << std::endl;
+            of_hdr << "      inline maintenance(const maintenance&) = delete;" << std::endl;
+            of_hdr << "      inline maintenance& operator=(const maintenance&) = delete;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // receives the changeset of each committed transaction of a replicated database" << std::endl;
+            of_hdr << "  struct changeset_sink {" << std::endl;
+            of_hdr << "    virtual void write(const void* data, const size_t& size) = 0;" << std::endl;
+            of_hdr << "    virtual ~changeset_sink() {}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // appends changesets to a file (or a pipe), each prefixed with its size" << std::endl;
+            of_hdr << "  class file_sink : public changeset_sink {" << std::endl;
+            of_hdr << "      FILE* fp_;" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      void write(const void* data, const size_t& size) override;" << std::endl;
+            of_hdr << "      file_sink(const std::string& path);" << std::endl;
+            of_hdr << "      ~file_sink() override;" << std::endl;
+            of_hdr << "      inline file_sink(const file_sink&) = delete;" << std::endl;
+            of_hdr << "      inline file_sink& operator=(const file_sink&) = delete;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // reads the changesets written by a file_sink, next() returns false until a whole one is available" << std::endl;
+            of_hdr << "  class file_source {" << std::endl;
+            of_hdr << "      FILE* fp_;" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      bool next(std::vector<uint8_t>& changeset);" << std::endl;
+            of_hdr << "      file_source(const std::string& path);" << std::endl;
+            of_hdr << "      ~file_source();" << std::endl;
+            of_hdr << "      inline file_source(const file_source&) = delete;" << std::endl;
+            of_hdr << "      inline file_source& operator=(const file_source&) = delete;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct replication_stats {" << std::endl;
+            of_hdr << "    uint64_t published;" << std::endl;
+            of_hdr << "    uint64_t publishedBytes;" << std::endl;
+            of_hdr << "    uint64_t applied;" << std::endl;
+            of_hdr << "    uint64_t appliedBytes;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // ships the changes of a database to a sink, or applies the changes of a leader to it" << std::endl;
+            of_hdr << "  class replication : public commit_listener {" << std::endl;
+            of_hdr << "      database& db_;" << std::endl;
+            of_hdr << "      sqlite3_session* session_;" << std::endl;
+            of_hdr << "      changeset_sink* sink_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> published_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> publishedBytes_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> applied_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> appliedBytes_;" << std::endl;
+            of_hdr << "      void attach();" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            // every transaction is published once it has committed, whichever way it was committed
+            of_hdr << "      inline void committed() override {publish();}" << std::endl;
+            // the session leaves the rows of a rolled back transaction out of the next changeset
+            of_hdr << "      inline void rolledBack() override {}" << std::endl;
+            of_hdr << "      void start(changeset_sink& sink);" << std::endl;
+            of_hdr << "      void stop();" << std::endl;
+            of_hdr << "      void publish();" << std::endl;
+            of_hdr << "      void apply(const void* data, const size_t& size);" << std::endl;
+            of_hdr << "      size_t follow(file_source& source);" << std::endl;
+            of_hdr << "      replication_stats stats() const;" << std::endl;
+            of_hdr << "      inline bool isRunning() const {return (session_ != nullptr);}" << std::endl;
+            of_hdr << "      inline replication(database& db) : db_(db), session_(nullptr), sink_(nullptr), published_(0), publishedBytes_(0), applied_(0), appliedBytes_(0) {}" << std::endl;
+            of_hdr << "      inline ~replication() {stop();}" << std::endl;
+            of_hdr << "      inline replication(const replication&) = delete;" << std::endl;
+            of_hdr << "      inline replication& operator=(const replication&) = delete;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  enum class arrow_type { int64, float64, utf8, binary };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct arrow_field {" << std::endl;
+            of_hdr << "    std::string name;" << std::endl;
+            of_hdr << "    arrow_type type;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // writes results as an Arrow IPC stream: the schema, a message per record batch, and the end of stream marker" << std::endl;
+            of_hdr << "  class arrow_writer {" << std::endl;
+            of_hdr << "      FILE* fp_;" << std::endl;
+            of_hdr << "      bool owned_;" << std::endl;
+            of_hdr << "      std::vector<arrow_field> fields_;" << std::endl;
+            of_hdr << "      std::vector<std::array<int64_t, 2>> nodes_;" << std::endl;
+            of_hdr << "      std::vector<std::array<int64_t, 2>> buffers_;" << std::endl;
+            of_hdr << "      std::vector<std::pair<const void*, size_t>> body_;" << std::endl;
+            of_hdr << "      int64_t bodyLength_;" << std::endl;
+            of_hdr << "      uint64_t batches_;" << std::endl;
+            of_hdr << "      void addBuffer(const void* data, const size_t& len);" << std::endl;
+            of_hdr << "      void addValidity(const std::vector<uint64_t>& valid, const size_t& rows);" << std::endl;
+            of_hdr << "      void write(const void* data, const size_t& len);" << std::endl;
+            of_hdr << "      void writeMessage(const std::vector<uint8_t>& meta);" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      void begin(const std::vector<arrow_field>& fields);" << std::endl;
+            of_hdr << "      void add(const column<int64_t>& col);" << std::endl;
+            of_hdr << "      void add(const column<double>& col);" << std::endl;
+            of_hdr << "      void add(const text_column& col);" << std::endl;
+            of_hdr << "      void batch(const size_t& rows);" << std::endl;
+            of_hdr << "      void end();" << std::endl;
+            of_hdr << "      inline uint64_t batches() const {return batches_;}" << std::endl;
+            of_hdr << "      arrow_writer(const std::string& path);" << std::endl;
+            of_hdr << "      inline arrow_writer(FILE* fp) : fp_(fp), owned_(false), bodyLength_(0), batches_(0) {}" << std::endl;
+            of_hdr << "      ~arrow_writer();" << std::endl;
+            of_hdr << "      inline arrow_writer(const arrow_writer&) = delete;" << std::endl;
+            of_hdr << "      inline arrow_writer& operator=(const arrow_writer&) = delete;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  struct import_config {" << std::endl;
+            of_hdr << "    char delimiter;" << std::endl;
+            of_hdr << "    bool header;" << std::endl;
+            of_hdr << "    size_t batchRows;" << std::endl;
+            of_hdr << "    bool deferIndexes;" << std::endl;
+            of_hdr << "    inline import_config() : delimiter(','), header(true), batchRows(100000), deferIndexes(false) {}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // a column of a table to import into, and its storage class (SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT or SQLITE_BLOB)" << std::endl;
+            of_hdr << "  struct import_column {" << std::endl;
+            of_hdr << "    const char* name;" << std::endl;
+            of_hdr << "    int type;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // loads a CSV file into a table, returns the number of rows committed" << std::endl;
+            of_hdr << "  size_t importCsv(database& db, const std::string& path, const std::string& table, const std::vector<import_column>& cols, const import_config& cfg);" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  enum class change_op { insert, update, remove };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // a committed change to a row, before is set for update and remove, after for insert and update" << std::endl;
+            of_hdr << "  template <typename T>" << std::endl;
+            of_hdr << "  struct change {" << std::endl;
+            of_hdr << "    change_op op;" << std::endl;
+            of_hdr << "    int64_t rowid;" << std::endl;
+            of_hdr << "    std::optional<T> before;" << std::endl;
+            of_hdr << "    std::optional<T> after;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "  // a lock-free ring for one producer thread and one consumer thread, push fails when it is full" << std::endl;
+            of_hdr << "  template <typename T>" << std::endl;
+            of_hdr << "  class ring {" << std::endl;
+            of_hdr << "      std::vector<T> buf_;" << std::endl;
+            of_hdr << "      size_t mask_;" << std::endl;
+            of_hdr << "      alignas(64) std::atomic<size_t> head_;" << std::endl;
+            of_hdr << "      alignas(64) std::atomic<size_t> tail_;" << std::endl;
+            of_hdr << "      std::atomic<uint64_t> dropped_;" << std::endl;
+            of_hdr << "      static inline size_t pow2(const size_t& n) {" << std::endl;
+            of_hdr << "          size_t rv = 1;" << std::endl;
+            of_hdr << "          while (rv < n) {" << std::endl;
+            of_hdr << "              rv <<= 1;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          return rv;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "  public:" << std::endl;
+            of_hdr << "      inline bool push(T&& val) {" << std::endl;
+            of_hdr << "          auto t = tail_.load(std::memory_order_relaxed);" << std::endl;
+            of_hdr << "          if ((t - head_.load(std::memory_order_acquire)) > mask_) {" << std::endl;
+            of_hdr << "              dropped_.fetch_add(1, std::memory_order_relaxed);" << std::endl;
+            of_hdr << "              return false;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          buf_[t & mask_] = std::move(val);" << std::endl;
+            of_hdr << "          tail_.store(t + 1, std::memory_order_release);" << std::endl;
+            of_hdr << "          return true;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      inline bool pop(T& val) {" << std::endl;
+            of_hdr << "          auto h = head_.load(std::memory_order_relaxed);" << std::endl;
+            of_hdr << "          if (h == tail_.load(std::memory_order_acquire)) {" << std::endl;
+            of_hdr << "              return false;" << std::endl;
+            of_hdr << "          }" << std::endl;
+            of_hdr << "          val = std::move(buf_[h & mask_]);" << std::endl;
+            of_hdr << "          head_.store(h + 1, std::memory_order_release);" << std::endl;
+            of_hdr << "          return true;" << std::endl;
+            of_hdr << "      }" << std::endl;
+            of_hdr << "      inline size_t size() const {return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);}" << std::endl;
+            of_hdr << "      inline size_t capacity() const {return buf_.size();}" << std::endl;
+            of_hdr << "      inline uint64_t dropped() const {return dropped_.load(std::memory_order_relaxed);}" << std::endl;
+            of_hdr << "      inline ring(const size_t& capacity) : buf_(pow2(capacity)), mask_(buf_.size() - 1), head_(0), tail_(0), dropped_(0) {}" << std::endl;
+            of_hdr << "      inline ring(const ring&) = delete;" << std::endl;
+            of_hdr << "      inline ring& operator=(const ring&) = delete;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            // holds the connection's own (recursive) mutex, so no other thread can use it meanwhile
+            of_hdr << "  struct connection_lock {" << std::endl;
+            of_hdr << "    sqlite3_mutex* mtx_;" << std::endl;
+            of_hdr << "    inline connection_lock(database& db) : mtx_(::sqlite3_db_mutex(db.val_)) { ::sqlite3_mutex_enter(mtx_); }" << std::endl;
+            of_hdr << "    inline ~connection_lock() { ::sqlite3_mutex_leave(mtx_); }" << std::endl;
+            of_hdr << "    inline connection_lock(const connection_lock&) = delete;" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  struct transaction {" << std::endl;
+            of_hdr << "    database& db_;" << std::endl;
+            of_hdr << "    bool committed_;" << std::endl;
+            of_hdr << "    inline void begin(const bool& immediate){if(immediate){db_.beginImmediate();}else{db_.begin();}}" << std::endl;
+            of_hdr << "    inline void commit(){db_.commit();committed_ = true;}" << std::endl;
+            of_hdr << "    inline void rollback(){db_.exec(\"ROLLBACK;\");}" << std::endl;
+            of_hdr << "    inline transaction& operator=(const transaction& src) = delete;" << std::endl;
+            of_hdr << "    inline transaction(database& db, const bool& immediate = false) : db_(db), committed_(false) { begin(immediate); }" << std::endl;
+            of_hdr << "    inline ~transaction() { if (!committed_) rollback(); }" << std::endl;
+            of_hdr << "    " << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << std::endl;
+
+            of_hdr << "  template <typename T, typename I> struct iterator_base {" << std::endl;
+            of_hdr << "    T& stmt;" << std::endl;
+            of_hdr << "    bool last;" << std::endl;
+            //if(module.mutexName.length() > 0) {
+            //    of_hdr << "#if " << module.mutexName << std::endl;
+            //    of_hdr << "      std::unique_lock<std::mutex> lk;" << std::endl;
+            //    of_hdr << "#endif //" << module.mutexName << std::endl;
+            //}
+            of_hdr << "    inline void next() {last = (stmt.next() == false);}" << std::endl;
+            of_hdr << "    inline bool operator  =(const iterator_base& rhs) = delete;" << std::endl;
+            of_hdr << "    inline bool operator !=(const iterator_base& rhs) {return last != rhs.last;}" << std::endl;
+            of_hdr << "    inline bool operator ==(const iterator_base& rhs) {return last == rhs.last;}" << std::endl;
+            of_hdr << "    inline I& operator++() {next();return static_cast<I&>(*this);}" << std::endl;
+            of_hdr << "    inline I& operator*() {return static_cast<I&>(*this);}" << std::endl;
+
+            of_hdr << "    inline iterator_base(T& s) : stmt(s), last(false) ";
+            //if(module.mutexName.length() > 0) {
+            //    of_hdr << std::endl;
+            //    of_hdr << "#if " << module.mutexName << std::endl;
+            //    of_hdr << "    , lk(s.db_.mx_)" << std::endl;
+            //    of_hdr << "#endif //" << module.mutexName << std::endl;
+            //    of_hdr << "    ";
+            //}
+            of_hdr << "{next();}" << std::endl;
+
+            of_hdr << "    inline iterator_base(T& s, const bool& l) : stmt(s), last(l) " << std::endl;
+            //if(module.mutexName.length() > 0) {
+            //    of_hdr << std::endl;
+            //    of_hdr << "#if " << module.mutexName << std::endl;
+            //    of_hdr << "    , lk(s.db_.mx_, std::defer_lock)" << std::endl;
+            //    of_hdr << "#endif //" << module.mutexName << std::endl;
+            //    of_hdr << "    ";
+            //}
+            of_hdr << "{}" << std::endl;
+
+            of_hdr << "    inline iterator_base(const iterator_base&) = delete;" << std::endl;
+            of_hdr << "    inline iterator_base(iterator_base&& src) : stmt(src.stmt)";
+            //if(module.mutexName.length() > 0) {
+            //    of_hdr << std::endl;
+            //    of_hdr << "#if " << module.mutexName << std::endl;
+            //    of_hdr << "    , lk(stmt.db_.mx_)" << std::endl;
+            //    of_hdr << "#endif //" << module.mutexName << std::endl;
+            //    of_hdr << "    ";
+            //}
+            of_hdr << " {assert(false);}" << std::endl;
+            of_hdr << "    inline ~iterator_base() {}" << std::endl;
+            of_hdr << "  };" << std::endl;
+            of_hdr << "}" << std::endl;
+            of_hdr << std::endl;
+            of_hdr << "#endif // !defined(SQLCH_COMMON)" << std::endl;
+            of_hdr << std::endl;
+        } else if(module.generateBase != false) {
+            of_hdr << "#include \"" << module.generateBaseNS << "\"" << std::endl;
+        }
+
+        // HDR:open namespace in header file
+        std::string ns;
+        std::string nsx;
+        if(module.nsList.size() > 0) {
+            std::string nsep;
+            for(auto& n : module.nsList) {
+                of_hdr << "namespace " << n << " { ";
+                nsx += nsep;
+                nsx += n;
+                nsep = "::";
+            }
+            ns = nsx + nsep; // appending terminating ::, if ns is defined
+            of_hdr << std::endl;
+        }
+
+        // HDR: generate enum's
+        if(module.enumList.size() > 0) {
+            of_hdr << "  template <typename T> T from_string(const std::string& str);" << std::endl;
+        }
+        for(auto& e : module.enumList) {
+            of_hdr << "  enum class " << e.name << "{" << std::endl;
+            std::string sep = " ";
+            for(auto& v : e.valueList) {
+                of_hdr << "   " << sep << v << std::endl;
+                sep = ",";
+            }
+            of_hdr << "  };// enum" << e.name << std::endl;
+            of_hdr << "  std::string to_string(const " << e.name << "& val);" << std::endl;
+            of_hdr << "  template <> " << e.name << " from_string<" << e.name << ">(const std::string& str);" << std::endl;
+            of_hdr << "  inline std::ostream& operator<<(std::ostream& os, const " << e.name << "& val){" << std::endl;
+            of_hdr << "    os << to_string(val);" << std::endl;
+            of_hdr << "    return os;" << std::endl;
+            of_hdr << "  }" << std::endl;
+        }
+
+        // SRC:generate definition for common structs required by sqlch
+        // the ---SQLCH metacommand is used to ensure that it is defined only once
+        // in the whole project
+        if(module.generateBase != false) {
+            // SRC: generate code
+            of_src << module.scode << std::endl;
+            of_src << std::endl;
+
+            of_src << "namespace {" << std::endl;
+            if(module.onError == "on_Error") {
+                of_src << "  inline int on_Error(const std::string& db, const std::string& src, int rc, const std::string& msg){" << std::endl;
+                of_src << "    std::cout << \"(\" << db << \"):sqlite error:\" << msg << \"(\" << rc << \") in \" << src << \", aborting.\" << std::endl;" << std::endl;
+                of_src << "    exit(1);" << std::endl;
+                of_src << "  }" << std::endl;
+                of_src << std::endl;
+            }
+            if(module.onTrace != "") {
+                of_src << "  void on_Trace(void* /*context*/, const char* /*sql*/){" << std::endl;
+                of_src << "  }" << std::endl;
+                of_src << std::endl;
+            }
+            if(module.onOpen == "on_Open") {
+                of_src << "  inline void on_Open(const std::string& /*filename*/, const int& /*flags*/){" << std::endl;
+                of_src << "  }" << std::endl;
+                of_src << std::endl;
+            }
+            if(module.onOpened == "on_Opened") {
+                of_src << "  inline void on_Opened(" << module.generateBaseNS << "::database& /*db*/){" << std::endl;
+                of_src << "  }" << std::endl;
+                of_src << std::endl;
+            }
+
+            of_src << "  inline int getParamIndex(" << module.generateBaseNS << "::statement& stmt, const std::string& key) {" << std::endl;
+            of_src << "    if (stmt.val_ == nullptr) {" << std::endl;
+            of_src << "      " << module.onError << "(stmt.db_.filename_, \"get_index\", SQLITE_MISUSE, \"uninitialized statement\");" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    int idx = ::sqlite3_bind_parameter_index(stmt.val_, key.c_str());" << std::endl;
+            of_src << "    if (idx == 0) {" << std::endl;
+            of_src << "      " << module.onError << "(stmt.db_.filename_, \"unknown_param\", SQLITE_MISUSE, key);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return idx;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "} // namespace" << std::endl;
+            of_src << std::endl;
+
+            of_src << "  std::string " << module.generateBaseNS << "::error(sqlite3* db){" << std::endl;
+            of_src << "    return ::sqlite3_errmsg(db);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+
+            of_src << "namespace {" << std::endl;
+            of_src << "  // sqlch_array(:name), an eponymous table valued function over the array_ref bound to :name" << std::endl;
+            of_src << "  struct array_cursor {" << std::endl;
+            of_src << "    sqlite3_vtab_cursor base;" << std::endl;
+            of_src << "    const " << module.generateBaseNS << "::array_ref* arr;" << std::endl;
+            of_src << "    size_t idx;" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_connect(sqlite3* db, void*, int, const char* const*, sqlite3_vtab** vtab, char**) {" << std::endl;
+            of_src << "    int rc = ::sqlite3_declare_vtab(db, \"CREATE TABLE x(value, ptr HIDDEN)\");" << std::endl;
+            of_src << "    if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "      return rc;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    *vtab = static_cast<sqlite3_vtab*>(::sqlite3_malloc(sizeof(sqlite3_vtab)));" << std::endl;
+            of_src << "    if (*vtab == nullptr) {" << std::endl;
+            of_src << "      return SQLITE_NOMEM;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    ::memset(*vtab, 0, sizeof(sqlite3_vtab));" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_best_index(sqlite3_vtab*, sqlite3_index_info* info) {" << std::endl;
+            of_src << "    for (int i = 0; i < info->nConstraint; ++i) {" << std::endl;
+            of_src << "      if ((info->aConstraint[i].iColumn == 1) && (info->aConstraint[i].op == SQLITE_INDEX_CONSTRAINT_EQ) && info->aConstraint[i].usable) {" << std::endl;
+            of_src << "        info->aConstraintUsage[i].argvIndex = 1;" << std::endl;
+            of_src << "        info->aConstraintUsage[i].omit = 1;" << std::endl;
+            of_src << "        info->idxNum = 1;" << std::endl;
+            of_src << "        info->estimatedCost = 10;" << std::endl;
+            of_src << "        info->estimatedRows = 10;" << std::endl;
+            of_src << "        return SQLITE_OK;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    info->estimatedCost = 1e12;" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_disconnect(sqlite3_vtab* vtab) {" << std::endl;
+            of_src << "    ::sqlite3_free(vtab);" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_open(sqlite3_vtab*, sqlite3_vtab_cursor** cur) {" << std::endl;
+            of_src << "    auto c = static_cast<array_cursor*>(::sqlite3_malloc(sizeof(array_cursor)));" << std::endl;
+            of_src << "    if (c == nullptr) {" << std::endl;
+            of_src << "      return SQLITE_NOMEM;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    ::memset(c, 0, sizeof(array_cursor));" << std::endl;
+            of_src << "    *cur = &c->base;" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_close(sqlite3_vtab_cursor* cur) {" << std::endl;
+            of_src << "    ::sqlite3_free(cur);" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_filter(sqlite3_vtab_cursor* cur, int idxNum, const char*, int argc, sqlite3_value** argv) {" << std::endl;
+            of_src << "    auto c = reinterpret_cast<array_cursor*>(cur);" << std::endl;
+            of_src << "    c->arr = ((idxNum == 1) && (argc == 1)) ? static_cast<const " << module.generateBaseNS << "::array_ref*>(::sqlite3_value_pointer(argv[0], \"sqlch_array\")) : nullptr;" << std::endl;
+            of_src << "    c->idx = 0;" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_next(sqlite3_vtab_cursor* cur) {" << std::endl;
+            of_src << "    ++reinterpret_cast<array_cursor*>(cur)->idx;" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_eof(sqlite3_vtab_cursor* cur) {" << std::endl;
+            of_src << "    auto c = reinterpret_cast<array_cursor*>(cur);" << std::endl;
+            of_src << "    return ((c->arr == nullptr) || (c->idx >= c->arr->size)) ? 1 : 0;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_column(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {" << std::endl;
+            of_src << "    auto c = reinterpret_cast<array_cursor*>(cur);" << std::endl;
+            of_src << "    if (col == 0) {" << std::endl;
+            of_src << "      c->arr->get(ctx, c->arr->data, c->idx);" << std::endl;
+            of_src << "    } else {" << std::endl;
+            of_src << "      ::sqlite3_result_null(ctx);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int array_rowid(sqlite3_vtab_cursor* cur, sqlite3_int64* rowid) {" << std::endl;
+            of_src << "    *rowid = static_cast<sqlite3_int64>(reinterpret_cast<array_cursor*>(cur)->idx);" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  sqlite3_module get_array_module() {" << std::endl;
+            of_src << "    sqlite3_module m{};" << std::endl;
+            of_src << "    m.xConnect = array_connect;" << std::endl;
+            of_src << "    m.xBestIndex = array_best_index;" << std::endl;
+            of_src << "    m.xDisconnect = array_disconnect;" << std::endl;
+            of_src << "    m.xOpen = array_open;" << std::endl;
+            of_src << "    m.xClose = array_close;" << std::endl;
+            of_src << "    m.xFilter = array_filter;" << std::endl;
+            of_src << "    m.xNext = array_next;" << std::endl;
+            of_src << "    m.xEof = array_eof;" << std::endl;
+            of_src << "    m.xColumn = array_column;" << std::endl;
+            of_src << "    m.xRowid = array_rowid;" << std::endl;
+            of_src << "    return m;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  const sqlite3_module array_module = get_array_module();" << std::endl;
+            of_src << std::endl;
+            of_src << "  void array_free(void* p) {" << std::endl;
+            of_src << "    delete static_cast<" << module.generateBaseNS << "::array_ref*>(p);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "// the array_ref is copied, and freed by sqlite when it is rebound or the statement is closed" << std::endl;
+            of_src << "void " << module.generateBaseNS << "::statement::setParamArray(const std::string& key, const array_ref& val){" << std::endl;
+            of_src << "  int idx = getParamIndex(*this, key);" << std::endl;
+            of_src << "  ::sqlite3_bind_pointer(val_, idx, new array_ref(val), \"sqlch_array\", &array_free);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "namespace {" << std::endl;
+            of_src << "  // size classes of 16 << n bytes, each block is preceded by its class or, above the largest class, its size" << std::endl;
+            of_src << "  const int alloc_classes = 9;" << std::endl;
+            of_src << "  const int alloc_max = (16 << (alloc_classes - 1));" << std::endl;
+            of_src << "  const size_t alloc_keep = 4096;" << std::endl;
+            of_src << std::endl;
+            of_src << "  struct alloc_class {" << std::endl;
+            of_src << "    std::atomic_flag lock = ATOMIC_FLAG_INIT;" << std::endl;
+            of_src << "    void* free = nullptr;" << std::endl;
+            of_src << "    size_t count = 0;" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  alloc_class alloc_pool[alloc_classes];" << std::endl;
+            of_src << "  sqlite3_mem_methods alloc_default;" << std::endl;
+            of_src << "  bool alloc_usePool = false;" << std::endl;
+            of_src << "  std::atomic<uint64_t> alloc_mallocs(0);" << std::endl;
+            of_src << "  std::atomic<uint64_t> alloc_reallocs(0);" << std::endl;
+            of_src << "  std::atomic<uint64_t> alloc_frees(0);" << std::endl;
+            of_src << "  std::atomic<uint64_t> alloc_pooled(0);" << std::endl;
+            of_src << "  " << module.generateBaseNS << "::runtime_config alloc_config;" << std::endl;
+            of_src << std::endl;
+            of_src << "  inline int alloc_class_of(int n) {" << std::endl;
+            of_src << "    int c = 0;" << std::endl;
+            of_src << "    while ((16 << c) < n) {" << std::endl;
+            of_src << "      ++c;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return c;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int alloc_roundup(int n) {" << std::endl;
+            of_src << "    if (alloc_usePool) {" << std::endl;
+            of_src << "      return (n <= alloc_max) ? (16 << alloc_class_of(n)) : ((n + 7) & ~7);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return alloc_default.xRoundup(n);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void* alloc_malloc(int n) {" << std::endl;
+            of_src << "    alloc_mallocs.fetch_add(1, std::memory_order_relaxed);" << std::endl;
+            of_src << "    if (!alloc_usePool) {" << std::endl;
+            of_src << "      return alloc_default.xMalloc(n);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    int64_t* p = nullptr;" << std::endl;
+            of_src << "    if (n <= alloc_max) {" << std::endl;
+            of_src << "      auto c = alloc_class_of(n);" << std::endl;
+            of_src << "      auto& ac = alloc_pool[c];" << std::endl;
+            of_src << "      while (ac.lock.test_and_set(std::memory_order_acquire)) {}" << std::endl;
+            of_src << "      if (ac.free != nullptr) {" << std::endl;
+            of_src << "        p = static_cast<int64_t*>(ac.free);" << std::endl;
+            of_src << "        ac.free = *reinterpret_cast<void**>(p + 1);" << std::endl;
+            of_src << "        --ac.count;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      ac.lock.clear(std::memory_order_release);" << std::endl;
+            of_src << "      if (p != nullptr) {" << std::endl;
+            of_src << "        alloc_pooled.fetch_add(1, std::memory_order_relaxed);" << std::endl;
+            of_src << "      } else {" << std::endl;
+            of_src << "        p = static_cast<int64_t*>(::malloc(sizeof(int64_t) + (16 << c)));" << std::endl;
+            of_src << "        if (p == nullptr) {" << std::endl;
+            of_src << "          return nullptr;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      *p = c;" << std::endl;
+            of_src << "    } else {" << std::endl;
+            of_src << "      n = (n + 7) & ~7;" << std::endl;
+            of_src << "      p = static_cast<int64_t*>(::malloc(sizeof(int64_t) + n));" << std::endl;
+            of_src << "      if (p == nullptr) {" << std::endl;
+            of_src << "        return nullptr;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      *p = n;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return (p + 1);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int alloc_size(void* v) {" << std::endl;
+            of_src << "    if (!alloc_usePool) {" << std::endl;
+            of_src << "      return alloc_default.xSize(v);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (v == nullptr) {" << std::endl;
+            of_src << "      return 0;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto p = static_cast<int64_t*>(v) - 1;" << std::endl;
+            of_src << "    return (*p < alloc_classes) ? (16 << *p) : static_cast<int>(*p);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void alloc_free(void* v) {" << std::endl;
+            of_src << "    alloc_frees.fetch_add(1, std::memory_order_relaxed);" << std::endl;
+            of_src << "    if (!alloc_usePool) {" << std::endl;
+            of_src << "      return alloc_default.xFree(v);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (v == nullptr) {" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto p = static_cast<int64_t*>(v) - 1;" << std::endl;
+            of_src << "    if (*p < alloc_classes) {" << std::endl;
+            of_src << "      auto& ac = alloc_pool[*p];" << std::endl;
+            of_src << "      while (ac.lock.test_and_set(std::memory_order_acquire)) {}" << std::endl;
+            of_src << "      if (ac.count < alloc_keep) {" << std::endl;
+            of_src << "        *reinterpret_cast<void**>(v) = ac.free;" << std::endl;
+            of_src << "        ac.free = p;" << std::endl;
+            of_src << "        ++ac.count;" << std::endl;
+            of_src << "        p = nullptr;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      ac.lock.clear(std::memory_order_release);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    ::free(p);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void* alloc_realloc(void* v, int n) {" << std::endl;
+            of_src << "    alloc_reallocs.fetch_add(1, std::memory_order_relaxed);" << std::endl;
+            of_src << "    if (!alloc_usePool) {" << std::endl;
+            of_src << "      return alloc_default.xRealloc(v, n);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto sz = alloc_size(v);" << std::endl;
+            of_src << "    if ((sz >= n) && (sz <= alloc_max)) {" << std::endl;
+            of_src << "      return v;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto r = alloc_malloc(n);" << std::endl;
+            of_src << "    if (r != nullptr) {" << std::endl;
+            of_src << "      ::memcpy(r, v, static_cast<size_t>((sz < n) ? sz : n));" << std::endl;
+            of_src << "      alloc_free(v);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return r;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int alloc_init(void* p) {" << std::endl;
+            of_src << "    return alloc_usePool ? SQLITE_OK : alloc_default.xInit(p);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void alloc_shutdown(void* p) {" << std::endl;
+            of_src << "    if (!alloc_usePool) {" << std::endl;
+            of_src << "      alloc_default.xShutdown(p);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  sqlite3_mem_methods alloc_methods = {alloc_malloc, alloc_free, alloc_realloc, alloc_size, alloc_roundup, alloc_init, alloc_shutdown, nullptr};" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "namespace {" << std::endl;
+            of_src << "  // one page cache for all connections: every page is on one CLOCK ring, and any unpinned" << std::endl;
+            of_src << "  // page of a purgeable cache (not a temp or memory database) can be evicted to stay in budget" << std::endl;
+            of_src << "  struct pcache;" << std::endl;
+            of_src << "  struct pcache_page {" << std::endl;
+            of_src << "    sqlite3_pcache_page base;" << std::endl;
+            of_src << "    pcache* cache;" << std::endl;
+            of_src << "    unsigned key;" << std::endl;
+            of_src << "    bool pinned;" << std::endl;
+            of_src << "    bool ref;" << std::endl;
+            of_src << "    pcache_page* prev;" << std::endl;
+            of_src << "    pcache_page* next;" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  struct pcache {" << std::endl;
+            of_src << "    int szPage;" << std::endl;
+            of_src << "    int szExtra;" << std::endl;
+            of_src << "    bool purgeable;" << std::endl;
+            of_src << "    std::unordered_map<unsigned, pcache_page*> pages;" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  std::mutex pcache_mx;" << std::endl;
+            of_src << "  pcache_page* pcache_hand = nullptr;" << std::endl;
+            of_src << "  size_t pcache_count = 0;" << std::endl;
+            of_src << "  int64_t pcache_budget = 0;" << std::endl;
+            of_src << "  int64_t pcache_bytes = 0;" << std::endl;
+            of_src << "  uint64_t pcache_hits = 0;" << std::endl;
+            of_src << "  uint64_t pcache_misses = 0;" << std::endl;
+            of_src << "  uint64_t pcache_evictions = 0;" << std::endl;
+            of_src << std::endl;
+            of_src << "  inline int64_t pcache_size(const pcache* c) {" << std::endl;
+            of_src << "    return static_cast<int64_t>(sizeof(pcache_page)) + c->szPage + c->szExtra;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void pcache_release(pcache_page* p) {" << std::endl;
+            of_src << "    if (p->next == p) {" << std::endl;
+            of_src << "      pcache_hand = nullptr;" << std::endl;
+            of_src << "    } else {" << std::endl;
+            of_src << "      p->prev->next = p->next;" << std::endl;
+            of_src << "      p->next->prev = p->prev;" << std::endl;
+            of_src << "      if (pcache_hand == p) {" << std::endl;
+            of_src << "        pcache_hand = p->next;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    --pcache_count;" << std::endl;
+            of_src << "    p->cache->pages.erase(p->key);" << std::endl;
+            of_src << "    pcache_bytes -= pcache_size(p->cache);" << std::endl;
+            of_src << "    ::free(p);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // the first lap clears the reference bits, so a page is evicted within two laps unless all are pinned" << std::endl;
+            of_src << "  bool pcache_evict() {" << std::endl;
+            of_src << "    for (size_t i = 0; ((pcache_hand != nullptr) && (i < 2 * pcache_count)); ++i) {" << std::endl;
+            of_src << "      auto p = pcache_hand;" << std::endl;
+            of_src << "      pcache_hand = p->next;" << std::endl;
+            of_src << "      if (p->pinned || !p->cache->purgeable) {" << std::endl;
+            of_src << "        continue;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if (p->ref) {" << std::endl;
+            of_src << "        p->ref = false;" << std::endl;
+            of_src << "        continue;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      pcache_release(p);" << std::endl;
+            of_src << "      ++pcache_evictions;" << std::endl;
+            of_src << "      return true;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return false;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int pcache_init(void*) {" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void pcache_shutdown(void*) {" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  sqlite3_pcache* pcache_create(int szPage, int szExtra, int bPurgeable) {" << std::endl;
+            of_src << "    auto c = new pcache();" << std::endl;
+            of_src << "    c->szPage = szPage;" << std::endl;
+            of_src << "    c->szExtra = szExtra;" << std::endl;
+            of_src << "    c->purgeable = (bPurgeable != 0);" << std::endl;
+            of_src << "    return reinterpret_cast<sqlite3_pcache*>(c);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // the global budget replaces the cache_size of each connection" << std::endl;
+            of_src << "  void pcache_cachesize(sqlite3_pcache*, int) {" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int pcache_pagecount(sqlite3_pcache* pc) {" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> lg(pcache_mx);" << std::endl;
+            of_src << "    return static_cast<int>(reinterpret_cast<pcache*>(pc)->pages.size());" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  sqlite3_pcache_page* pcache_fetch(sqlite3_pcache* pc, unsigned key, int createFlag) {" << std::endl;
+            of_src << "    auto c = reinterpret_cast<pcache*>(pc);" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> lg(pcache_mx);" << std::endl;
+            of_src << "    auto it = c->pages.find(key);" << std::endl;
+            of_src << "    if (it != c->pages.end()) {" << std::endl;
+            of_src << "      ++pcache_hits;" << std::endl;
+            of_src << "      it->second->pinned = true;" << std::endl;
+            of_src << "      it->second->ref = true;" << std::endl;
+            of_src << "      return &it->second->base;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    ++pcache_misses;" << std::endl;
+            of_src << "    if (createFlag == 0) {" << std::endl;
+            of_src << "      return nullptr;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto sz = pcache_size(c);" << std::endl;
+            of_src << "    while (c->purgeable && ((pcache_bytes + sz) > pcache_budget)) {" << std::endl;
+            of_src << "      if (!pcache_evict()) {" << std::endl;
+            of_src << "        // with createFlag 1 sqlite first spills dirty pages to make some unpinned, and asks again" << std::endl;
+            of_src << "        if (createFlag == 1) {" << std::endl;
+            of_src << "          return nullptr;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        break;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto p = static_cast<pcache_page*>(::malloc(static_cast<size_t>(sz)));" << std::endl;
+            of_src << "    if (p == nullptr) {" << std::endl;
+            of_src << "      return nullptr;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    p->base.pBuf = (p + 1);" << std::endl;
+            of_src << "    p->base.pExtra = reinterpret_cast<char*>(p + 1) + c->szPage;" << std::endl;
+            of_src << "    ::memset(p->base.pExtra, 0, static_cast<size_t>(c->szExtra));" << std::endl;
+            of_src << "    p->cache = c;" << std::endl;
+            of_src << "    p->key = key;" << std::endl;
+            of_src << "    p->pinned = true;" << std::endl;
+            of_src << "    p->ref = true;" << std::endl;
+            of_src << "    if (pcache_hand == nullptr) {" << std::endl;
+            of_src << "      p->prev = p;" << std::endl;
+            of_src << "      p->next = p;" << std::endl;
+            of_src << "      pcache_hand = p;" << std::endl;
+            of_src << "    } else {" << std::endl;
+            of_src << "      // behind the hand, so it is the last to be looked at" << std::endl;
+            of_src << "      p->next = pcache_hand;" << std::endl;
+            of_src << "      p->prev = pcache_hand->prev;" << std::endl;
+            of_src << "      p->prev->next = p;" << std::endl;
+            of_src << "      pcache_hand->prev = p;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    ++pcache_count;" << std::endl;
+            of_src << "    pcache_bytes += sz;" << std::endl;
+            of_src << "    c->pages[key] = p;" << std::endl;
+            of_src << "    return &p->base;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void pcache_unpin(sqlite3_pcache*, sqlite3_pcache_page* pg, int discard) {" << std::endl;
+            of_src << "    auto p = reinterpret_cast<pcache_page*>(pg);" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> lg(pcache_mx);" << std::endl;
+            of_src << "    if (discard != 0) {" << std::endl;
+            of_src << "      pcache_release(p);" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    p->pinned = false;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void pcache_rekey(sqlite3_pcache* pc, sqlite3_pcache_page* pg, unsigned oldKey, unsigned newKey) {" << std::endl;
+            of_src << "    auto c = reinterpret_cast<pcache*>(pc);" << std::endl;
+            of_src << "    auto p = reinterpret_cast<pcache_page*>(pg);" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> lg(pcache_mx);" << std::endl;
+            of_src << "    auto it = c->pages.find(newKey);" << std::endl;
+            of_src << "    if (it != c->pages.end()) {" << std::endl;
+            of_src << "      pcache_release(it->second);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    c->pages.erase(oldKey);" << std::endl;
+            of_src << "    p->key = newKey;" << std::endl;
+            of_src << "    c->pages[newKey] = p;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void pcache_truncate(sqlite3_pcache* pc, unsigned limit) {" << std::endl;
+            of_src << "    auto c = reinterpret_cast<pcache*>(pc);" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> lg(pcache_mx);" << std::endl;
+            of_src << "    std::vector<pcache_page*> pl;" << std::endl;
+            of_src << "    for (auto& e : c->pages) {" << std::endl;
+            of_src << "      if (e.first >= limit) {" << std::endl;
+            of_src << "        pl.push_back(e.second);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    for (auto p : pl) {" << std::endl;
+            of_src << "      pcache_release(p);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void pcache_destroy(sqlite3_pcache* pc) {" << std::endl;
+            of_src << "    pcache_truncate(pc, 0);" << std::endl;
+            of_src << "    delete reinterpret_cast<pcache*>(pc);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void pcache_shrink(sqlite3_pcache* pc) {" << std::endl;
+            of_src << "    auto c = reinterpret_cast<pcache*>(pc);" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> lg(pcache_mx);" << std::endl;
+            of_src << "    std::vector<pcache_page*> pl;" << std::endl;
+            of_src << "    for (auto& e : c->pages) {" << std::endl;
+            of_src << "      if (!e.second->pinned) {" << std::endl;
+            of_src << "        pl.push_back(e.second);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    for (auto p : pl) {" << std::endl;
+            of_src << "      pcache_release(p);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  sqlite3_pcache_methods2 pcache_methods = {1, nullptr, pcache_init, pcache_shutdown, pcache_create, pcache_cachesize, pcache_pagecount, pcache_fetch, pcache_unpin, pcache_rekey, pcache_truncate, pcache_destroy, pcache_shrink};" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << module.generateBaseNS << "::pcache_stats " << module.generateBaseNS << "::pageCacheStats() {" << std::endl;
+            of_src << "  std::lock_guard<std::mutex> lg(pcache_mx);" << std::endl;
+            of_src << "  pcache_stats s;" << std::endl;
+            of_src << "  s.hits = pcache_hits;" << std::endl;
+            of_src << "  s.misses = pcache_misses;" << std::endl;
+            of_src << "  s.evictions = pcache_evictions;" << std::endl;
+            of_src << "  s.pages = pcache_count;" << std::endl;
+            of_src << "  s.bytes = pcache_bytes;" << std::endl;
+            of_src << "  s.budget = pcache_budget;" << std::endl;
+            of_src << "  return s;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << "namespace {" << std::endl;
+            of_src << "  // a VFS that wraps another one, passed in pAppData, forwards everything but xOpen to it" << std::endl;
+            of_src << "  inline sqlite3_vfs* vfs_root(sqlite3_vfs* vfs) {" << std::endl;
+            of_src << "    return static_cast<sqlite3_vfs*>(vfs->pAppData);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_delete(sqlite3_vfs* vfs, const char* name, int dirSync) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xDelete(vfs_root(vfs), name, dirSync);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_access(sqlite3_vfs* vfs, const char* name, int flags, int* out) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xAccess(vfs_root(vfs), name, flags, out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_fullpathname(sqlite3_vfs* vfs, const char* name, int n, char* out) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xFullPathname(vfs_root(vfs), name, n, out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void* vfs_dlopen(sqlite3_vfs* vfs, const char* name) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xDlOpen(vfs_root(vfs), name);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void vfs_dlerror(sqlite3_vfs* vfs, int n, char* msg) {" << std::endl;
+            of_src << "    vfs_root(vfs)->xDlError(vfs_root(vfs), n, msg);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void (*vfs_dlsym(sqlite3_vfs* vfs, void* h, const char* sym))(void) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xDlSym(vfs_root(vfs), h, sym);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void vfs_dlclose(sqlite3_vfs* vfs, void* h) {" << std::endl;
+            of_src << "    vfs_root(vfs)->xDlClose(vfs_root(vfs), h);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_randomness(sqlite3_vfs* vfs, int n, char* out) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xRandomness(vfs_root(vfs), n, out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_sleep(sqlite3_vfs* vfs, int us) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xSleep(vfs_root(vfs), us);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_currenttime(sqlite3_vfs* vfs, double* out) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xCurrentTime(vfs_root(vfs), out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_getlasterror(sqlite3_vfs* vfs, int n, char* out) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xGetLastError(vfs_root(vfs), n, out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_currenttimeint64(sqlite3_vfs* vfs, sqlite3_int64* out) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xCurrentTimeInt64(vfs_root(vfs), out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int vfs_setsystemcall(sqlite3_vfs* vfs, const char* name, sqlite3_syscall_ptr fn) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xSetSystemCall(vfs_root(vfs), name, fn);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  sqlite3_syscall_ptr vfs_getsystemcall(sqlite3_vfs* vfs, const char* name) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xGetSystemCall(vfs_root(vfs), name);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  const char* vfs_nextsystemcall(sqlite3_vfs* vfs, const char* name) {" << std::endl;
+            of_src << "    return vfs_root(vfs)->xNextSystemCall(vfs_root(vfs), name);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // a wrapper VFS named name over root, whose files are szFile bytes of its own followed by a file of root" << std::endl;
+            of_src << "  sqlite3_vfs vfs_wrap(sqlite3_vfs* root, const char* name, int szFile, int (*open)(sqlite3_vfs*, const char*, sqlite3_file*, int, int*)) {" << std::endl;
+            of_src << "    sqlite3_vfs vfs = {root->iVersion, szFile + root->szOsFile, root->mxPathname, nullptr, name, root, open, vfs_delete, vfs_access, vfs_fullpathname, vfs_dlopen, vfs_dlerror, vfs_dlsym, vfs_dlclose, vfs_randomness, vfs_sleep, vfs_currenttime, vfs_getlasterror, vfs_currenttimeint64, vfs_setsystemcall, vfs_getsystemcall, vfs_nextsystemcall};" << std::endl;
+            of_src << "    return vfs;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "namespace {" << std::endl;
+            of_src << "  // counters of the statement running on this thread, if any" << std::endl;
+            of_src << "  thread_local " << module.generateBaseNS << "::io_counters* io_current = nullptr;" << std::endl;
+            of_src << "  " << module.generateBaseNS << "::io_counters io_other;" << std::endl;
+            of_src << std::endl;
+            of_src << "  struct io_scope {" << std::endl;
+            of_src << "    " << module.generateBaseNS << "::io_counters* prev;" << std::endl;
+            of_src << "    inline io_scope(" << module.generateBaseNS << "::io_counters* c) : prev(io_current) {" << std::endl;
+            of_src << "      if (c != nullptr) {" << std::endl;
+            of_src << "        io_current = c;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline ~io_scope() {" << std::endl;
+            of_src << "      io_current = prev;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  inline " << module.generateBaseNS << "::io_counters& io_counted() {" << std::endl;
+            of_src << "    return (io_current != nullptr) ? *io_current : io_other;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  struct stats_file {" << std::endl;
+            of_src << "    sqlite3_file base;" << std::endl;
+            of_src << "    sqlite3_file* real;" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  inline sqlite3_file* stats_real(sqlite3_file* f) {" << std::endl;
+            of_src << "    return reinterpret_cast<stats_file*>(f)->real;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  sqlite3_vfs stats_vfs;" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_close(sqlite3_file* pf) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xClose(stats_real(pf));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_read(sqlite3_file* pf, void* buf, int amt, sqlite3_int64 off) {" << std::endl;
+            of_src << "    auto& c = io_counted();" << std::endl;
+            of_src << "    c.reads.fetch_add(1, std::memory_order_relaxed);" << std::endl;
+            of_src << "    c.readBytes.fetch_add(static_cast<uint64_t>(amt), std::memory_order_relaxed);" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xRead(stats_real(pf), buf, amt, off);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_write(sqlite3_file* pf, const void* buf, int amt, sqlite3_int64 off) {" << std::endl;
+            of_src << "    auto& c = io_counted();" << std::endl;
+            of_src << "    c.writes.fetch_add(1, std::memory_order_relaxed);" << std::endl;
+            of_src << "    c.writeBytes.fetch_add(static_cast<uint64_t>(amt), std::memory_order_relaxed);" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xWrite(stats_real(pf), buf, amt, off);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_truncate(sqlite3_file* pf, sqlite3_int64 size) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xTruncate(stats_real(pf), size);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_sync(sqlite3_file* pf, int flags) {" << std::endl;
+            of_src << "    io_counted().syncs.fetch_add(1, std::memory_order_relaxed);" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xSync(stats_real(pf), flags);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_filesize(sqlite3_file* pf, sqlite3_int64* size) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xFileSize(stats_real(pf), size);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_lock(sqlite3_file* pf, int lock) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xLock(stats_real(pf), lock);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_unlock(sqlite3_file* pf, int lock) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xUnlock(stats_real(pf), lock);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_checkreservedlock(sqlite3_file* pf, int* out) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xCheckReservedLock(stats_real(pf), out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_filecontrol(sqlite3_file* pf, int op, void* arg) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xFileControl(stats_real(pf), op, arg);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_sectorsize(sqlite3_file* pf) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xSectorSize(stats_real(pf));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_devicecharacteristics(sqlite3_file* pf) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xDeviceCharacteristics(stats_real(pf));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_shmmap(sqlite3_file* pf, int pg, int sz, int extend, void volatile** out) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xShmMap(stats_real(pf), pg, sz, extend, out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_shmlock(sqlite3_file* pf, int offset, int n, int flags) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xShmLock(stats_real(pf), offset, n, flags);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void stats_shmbarrier(sqlite3_file* pf) {" << std::endl;
+            of_src << "    stats_real(pf)->pMethods->xShmBarrier(stats_real(pf));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_shmunmap(sqlite3_file* pf, int del) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xShmUnmap(stats_real(pf), del);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_fetch(sqlite3_file* pf, sqlite3_int64 off, int amt, void** out) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xFetch(stats_real(pf), off, amt, out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_unfetch(sqlite3_file* pf, sqlite3_int64 off, void* p) {" << std::endl;
+            of_src << "    return stats_real(pf)->pMethods->xUnfetch(stats_real(pf), off, p);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // one table per version of the wrapped file's methods, so sqlite only calls what that file has" << std::endl;
+            of_src << "  const sqlite3_io_methods stats_methods[3] = {" << std::endl;
+            of_src << "    {1, stats_close, stats_read, stats_write, stats_truncate, stats_sync, stats_filesize, stats_lock, stats_unlock, stats_checkreservedlock, stats_filecontrol, stats_sectorsize, stats_devicecharacteristics, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}," << std::endl;
+            of_src << "    {2, stats_close, stats_read, stats_write, stats_truncate, stats_sync, stats_filesize, stats_lock, stats_unlock, stats_checkreservedlock, stats_filecontrol, stats_sectorsize, stats_devicecharacteristics, stats_shmmap, stats_shmlock, stats_shmbarrier, stats_shmunmap, nullptr, nullptr}," << std::endl;
+            of_src << "    {3, stats_close, stats_read, stats_write, stats_truncate, stats_sync, stats_filesize, stats_lock, stats_unlock, stats_checkreservedlock, stats_filecontrol, stats_sectorsize, stats_devicecharacteristics, stats_shmmap, stats_shmlock, stats_shmbarrier, stats_shmunmap, stats_fetch, stats_unfetch}" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  const size_t stats_file_size = (sizeof(stats_file) + 15) & ~static_cast<size_t>(15);" << std::endl;
+            of_src << std::endl;
+            of_src << "  int stats_open(sqlite3_vfs* vfs, const char* name, sqlite3_file* pf, int flags, int* outFlags) {" << std::endl;
+            of_src << "    auto f = reinterpret_cast<stats_file*>(pf);" << std::endl;
+            of_src << "    f->real = reinterpret_cast<sqlite3_file*>(reinterpret_cast<char*>(pf) + stats_file_size);" << std::endl;
+            of_src << "    auto rc = vfs_root(vfs)->xOpen(vfs_root(vfs), name, f->real, flags, outFlags);" << std::endl;
+            of_src << "    if ((rc != SQLITE_OK) || (f->real->pMethods == nullptr)) {" << std::endl;
+            of_src << "      pf->pMethods = nullptr;" << std::endl;
+            of_src << "      return rc;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto v = std::min(std::max(f->real->pMethods->iVersion, 1), 3);" << std::endl;
+            of_src << "    pf->pMethods = &stats_methods[v - 1];" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // set once the stats VFS is registered; until then statements do not look up their counters" << std::endl;
+            of_src << "  std::atomic<bool> io_enabled(false);" << std::endl;
+            of_src << "  std::mutex io_mx;" << std::endl;
+            of_src << "  std::map<std::string, std::unique_ptr<" << module.generateBaseNS << "::io_counters> > io_registry;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "bool " << module.generateBaseNS << "::registerStatsVfs(const char* root) {" << std::endl;
+            of_src << "  static std::once_flag once;" << std::endl;
+            of_src << "  static bool rv = false;" << std::endl;
+            of_src << "  std::call_once(once, [root](){" << std::endl;
+            of_src << "    auto r = ::sqlite3_vfs_find(root);" << std::endl;
+            of_src << "    if (r == nullptr) {" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    stats_vfs = vfs_wrap(r, statsVfs, static_cast<int>(stats_file_size), stats_open);" << std::endl;
+            of_src << "    rv = (::sqlite3_vfs_register(&stats_vfs, 0) == SQLITE_OK);" << std::endl;
+            of_src << "    io_enabled = rv;" << std::endl;
+            of_src << "  });" << std::endl;
+            of_src << "  return rv;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            // the counters of a name live as long as the process, so statements keep a pointer to them
+            of_src << module.generateBaseNS << "::io_counters* " << module.generateBaseNS << "::ioCounters(const std::string& name) {" << std::endl;
+            of_src << "  std::lock_guard<std::mutex> lg(io_mx);" << std::endl;
+            of_src << "  auto& c = io_registry[name];" << std::endl;
+            of_src << "  if (!c) {" << std::endl;
+            of_src << "    c = std::make_unique<io_counters>();" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  return c.get();" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "std::map<std::string, " << module.generateBaseNS << "::io_stats> " << module.generateBaseNS << "::ioStats() {" << std::endl;
+            of_src << "  std::map<std::string, io_stats> rv;" << std::endl;
+            of_src << "  auto get = [](const io_counters& c) {" << std::endl;
+            of_src << "    return io_stats{c.reads, c.readBytes, c.writes, c.writeBytes, c.syncs};" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << "  std::lock_guard<std::mutex> lg(io_mx);" << std::endl;
+            of_src << "  for (auto& e : io_registry) {" << std::endl;
+            of_src << "    rv[e.first] = get(*e.second);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  rv[\"\"] = get(io_other);" << std::endl;
+            of_src << "  return rv;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "#if SQLCH_IO_URING" << std::endl;
+            of_src << "#include <linux/io_uring.h>" << std::endl;
+            of_src << "#include <sys/mman.h>" << std::endl;
+            of_src << "#include <sys/stat.h>" << std::endl;
+            of_src << "#include <sys/syscall.h>" << std::endl;
+            of_src << "#include <unistd.h>" << std::endl;
+            of_src << "#include <cerrno>" << std::endl;
+            of_src << std::endl;
+            of_src << "namespace {" << std::endl;
+            of_src << "  // a minimal io_uring, set up through the syscalls directly so there is no dependency on liburing" << std::endl;
+            of_src << "  struct uring {" << std::endl;
+            of_src << "    int fd = -1;" << std::endl;
+            of_src << "    unsigned* sqHead = nullptr;" << std::endl;
+            of_src << "    unsigned* sqTail = nullptr;" << std::endl;
+            of_src << "    unsigned* sqMask = nullptr;" << std::endl;
+            of_src << "    unsigned* sqArray = nullptr;" << std::endl;
+            of_src << "    unsigned* cqHead = nullptr;" << std::endl;
+            of_src << "    unsigned* cqTail = nullptr;" << std::endl;
+            of_src << "    unsigned* cqMask = nullptr;" << std::endl;
+            of_src << "    io_uring_sqe* sqes = nullptr;" << std::endl;
+            of_src << "    io_uring_cqe* cqes = nullptr;" << std::endl;
+            of_src << "    void* sqRing = MAP_FAILED;" << std::endl;
+            of_src << "    void* cqRing = MAP_FAILED;" << std::endl;
+            of_src << "    size_t sqSize = 0;" << std::endl;
+            of_src << "    size_t cqSize = 0;" << std::endl;
+            of_src << "    size_t sqesSize = 0;" << std::endl;
+            of_src << "    unsigned queued = 0;" << std::endl;
+            of_src << "    unsigned inflight = 0;" << std::endl;
+            of_src << std::endl;
+            of_src << "    bool open(const unsigned& entries) {" << std::endl;
+            of_src << "      io_uring_params p;" << std::endl;
+            of_src << "      ::memset(&p, 0, sizeof(p));" << std::endl;
+            of_src << "      fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));" << std::endl;
+            of_src << "      if (fd < 0) {" << std::endl;
+            of_src << "        return false;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);" << std::endl;
+            of_src << "      cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);" << std::endl;
+            of_src << "      if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {" << std::endl;
+            of_src << "        sqSize = cqSize = std::max(sqSize, cqSize);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      sqRing = ::mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);" << std::endl;
+            of_src << "      if ((p.features & IORING_FEAT_SINGLE_MMAP) != 0) {" << std::endl;
+            of_src << "        cqRing = sqRing;" << std::endl;
+            of_src << "      } else if (sqRing != MAP_FAILED) {" << std::endl;
+            of_src << "        cqRing = ::mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      sqesSize = p.sq_entries * sizeof(io_uring_sqe);" << std::endl;
+            of_src << "      auto s = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);" << std::endl;
+            of_src << "      if ((sqRing == MAP_FAILED) || (cqRing == MAP_FAILED) || (s == MAP_FAILED)) {" << std::endl;
+            of_src << "        if (s != MAP_FAILED) {" << std::endl;
+            of_src << "          ::munmap(s, sqesSize);" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        close();" << std::endl;
+            of_src << "        return false;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      sqes = static_cast<io_uring_sqe*>(s);" << std::endl;
+            of_src << "      auto sq = static_cast<char*>(sqRing);" << std::endl;
+            of_src << "      auto cq = static_cast<char*>(cqRing);" << std::endl;
+            of_src << "      sqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);" << std::endl;
+            of_src << "      sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);" << std::endl;
+            of_src << "      sqMask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);" << std::endl;
+            of_src << "      sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);" << std::endl;
+            of_src << "      cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);" << std::endl;
+            of_src << "      cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);" << std::endl;
+            of_src << "      cqMask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);" << std::endl;
+            of_src << "      cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);" << std::endl;
+            of_src << "      return true;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << std::endl;
+            of_src << "    void close() {" << std::endl;
+            of_src << "      if (sqes != nullptr) {" << std::endl;
+            of_src << "        ::munmap(sqes, sqesSize);" << std::endl;
+            of_src << "        sqes = nullptr;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if ((cqRing != MAP_FAILED) && (cqRing != sqRing)) {" << std::endl;
+            of_src << "        ::munmap(cqRing, cqSize);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if (sqRing != MAP_FAILED) {" << std::endl;
+            of_src << "        ::munmap(sqRing, sqSize);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      sqRing = cqRing = MAP_FAILED;" << std::endl;
+            of_src << "      if (fd >= 0) {" << std::endl;
+            of_src << "        ::close(fd);" << std::endl;
+            of_src << "        fd = -1;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << std::endl;
+            of_src << "    // the next free submission entry, cleared, or nullptr if all are queued" << std::endl;
+            of_src << "    io_uring_sqe* prep() {" << std::endl;
+            of_src << "      auto tail = *sqTail;" << std::endl;
+            of_src << "      if ((tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE)) > *sqMask) {" << std::endl;
+            of_src << "        return nullptr;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      auto sqe = &sqes[tail & *sqMask];" << std::endl;
+            of_src << "      ::memset(sqe, 0, sizeof(*sqe));" << std::endl;
+            of_src << "      return sqe;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << std::endl;
+            of_src << "    void push() {" << std::endl;
+            of_src << "      auto tail = *sqTail;" << std::endl;
+            of_src << "      sqArray[tail & *sqMask] = tail & *sqMask;" << std::endl;
+            of_src << "      __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);" << std::endl;
+            of_src << "      ++queued;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << std::endl;
+            of_src << "    // submits everything queued and waits until nothing is in flight, fn sees each completion" << std::endl;
+            of_src << "    template <typename F>" << std::endl;
+            of_src << "    bool drain(F fn) {" << std::endl;
+            of_src << "      while ((queued > 0) || (inflight > 0)) {" << std::endl;
+            of_src << "        auto rc = ::syscall(__NR_io_uring_enter, fd, queued, (inflight + queued > 0) ? 1 : 0, IORING_ENTER_GETEVENTS, nullptr, 0);" << std::endl;
+            of_src << "        if (rc < 0) {" << std::endl;
+            of_src << "          if (errno == EINTR) {" << std::endl;
+            of_src << "            continue;" << std::endl;
+            of_src << "          }" << std::endl;
+            of_src << "          return false;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        inflight += static_cast<unsigned>(rc);" << std::endl;
+            of_src << "        queued -= static_cast<unsigned>(rc);" << std::endl;
+            of_src << "        auto head = *cqHead;" << std::endl;
+            of_src << "        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {" << std::endl;
+            of_src << "          auto& cqe = cqes[head & *cqMask];" << std::endl;
+            of_src << "          fn(cqe.user_data, cqe.res);" << std::endl;
+            of_src << "          ++head;" << std::endl;
+            of_src << "          --inflight;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      return true;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  const int uring_readahead = 128 * 1024;" << std::endl;
+            of_src << "  const uint64_t uring_tag_read = 1;" << std::endl;
+            of_src << "  const uint64_t uring_tag_sync = 2;" << std::endl;
+            of_src << "  const uint64_t uring_tag_write = (1ull << 63);" << std::endl;
+            of_src << std::endl;
+            of_src << "  // the descriptor the unix VFS opened last on this thread, seen through its \"open\" system call," << std::endl;
+            of_src << "  // so xOpen learns the descriptor of its file without looking into the unix file itself" << std::endl;
+            of_src << "  thread_local int uring_opened = -1;" << std::endl;
+            of_src << "  sqlite3_syscall_ptr uring_sys_open = nullptr;" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_sys_capture(const char* path, int flags, int mode) {" << std::endl;
+            of_src << "    auto fd = reinterpret_cast<int (*)(const char*, int, int)>(uring_sys_open)(path, flags, mode);" << std::endl;
+            of_src << "    uring_opened = fd;" << std::endl;
+            of_src << "    return fd;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  struct uring_file {" << std::endl;
+            of_src << "    sqlite3_file base;" << std::endl;
+            of_src << "    sqlite3_file* real;" << std::endl;
+            of_src << "    int fd;" << std::endl;
+            of_src << "    int type;" << std::endl;
+            of_src << "    bool synced;" << std::endl;
+            of_src << "    bool failed;" << std::endl;
+            of_src << "    bool commit;" << std::endl;
+            of_src << "    uring ring;" << std::endl;
+            of_src << "    std::vector<char> ra;" << std::endl;
+            of_src << "    int64_t raOff;" << std::endl;
+            of_src << "    int64_t lastEnd;" << std::endl;
+            of_src << "    int seq;" << std::endl;
+            of_src << "    std::vector<std::vector<char> > pending;" << std::endl;
+            of_src << "    std::string name;" << std::endl;
+            of_src << "    std::string wal;" << std::endl;
+            of_src << "    std::mutex mx;" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  // WAL files with queued writes, which are completed before sqlite publishes new frames in the" << std::endl;
+            of_src << "  // wal-index, since the connection that reads them may be another one, or another process" << std::endl;
+            of_src << "  std::mutex uring_mx;" << std::endl;
+            of_src << "  std::vector<uring_file*> uring_pending;" << std::endl;
+            of_src << std::endl;
+            of_src << "  sqlite3_vfs uring_vfs;" << std::endl;
+            of_src << std::endl;
+            of_src << "  inline sqlite3_file* uring_real(sqlite3_file* f) {" << std::endl;
+            of_src << "    return reinterpret_cast<uring_file*>(f)->real;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // a failed write is reported once, by the next call that can return it to sqlite, which then" << std::endl;
+            of_src << "  // rolls back and rewrites what it needs, so later calls on the file do not keep failing" << std::endl;
+            of_src << "  inline int uring_status(uring_file* f, const int& code) {" << std::endl;
+            of_src << "    if (!f->failed) {" << std::endl;
+            of_src << "      return SQLITE_OK;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    f->failed = false;" << std::endl;
+            of_src << "    return code;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_flush(uring_file* f) {" << std::endl;
+            of_src << "    if (!f->pending.empty() || (f->ring.queued > 0)) {" << std::endl;
+            of_src << "      auto ok = f->ring.drain([f](uint64_t tag, int32_t res){" << std::endl;
+            of_src << "        if (((tag & uring_tag_write) != 0) && (res != static_cast<int32_t>(tag & ~uring_tag_write))) {" << std::endl;
+            of_src << "          f->failed = true;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "      });" << std::endl;
+            of_src << "      if (!ok) {" << std::endl;
+            of_src << "        f->failed = true;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      f->pending.clear();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return f->failed ? SQLITE_IOERR_WRITE : SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void uring_flush_wal(uring_file* db) {" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> lg(uring_mx);" << std::endl;
+            of_src << "    for (auto it = uring_pending.begin(); it != uring_pending.end();) {" << std::endl;
+            of_src << "      auto f = *it;" << std::endl;
+            of_src << "      if (f->name == db->wal) {" << std::endl;
+            of_src << "        std::lock_guard<std::mutex> fg(f->mx);" << std::endl;
+            of_src << "        uring_flush(f);" << std::endl;
+            of_src << "        it = uring_pending.erase(it);" << std::endl;
+            of_src << "      } else {" << std::endl;
+            of_src << "        ++it;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // one read or fsync, after everything already queued on the file" << std::endl;
+            of_src << "  int uring_wait(uring_file* f, io_uring_sqe* sqe) {" << std::endl;
+            of_src << "    sqe->user_data = (sqe->opcode == IORING_OP_FSYNC) ? uring_tag_sync : uring_tag_read;" << std::endl;
+            of_src << "    f->ring.push();" << std::endl;
+            of_src << "    int32_t rv = -EIO;" << std::endl;
+            of_src << "    auto ok = f->ring.drain([f, &rv](uint64_t tag, int32_t res){" << std::endl;
+            of_src << "      if ((tag & uring_tag_write) != 0) {" << std::endl;
+            of_src << "        if (res != static_cast<int32_t>(tag & ~uring_tag_write)) {" << std::endl;
+            of_src << "          f->failed = true;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "      } else {" << std::endl;
+            of_src << "        rv = res;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    });" << std::endl;
+            of_src << "    f->pending.clear();" << std::endl;
+            of_src << "    return ok ? rv : -EIO;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_pread(uring_file* f, void* buf, int amt, sqlite3_int64 off) {" << std::endl;
+            of_src << "    int got = 0;" << std::endl;
+            of_src << "    while (got < amt) {" << std::endl;
+            of_src << "      auto sqe = f->ring.prep();" << std::endl;
+            of_src << "      if (sqe == nullptr) {" << std::endl;
+            of_src << "        uring_flush(f);" << std::endl;
+            of_src << "        continue;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      sqe->opcode = IORING_OP_READ;" << std::endl;
+            of_src << "      sqe->fd = f->fd;" << std::endl;
+            of_src << "      sqe->addr = reinterpret_cast<uint64_t>(static_cast<char*>(buf) + got);" << std::endl;
+            of_src << "      sqe->len = static_cast<uint32_t>(amt - got);" << std::endl;
+            of_src << "      sqe->off = static_cast<uint64_t>(off + got);" << std::endl;
+            of_src << "      auto res = uring_wait(f, sqe);" << std::endl;
+            of_src << "      if (res < 0) {" << std::endl;
+            of_src << "        return -1;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if (res == 0) {" << std::endl;
+            of_src << "        break;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      got += res;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return got;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_close(sqlite3_file* pf) {" << std::endl;
+            of_src << "    auto f = reinterpret_cast<uring_file*>(pf);" << std::endl;
+            of_src << "    if (f->type == SQLITE_OPEN_WAL) {" << std::endl;
+            of_src << "      std::lock_guard<std::mutex> lg(uring_mx);" << std::endl;
+            of_src << "      uring_pending.erase(std::remove(uring_pending.begin(), uring_pending.end(), f), uring_pending.end());" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    uring_flush(f);" << std::endl;
+            of_src << "    auto frc = uring_status(f, SQLITE_IOERR_WRITE);" << std::endl;
+            of_src << "    auto rc = f->real->pMethods->xClose(f->real);" << std::endl;
+            of_src << "    f->ring.close();" << std::endl;
+            of_src << "    f->~uring_file();" << std::endl;
+            of_src << "    return (rc != SQLITE_OK) ? rc : frc;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_read(sqlite3_file* pf, void* buf, int amt, sqlite3_int64 off) {" << std::endl;
+            of_src << "    auto f = reinterpret_cast<uring_file*>(pf);" << std::endl;
+            of_src << "    if (f->fd < 0) {" << std::endl;
+            of_src << "      return f->real->pMethods->xRead(f->real, buf, amt, off);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> fg(f->mx);" << std::endl;
+            of_src << "    if (uring_flush(f) != SQLITE_OK) {" << std::endl;
+            of_src << "      return uring_status(f, SQLITE_IOERR_WRITE);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    int got = 0;" << std::endl;
+            of_src << "    if (f->type == SQLITE_OPEN_MAIN_DB) {" << std::endl;
+            of_src << "      f->seq = (off == f->lastEnd) ? (f->seq + 1) : 0;" << std::endl;
+            of_src << "      f->lastEnd = off + amt;" << std::endl;
+            of_src << "      // sequential scans read ahead into a buffer, dropped whenever the file may have changed" << std::endl;
+            of_src << "      if ((f->raOff < 0) || (off < f->raOff) || ((off + amt) > (f->raOff + static_cast<int64_t>(f->ra.size())))) {" << std::endl;
+            of_src << "        f->raOff = -1;" << std::endl;
+            of_src << "        if (f->seq >= 2) {" << std::endl;
+            of_src << "          f->ra.resize(uring_readahead);" << std::endl;
+            of_src << "          auto n = uring_pread(f, f->ra.data(), uring_readahead, off);" << std::endl;
+            of_src << "          if (n < 0) {" << std::endl;
+            of_src << "            return SQLITE_IOERR_READ;" << std::endl;
+            of_src << "          }" << std::endl;
+            of_src << "          f->ra.resize(static_cast<size_t>(n));" << std::endl;
+            of_src << "          f->raOff = off;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if (f->raOff >= 0) {" << std::endl;
+            of_src << "        got = std::min(amt, static_cast<int>(f->raOff + static_cast<int64_t>(f->ra.size()) - off));" << std::endl;
+            of_src << "        ::memcpy(buf, f->ra.data() + (off - f->raOff), static_cast<size_t>(got));" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if ((got == 0) && (f->raOff < 0)) {" << std::endl;
+            of_src << "      got = uring_pread(f, buf, amt, off);" << std::endl;
+            of_src << "      if (got < 0) {" << std::endl;
+            of_src << "        return SQLITE_IOERR_READ;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (got < amt) {" << std::endl;
+            of_src << "      ::memset(static_cast<char*>(buf) + got, 0, static_cast<size_t>(amt - got));" << std::endl;
+            of_src << "      return SQLITE_IOERR_SHORT_READ;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_write(sqlite3_file* pf, const void* buf, int amt, sqlite3_int64 off) {" << std::endl;
+            of_src << "    auto f = reinterpret_cast<uring_file*>(pf);" << std::endl;
+            of_src << "    if (f->fd < 0) {" << std::endl;
+            of_src << "      return f->real->pMethods->xWrite(f->real, buf, amt, off);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (f->type == SQLITE_OPEN_WAL) {" << std::endl;
+            of_src << "      std::lock_guard<std::mutex> lg(uring_mx);" << std::endl;
+            of_src << "      if (std::find(uring_pending.begin(), uring_pending.end(), f) == uring_pending.end()) {" << std::endl;
+            of_src << "        uring_pending.push_back(f);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> fg(f->mx);" << std::endl;
+            of_src << "    f->raOff = -1;" << std::endl;
+            of_src << "    auto sqe = f->ring.prep();" << std::endl;
+            of_src << "    if (sqe == nullptr) {" << std::endl;
+            of_src << "      if (uring_flush(f) != SQLITE_OK) {" << std::endl;
+            of_src << "        return uring_status(f, SQLITE_IOERR_WRITE);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      sqe = f->ring.prep();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    // WAL frames are queued until the page of a commit frame, which waits for all of them, so that a" << std::endl;
+            of_src << "    // failed write fails the commit before sqlite publishes its frames in the wal-index" << std::endl;
+            of_src << "    auto flush = (f->type != SQLITE_OPEN_WAL) || f->commit;" << std::endl;
+            of_src << "    f->commit = false;" << std::endl;
+            of_src << "    if ((f->type == SQLITE_OPEN_WAL) && (amt == 24) && (off >= 32)) {" << std::endl;
+            of_src << "      // a frame header, bytes 4-7 hold the database size after a commit and are 0 otherwise" << std::endl;
+            of_src << "      auto h = static_cast<const unsigned char*>(buf);" << std::endl;
+            of_src << "      f->commit = ((h[4] | h[5] | h[6] | h[7]) != 0);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    f->pending.emplace_back(static_cast<const char*>(buf), static_cast<const char*>(buf) + amt);" << std::endl;
+            of_src << "    sqe->opcode = IORING_OP_WRITE;" << std::endl;
+            of_src << "    sqe->fd = f->fd;" << std::endl;
+            of_src << "    sqe->addr = reinterpret_cast<uint64_t>(f->pending.back().data());" << std::endl;
+            of_src << "    sqe->len = static_cast<uint32_t>(amt);" << std::endl;
+            of_src << "    sqe->off = static_cast<uint64_t>(off);" << std::endl;
+            of_src << "    sqe->user_data = uring_tag_write | static_cast<uint64_t>(amt);" << std::endl;
+            of_src << "    f->ring.push();" << std::endl;
+            of_src << "    if (flush) {" << std::endl;
+            of_src << "      uring_flush(f);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return uring_status(f, SQLITE_IOERR_WRITE);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_truncate(sqlite3_file* pf, sqlite3_int64 size) {" << std::endl;
+            of_src << "    auto f = reinterpret_cast<uring_file*>(pf);" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> fg(f->mx);" << std::endl;
+            of_src << "    f->raOff = -1;" << std::endl;
+            of_src << "    if (uring_flush(f) != SQLITE_OK) {" << std::endl;
+            of_src << "      return uring_status(f, SQLITE_IOERR_WRITE);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return f->real->pMethods->xTruncate(f->real, size);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_sync(sqlite3_file* pf, int flags) {" << std::endl;
+            of_src << "    auto f = reinterpret_cast<uring_file*>(pf);" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> fg(f->mx);" << std::endl;
+            // the queued writes complete first, so a failed one is returned as such and not hidden behind the fsync
+            of_src << "    if (uring_flush(f) != SQLITE_OK) {" << std::endl;
+            of_src << "      return uring_status(f, SQLITE_IOERR_WRITE);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if ((f->fd < 0) || !f->synced) {" << std::endl;
+            of_src << "      // the first sync goes to the wrapped file, which also syncs the directory of a new file" << std::endl;
+            of_src << "      f->synced = true;" << std::endl;
+            of_src << "      return f->real->pMethods->xSync(f->real, flags);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto sqe = f->ring.prep();" << std::endl;
+            of_src << "    sqe->opcode = IORING_OP_FSYNC;" << std::endl;
+            of_src << "    sqe->fd = f->fd;" << std::endl;
+            of_src << "    if ((flags & SQLITE_SYNC_DATAONLY) != 0) {" << std::endl;
+            of_src << "      sqe->fsync_flags = IORING_FSYNC_DATASYNC;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    auto res = uring_wait(f, sqe);" << std::endl;
+            of_src << "    auto rc = uring_status(f, SQLITE_IOERR_FSYNC);" << std::endl;
+            of_src << "    return (res < 0) ? SQLITE_IOERR_FSYNC : rc;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_filesize(sqlite3_file* pf, sqlite3_int64* size) {" << std::endl;
+            of_src << "    auto f = reinterpret_cast<uring_file*>(pf);" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> fg(f->mx);" << std::endl;
+            of_src << "    if (uring_flush(f) != SQLITE_OK) {" << std::endl;
+            of_src << "      return uring_status(f, SQLITE_IOERR_WRITE);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return f->real->pMethods->xFileSize(f->real, size);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_lock(sqlite3_file* pf, int lock) {" << std::endl;
+            of_src << "    reinterpret_cast<uring_file*>(pf)->raOff = -1;" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xLock(uring_real(pf), lock);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_unlock(sqlite3_file* pf, int lock) {" << std::endl;
+            of_src << "    reinterpret_cast<uring_file*>(pf)->raOff = -1;" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xUnlock(uring_real(pf), lock);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_checkreservedlock(sqlite3_file* pf, int* out) {" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xCheckReservedLock(uring_real(pf), out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_filecontrol(sqlite3_file* pf, int op, void* arg) {" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xFileControl(uring_real(pf), op, arg);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_sectorsize(sqlite3_file* pf) {" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xSectorSize(uring_real(pf));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_devicecharacteristics(sqlite3_file* pf) {" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xDeviceCharacteristics(uring_real(pf));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_shmmap(sqlite3_file* pf, int pg, int sz, int extend, void volatile** out) {" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xShmMap(uring_real(pf), pg, sz, extend, out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // a read transaction starts and a commit publishes its frames through the wal-index locks and barrier" << std::endl;
+            of_src << "  int uring_shmlock(sqlite3_file* pf, int offset, int n, int flags) {" << std::endl;
+            of_src << "    uring_flush_wal(reinterpret_cast<uring_file*>(pf));" << std::endl;
+            of_src << "    reinterpret_cast<uring_file*>(pf)->raOff = -1;" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xShmLock(uring_real(pf), offset, n, flags);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  void uring_shmbarrier(sqlite3_file* pf) {" << std::endl;
+            of_src << "    uring_flush_wal(reinterpret_cast<uring_file*>(pf));" << std::endl;
+            of_src << "    reinterpret_cast<uring_file*>(pf)->raOff = -1;" << std::endl;
+            of_src << "    uring_real(pf)->pMethods->xShmBarrier(uring_real(pf));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_shmunmap(sqlite3_file* pf, int del) {" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xShmUnmap(uring_real(pf), del);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_fetch(sqlite3_file* pf, sqlite3_int64 off, int amt, void** out) {" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xFetch(uring_real(pf), off, amt, out);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_unfetch(sqlite3_file* pf, sqlite3_int64 off, void* p) {" << std::endl;
+            of_src << "    return uring_real(pf)->pMethods->xUnfetch(uring_real(pf), off, p);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // the wrapped unix files all have version 3 methods" << std::endl;
+            of_src << "  const sqlite3_io_methods uring_methods = {3, uring_close, uring_read, uring_write, uring_truncate, uring_sync, uring_filesize, uring_lock, uring_unlock, uring_checkreservedlock, uring_filecontrol, uring_sectorsize, uring_devicecharacteristics, uring_shmmap, uring_shmlock, uring_shmbarrier, uring_shmunmap, uring_fetch, uring_unfetch};" << std::endl;
+            of_src << std::endl;
+            of_src << "  const size_t uring_file_size = (sizeof(uring_file) + 15) & ~static_cast<size_t>(15);" << std::endl;
+            of_src << std::endl;
+            of_src << "  int uring_open(sqlite3_vfs* vfs, const char* name, sqlite3_file* pf, int flags, int* outFlags) {" << std::endl;
+            of_src << "    auto f = new (pf) uring_file();" << std::endl;
+            of_src << "    f->real = reinterpret_cast<sqlite3_file*>(reinterpret_cast<char*>(pf) + uring_file_size);" << std::endl;
+            of_src << "    f->fd = -1;" << std::endl;
+            of_src << "    f->type = flags & (SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_WAL);" << std::endl;
+            of_src << "    f->synced = false;" << std::endl;
+            of_src << "    f->failed = false;" << std::endl;
+            of_src << "    f->commit = false;" << std::endl;
+            of_src << "    f->raOff = -1;" << std::endl;
+            of_src << "    f->lastEnd = -1;" << std::endl;
+            of_src << "    f->seq = 0;" << std::endl;
+            of_src << "    uring_opened = -1;" << std::endl;
+            of_src << "    auto rc = vfs_root(vfs)->xOpen(vfs_root(vfs), name, f->real, flags, outFlags);" << std::endl;
+            of_src << "    auto h = uring_opened;" << std::endl;
+            of_src << "    if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "      f->~uring_file();" << std::endl;
+            of_src << "      pf->pMethods = nullptr;" << std::endl;
+            of_src << "      return rc;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    // only the database and its WAL go through io_uring, and only when the descriptor is the named file" << std::endl;
+            of_src << "    // (none is seen when the unix VFS reuses a descriptor it kept from a closed connection)" << std::endl;
+            of_src << "    if ((f->type == SQLITE_OPEN_MAIN_DB) && (name != nullptr)) {" << std::endl;
+            of_src << "      f->wal = ::sqlite3_filename_wal(name);" << std::endl;
+            of_src << "    } else if ((f->type == SQLITE_OPEN_WAL) && (name != nullptr)) {" << std::endl;
+            of_src << "      f->name = name;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if ((f->type != 0) && (name != nullptr) && (h >= 0)) {" << std::endl;
+            of_src << "      struct stat s1;" << std::endl;
+            of_src << "      struct stat s2;" << std::endl;
+            of_src << "      if ((::fstat(h, &s1) == 0) && (::stat(name, &s2) == 0) && (s1.st_dev == s2.st_dev) && (s1.st_ino == s2.st_ino) && f->ring.open(64)) {" << std::endl;
+            of_src << "        f->fd = h;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    pf->pMethods = &uring_methods;" << std::endl;
+            of_src << "    return SQLITE_OK;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "bool " << module.generateBaseNS << "::registerUringVfs(const bool& makeDefault) {" << std::endl;
+            of_src << "  static std::once_flag once;" << std::endl;
+            of_src << "  static bool rv = false;" << std::endl;
+            of_src << "  std::call_once(once, [](){" << std::endl;
+            of_src << "    uring probe;" << std::endl;
+            of_src << "    if (!probe.open(1)) {" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    probe.close();" << std::endl;
+            of_src << "    auto root = ::sqlite3_vfs_find(\"unix\");" << std::endl;
+            of_src << "    if ((root == nullptr) || (root->iVersion < 3)) {" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    uring_sys_open = root->xGetSystemCall(root, \"open\");" << std::endl;
+            of_src << "    if ((uring_sys_open == nullptr) || (root->xSetSystemCall(root, \"open\", reinterpret_cast<sqlite3_syscall_ptr>(&uring_sys_capture)) != SQLITE_OK)) {" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    uring_vfs = vfs_wrap(root, uringVfs, static_cast<int>(uring_file_size), uring_open);" << std::endl;
+            of_src << "    rv = (::sqlite3_vfs_register(&uring_vfs, 0) == SQLITE_OK);" << std::endl;
+            of_src << "  });" << std::endl;
+            of_src << "  if (rv && makeDefault) {" << std::endl;
+            of_src << "    ::sqlite3_vfs_register(&uring_vfs, 1);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  return rv;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << "#endif // SQLCH_IO_URING" << std::endl;
+            of_src << std::endl;
+
+            // sqlite3_config only works before sqlite is initialized, so this runs once, on the first call
+            // or the first open, and returns false if the configuration came too late to be applied
+            // (sqlite was initialized by someone else) or any part of it was refused
+            of_src << "bool " << module.generateBaseNS << "::initialize(const runtime_config& cfg) {" << std::endl;
+            of_src << "  static std::once_flag once;" << std::endl;
+            of_src << "  bool rv = false;" << std::endl;
+            of_src << "  std::call_once(once, [&cfg, &rv](){" << std::endl;
+            of_src << "    alloc_config = cfg;" << std::endl;
+            of_src << "    int rc = SQLITE_OK;" << std::endl;
+            if (module.mutexName.length() > 0) {
+                of_src << "#if " << module.mutexName << std::endl;
+                of_src << "    rc = ::sqlite3_config(SQLITE_CONFIG_SERIALIZED);" << std::endl;
+                of_src << "#else //" << module.mutexName << std::endl;
+                of_src << "    rc = ::sqlite3_config(SQLITE_CONFIG_SINGLETHREAD);" << std::endl;
+                of_src << "#endif //" << module.mutexName << std::endl;
+                of_src << "    if (rc != SQLITE_OK) {" << std::endl;
+                of_src << "      return;" << std::endl;
+                of_src << "    }" << std::endl;
+            }
+            of_src << "    if (cfg.poolAllocator || cfg.countAllocs) {" << std::endl;
+            of_src << "      rc = ::sqlite3_config(SQLITE_CONFIG_GETMALLOC, &alloc_default);" << std::endl;
+            of_src << "      if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "        return;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      alloc_usePool = cfg.poolAllocator;" << std::endl;
+            of_src << "      rc = ::sqlite3_config(SQLITE_CONFIG_MALLOC, &alloc_methods);" << std::endl;
+            of_src << "      if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "        alloc_usePool = false;" << std::endl;
+            of_src << "        return;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (cfg.pageCacheBudget > 0) {" << std::endl;
+            of_src << "      pcache_budget = cfg.pageCacheBudget;" << std::endl;
+            of_src << "      rc = ::sqlite3_config(SQLITE_CONFIG_PCACHE2, &pcache_methods);" << std::endl;
+            of_src << "      if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "        pcache_budget = 0;" << std::endl;
+            of_src << "        return;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (::sqlite3_initialize() != SQLITE_OK) {" << std::endl;
+            of_src << "      return;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (cfg.softHeapLimit > 0) {" << std::endl;
+            of_src << "      ::sqlite3_soft_heap_limit64(cfg.softHeapLimit);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (cfg.hardHeapLimit > 0) {" << std::endl;
+            of_src << "      ::sqlite3_hard_heap_limit64(cfg.hardHeapLimit);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    rv = true;" << std::endl;
+            of_src << "  });" << std::endl;
+            of_src << "  return rv;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << module.generateBaseNS << "::alloc_stats " << module.generateBaseNS << "::allocStats() {" << std::endl;
+            of_src << "  alloc_stats s;" << std::endl;
+            of_src << "  s.mallocs = alloc_mallocs;" << std::endl;
+            of_src << "  s.reallocs = alloc_reallocs;" << std::endl;
+            of_src << "  s.frees = alloc_frees;" << std::endl;
+            of_src << "  s.pooled = alloc_pooled;" << std::endl;
+            of_src << "  ::sqlite3_int64 cur = 0;" << std::endl;
+            of_src << "  ::sqlite3_int64 hi = 0;" << std::endl;
+            of_src << "  ::sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &cur, &hi, 0);" << std::endl;
+            of_src << "  s.used = cur;" << std::endl;
+            of_src << "  s.highwater = hi;" << std::endl;
+            of_src << "  return s;" << std::endl;
+            of_src << "}" << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::database::open(const std::string& filename, const int& flags, const char* vfs){" << std::endl;
+            of_src << "  initialize();" << std::endl;
+            of_src << "  if (val_ != nullptr) {close();}" << std::endl;
+            of_src << "  " << module.onOpen << "(filename, flags);" << std::endl;
+            of_src << "  int rc = ::sqlite3_open_v2(filename.c_str(), &val_, flags, vfs);" << std::endl;
+            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "    rc=" << module.onError << "(filename, \"open_db:\" + filename, rc, error(val_));" << std::endl;
+            of_src << "    val_ = nullptr;" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+
+            if(module.onTrace != "") {
+                of_src << "  sqlite3_trace(val_, &on_Trace, NULL);" << std::endl;
+            }
+
+            of_src << "  if (alloc_config.lookasideCount > 0) {" << std::endl;
+            of_src << "    ::sqlite3_db_config(val_, SQLITE_DBCONFIG_LOOKASIDE, nullptr, alloc_config.lookasideSize, alloc_config.lookasideCount);" << std::endl;
+            of_src << "  }" << std::endl;
+            // mapped pages are shared with every other connection to the file through the OS page cache
+            of_src << "  if (alloc_config.mmapSize > 0) {" << std::endl;
+            of_src << "    exec(\"PRAGMA mmap_size=\" + std::to_string(alloc_config.mmapSize) + \";\");" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  rc = ::sqlite3_create_module(val_, \"sqlch_array\", &array_module, nullptr);" << std::endl;
+            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "    " << module.onError << "(filename, \"create_module:sqlch_array\", rc, error(val_));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  beginTx_.open(\"BEGIN EXCLUSIVE\", \"begin\");" << std::endl;
+            of_src << "  beginImmTx_.open(\"BEGIN IMMEDIATE\", \"begin\");" << std::endl;
+            of_src << "  commitTx_.open(\"COMMIT\", \"commit\");" << std::endl;
+
+            of_src << "  ::sqlite3_busy_timeout(val_, 5000);" << std::endl;
+            of_src << "  ::sqlite3_commit_hook(val_, [](void* ctx){" << std::endl;
+            of_src << "    static_cast<database*>(ctx)->committed_ = true;" << std::endl;
+            of_src << "    return 0;" << std::endl;
+            of_src << "  }, this);" << std::endl;
+            of_src << "  ::sqlite3_rollback_hook(val_, [](void* ctx){" << std::endl;
+            of_src << "    auto self = static_cast<database*>(ctx);" << std::endl;
+            of_src << "    self->committed_ = false;" << std::endl;
+            of_src << "    ++self->epoch_;" << std::endl;
+            of_src << "    for (auto l : self->listeners_) {" << std::endl;
+            of_src << "      l->rolledBack();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }, this);" << std::endl;
+            of_src << "  filename_ = filename;" << std::endl;
+            of_src << "  vfs_ = (vfs != nullptr) ? vfs : \"\";" << std::endl;
+            of_src << "  " << module.onOpened << "(*this);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::database::close(){" << std::endl;
+            of_src << "  if (val_) {" << std::endl;
+            // a session has to be deleted before its connection is closed
+            of_src << "    if (repl_ != nullptr) {" << std::endl;
+            of_src << "      repl_->stop();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    beginTx_.close();" << std::endl;
+            of_src << "    beginImmTx_.close();" << std::endl;
+            of_src << "    commitTx_.close();" << std::endl;
+            // the listeners may be gone by the time a destructor closes the connection
+            of_src << "    ::sqlite3_commit_hook(val_, nullptr, nullptr);" << std::endl;
+            of_src << "    ::sqlite3_rollback_hook(val_, nullptr, nullptr);" << std::endl;
+            of_src << "    preupdate_ = nullptr;" << std::endl;
+            of_src << "    int rc = SQLITE_BUSY;" << std::endl;
+            of_src << "    for (int i = 0; ((i < 10) && (rc == SQLITE_BUSY)); ++i) {" << std::endl;
+            of_src << "      rc = ::sqlite3_close(val_);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (rc > 0) {" << std::endl;
+            of_src << "      " << module.onError << "(filename_, \"close_db\", rc, error(val_));" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  val_ = nullptr;" << std::endl;
+            of_src << "  filename_ = \"\";" << std::endl;
+            of_src << "  ++epoch_;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::database::exec(const std::string& sqls){" << std::endl;
+            of_src << "  char* err = nullptr;" << std::endl;
+            of_src << "  int rc = sqlite3_exec(val_, sqls.c_str(), nullptr, nullptr, &err);" << std::endl;
+            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "    std::string msg(err);" << std::endl;
+            of_src << "    sqlite3_free(err);" << std::endl;
+            of_src << "    " << module.onError << "(filename_, \"exec[\" + sqls + \"]\", rc, msg);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  afterStep();" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::database::onCommitted(){" << std::endl;
+            of_src << "  connection_lock lk(*this);" << std::endl;
+            // another thread may have begun a transaction since, its commit then tells for both
+            of_src << "  if (!committed_ || !::sqlite3_get_autocommit(val_)) {" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  committed_ = false;" << std::endl;
+            of_src << "  for (auto l : listeners_) {" << std::endl;
+            of_src << "    l->committed();" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            // the hooks read the list with the connection mutex held
+            of_src << "void " << module.generateBaseNS << "::database::listen(commit_listener* l){" << std::endl;
+            of_src << "  if (val_ == nullptr) {" << std::endl;
+            of_src << "    listeners_.push_back(l);" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  connection_lock lk(*this);" << std::endl;
+            of_src << "  listeners_.push_back(l);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::database::unlisten(commit_listener* l){" << std::endl;
+            of_src << "  if (val_ == nullptr) {" << std::endl;
+            of_src << "    listeners_.erase(std::remove(listeners_.begin(), listeners_.end(), l), listeners_.end());" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  connection_lock lk(*this);" << std::endl;
+            of_src << "  listeners_.erase(std::remove(listeners_.begin(), listeners_.end(), l), listeners_.end());" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            // a second owner would replace the hook of the first, which then reads changes it never gets,
+            // or leaves its session pointing at a hook that is gone
+            of_src << "bool " << module.generateBaseNS << "::database::ownPreupdate(void* owner, const std::string& src){" << std::endl;
+            of_src << "  connection_lock lk(*this);" << std::endl;
+            of_src << "  if ((preupdate_ != nullptr) && (preupdate_ != owner)) {" << std::endl;
+            of_src << "    " << module.onError << "(filename_, src, SQLITE_MISUSE, \"replication and enableChanges() can not both run on a connection\");" << std::endl;
+            of_src << "    return false;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  preupdate_ = owner;" << std::endl;
+            of_src << "  return true;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            // runs inside the writer's commit, so it only records the WAL size and wakes the thread
+            of_src << "int " << module.generateBaseNS << "::maintenance::onWal(void* ctx, sqlite3* /*db*/, const char* /*name*/, int frames) {" << std::endl;
+            of_src << "  auto m = static_cast<maintenance*>(ctx);" << std::endl;
+            of_src << "  m->frames_ = frames;" << std::endl;
+            of_src << "  if (m->isWalDue()) {" << std::endl;
+            // under the mutex, so the wakeup cannot fall between the predicate check and the wait of run()
+            of_src << "    std::lock_guard<std::mutex> lg(m->mx_);" << std::endl;
+            of_src << "    m->cv_.notify_one();" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  return SQLITE_OK;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "int " << module.generateBaseNS << "::maintenance::pragma(const char* sql) {" << std::endl;
+            of_src << "  sqlite3_stmt* stmt = nullptr;" << std::endl;
+            of_src << "  int rv = -1;" << std::endl;
+            of_src << "  if (::sqlite3_prepare_v2(conn_.val_, sql, -1, &stmt, nullptr) == SQLITE_OK) {" << std::endl;
+            of_src << "    if (::sqlite3_step(stmt) == SQLITE_ROW) {" << std::endl;
+            of_src << "      rv = ::sqlite3_column_int(stmt, 0);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  ::sqlite3_finalize(stmt);" << std::endl;
+            of_src << "  return rv;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::maintenance::checkpoint(const bool& truncate) {" << std::endl;
+            of_src << "  int log = -1;" << std::endl;
+            of_src << "  int ckpt = -1;" << std::endl;
+            of_src << "  auto t0 = std::chrono::steady_clock::now();" << std::endl;
+            of_src << "  int rc = ::sqlite3_wal_checkpoint_v2(conn_.val_, nullptr, SQLITE_CHECKPOINT_PASSIVE, &log, &ckpt);" << std::endl;
+            of_src << "  if ((rc == SQLITE_OK) && truncate && (log > 0) && (log == ckpt)) {" << std::endl;
+            // every frame is in the database already, so the truncate only needs the writer lock and no readers;
+            // without a busy timeout it gives up at once instead of holding off the writer while it waits
+            of_src << "    ::sqlite3_busy_timeout(conn_.val_, 0);" << std::endl;
+            of_src << "    int trc = ::sqlite3_wal_checkpoint_v2(conn_.val_, nullptr, SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr);" << std::endl;
+            of_src << "    ::sqlite3_busy_timeout(conn_.val_, 100);" << std::endl;
+            of_src << "    if (trc == SQLITE_OK) {" << std::endl;
+            of_src << "      ++truncates_;" << std::endl;
+            of_src << "      log = 0;" << std::endl;
+            of_src << "      ckpt = 0;" << std::endl;
+            of_src << "    } else if ((trc == SQLITE_BUSY) || (trc == SQLITE_LOCKED)) {" << std::endl;
+            // the passive checkpoint still counts, the truncate is tried again next time
+            of_src << "      ++busy_;" << std::endl;
+            of_src << "    } else {" << std::endl;
+            of_src << "      rc = trc;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  if ((rc == SQLITE_BUSY) || (rc == SQLITE_LOCKED)) {" << std::endl;
+            of_src << "    ++busy_;" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "    " << module.onError << "(conn_.filename_, \"checkpoint\", rc, error(conn_.val_));" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  if (log < 0) {" << std::endl;
+            // not in WAL mode
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();" << std::endl;
+            of_src << "  ++checkpoints_;" << std::endl;
+            of_src << "  backfilled_ = ckpt;" << std::endl;
+            of_src << "  ckptFrames_ = log;" << std::endl;
+            of_src << "  lastCheckpoint_ = us;" << std::endl;
+            of_src << "  if (us > maxCheckpoint_) {" << std::endl;
+            of_src << "    maxCheckpoint_ = us;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            // analysis_limit keeps each ANALYZE it decides to run short
+            of_src << "void " << module.generateBaseNS << "::maintenance::optimize() {" << std::endl;
+            of_src << "  if (::sqlite3_exec(conn_.val_, \"PRAGMA analysis_limit=400;PRAGMA optimize=0x10002;\", nullptr, nullptr, nullptr) == SQLITE_OK) {" << std::endl;
+            of_src << "    ++optimizes_;" << std::endl;
+            of_src << "  } else {" << std::endl;
+            of_src << "    ++busy_;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::maintenance::vacuum() {" << std::endl;
+            of_src << "  auto before = pragma(\"PRAGMA freelist_count;\");" << std::endl;
+            of_src << "  if (before <= 0) {" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  auto sql = \"PRAGMA incremental_vacuum(\" + std::to_string(cfg_.vacuumPages) + \");\";" << std::endl;
+            of_src << "  if (::sqlite3_exec(conn_.val_, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {" << std::endl;
+            of_src << "    ++busy_;" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  auto after = pragma(\"PRAGMA freelist_count;\");" << std::endl;
+            of_src << "  if (after < before) {" << std::endl;
+            of_src << "    vacuumed_ += static_cast<uint64_t>(before - after);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::maintenance::run() {" << std::endl;
+            of_src << "  typedef std::chrono::steady_clock clock;" << std::endl;
+            of_src << "  auto nextCheckpoint = clock::now() + cfg_.checkpointInterval;" << std::endl;
+            of_src << "  auto nextOptimize = clock::now() + cfg_.optimizeInterval;" << std::endl;
+            of_src << "  auto nextVacuum = clock::now() + cfg_.vacuumInterval;" << std::endl;
+            of_src << "  std::unique_lock<std::mutex> lk(mx_);" << std::endl;
+            of_src << "  while (!stop_) {" << std::endl;
+            of_src << "    auto due = nextCheckpoint;" << std::endl;
+            of_src << "    if ((cfg_.optimizeInterval.count() > 0) && (nextOptimize < due)) {" << std::endl;
+            of_src << "      due = nextOptimize;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (incremental_ && (nextVacuum < due)) {" << std::endl;
+            of_src << "      due = nextVacuum;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    cv_.wait_until(lk, due, [this](){return (stop_ || isWalDue());});" << std::endl;
+            of_src << "    if (stop_) {" << std::endl;
+            of_src << "      break;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    lk.unlock();" << std::endl;
+            of_src << "    auto now = clock::now();" << std::endl;
+            of_src << "    if ((now >= nextCheckpoint) || isWalDue()) {" << std::endl;
+            of_src << "      checkpoint(frames_ >= cfg_.truncateFrames);" << std::endl;
+            of_src << "      nextCheckpoint = clock::now() + cfg_.checkpointInterval;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if ((cfg_.optimizeInterval.count() > 0) && (now >= nextOptimize)) {" << std::endl;
+            of_src << "      optimize();" << std::endl;
+            of_src << "      nextOptimize = clock::now() + cfg_.optimizeInterval;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (incremental_ && (now >= nextVacuum)) {" << std::endl;
+            of_src << "      vacuum();" << std::endl;
+            of_src << "      nextVacuum = clock::now() + cfg_.vacuumInterval;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    lk.lock();" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            // the maintenance thread works on a connection of its own, so it never
+            // holds the writer's connection or runs inside one of its transactions
+            of_src << "void " << module.generateBaseNS << "::maintenance::start(const maintenance_config& cfg) {" << std::endl;
+            of_src << "  stop();" << std::endl;
+            of_src << "  cfg_ = cfg;" << std::endl;
+            of_src << "  conn_.openrw(db_.filename(), db_.vfs());" << std::endl;
+            of_src << "  ::sqlite3_busy_timeout(conn_.val_, 100);" << std::endl;
+            of_src << "  incremental_ = ((cfg_.vacuumPages > 0) && (pragma(\"PRAGMA auto_vacuum;\") == 2));" << std::endl;
+            of_src << "  frames_ = 0;" << std::endl;
+            of_src << "  ckptFrames_ = 0;" << std::endl;
+            // replaces the inline autocheckpoint of the writer, remembering its setting for stop()
+            of_src << "  autoCheckpoint_ = 0;" << std::endl;
+            of_src << "  sqlite3_stmt* stmt = nullptr;" << std::endl;
+            of_src << "  if (::sqlite3_prepare_v2(db_.val_, \"PRAGMA wal_autocheckpoint;\", -1, &stmt, nullptr) == SQLITE_OK) {" << std::endl;
+            of_src << "    if (::sqlite3_step(stmt) == SQLITE_ROW) {" << std::endl;
+            of_src << "      autoCheckpoint_ = ::sqlite3_column_int(stmt, 0);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  ::sqlite3_finalize(stmt);" << std::endl;
+            of_src << "  ::sqlite3_wal_hook(db_.val_, &maintenance::onWal, this);" << std::endl;
+            of_src << "  stop_ = false;" << std::endl;
+            of_src << "  thread_ = std::thread(&maintenance::run, this);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::maintenance::stop() {" << std::endl;
+            of_src << "  if (!thread_.joinable()) {" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  {" << std::endl;
+            of_src << "    std::lock_guard<std::mutex> lg(mx_);" << std::endl;
+            of_src << "    stop_ = true;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  cv_.notify_one();" << std::endl;
+            of_src << "  thread_.join();" << std::endl;
+            of_src << "  if (db_.isOpen()) {" << std::endl;
+            // restores the inline autocheckpoint the writer had before start() (and removes the hook)
+            of_src << "    ::sqlite3_wal_autocheckpoint(db_.val_, autoCheckpoint_);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  conn_.close();" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << module.generateBaseNS << "::maintenance_stats " << module.generateBaseNS << "::maintenance::stats() const {" << std::endl;
+            of_src << "  maintenance_stats s;" << std::endl;
+            of_src << "  s.checkpoints = checkpoints_;" << std::endl;
+            of_src << "  s.truncates = truncates_;" << std::endl;
+            of_src << "  s.busy = busy_;" << std::endl;
+            of_src << "  s.walFrames = frames_;" << std::endl;
+            of_src << "  s.backfilled = backfilled_;" << std::endl;
+            of_src << "  s.lastCheckpoint = std::chrono::microseconds(lastCheckpoint_);" << std::endl;
+            of_src << "  s.maxCheckpoint = std::chrono::microseconds(maxCheckpoint_);" << std::endl;
+            of_src << "  s.optimizes = optimizes_;" << std::endl;
+            of_src << "  s.vacuumedPages = vacuumed_;" << std::endl;
+            of_src << "  return s;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::file_sink::write(const void* data, const size_t& size) {" << std::endl;
+            of_src << "  uint32_t len = static_cast<uint32_t>(size);" << std::endl;
+            of_src << "  if ((::fwrite(&len, sizeof(len), 1, fp_) != 1) || (::fwrite(data, 1, size, fp_) != size) || (::fflush(fp_) != 0)) {" << std::endl;
+            of_src << "    " << module.onError << "(\"\", \"changeset_write\", SQLITE_IOERR, ::strerror(errno));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << module.generateBaseNS << "::file_sink::file_sink(const std::string& path) : fp_(::fopen(path.c_str(), \"ab\")) {" << std::endl;
+            of_src << "  if (fp_ == nullptr) {" << std::endl;
+            of_src << "    " << module.onError << "(path, \"changeset_sink:\" + path, SQLITE_CANTOPEN, ::strerror(errno));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << module.generateBaseNS << "::file_sink::~file_sink() {" << std::endl;
+            of_src << "  if (fp_ != nullptr) {" << std::endl;
+            of_src << "    ::fclose(fp_);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "bool " << module.generateBaseNS << "::file_source::next(std::vector<uint8_t>& changeset) {" << std::endl;
+            of_src << "  if (fp_ == nullptr) {" << std::endl;
+            of_src << "    return false;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  auto pos = ::ftell(fp_);" << std::endl;
+            of_src << "  uint32_t len = 0;" << std::endl;
+            of_src << "  if (::fread(&len, sizeof(len), 1, fp_) == 1) {" << std::endl;
+            of_src << "    changeset.resize(len);" << std::endl;
+            of_src << "    if (::fread(changeset.data(), 1, len, fp_) == len) {" << std::endl;
+            of_src << "      return true;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  // a changeset still being written is read again from its start on the next call" << std::endl;
+            of_src << "  ::clearerr(fp_);" << std::endl;
+            of_src << "  if (pos >= 0) {" << std::endl;
+            of_src << "    ::fseek(fp_, pos, SEEK_SET);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  return false;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << module.generateBaseNS << "::file_source::file_source(const std::string& path) : fp_(::fopen(path.c_str(), \"rb\")) {" << std::endl;
+            of_src << "  if (fp_ == nullptr) {" << std::endl;
+            of_src << "    " << module.onError << "(path, \"changeset_source:\" + path, SQLITE_CANTOPEN, ::strerror(errno));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << module.generateBaseNS << "::file_source::~file_source() {" << std::endl;
+            of_src << "  if (fp_ != nullptr) {" << std::endl;
+            of_src << "    ::fclose(fp_);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)" << std::endl;
+            // sessions can not be reset before SQLite 3.42, so each changeset gets a new one
+            of_src << "void " << module.generateBaseNS << "::replication::attach() {" << std::endl;
+            of_src << "  int rc = ::sqlite3session_create(db_.val_, \"main\", &session_);" << std::endl;
+            of_src << "  if (rc == SQLITE_OK) {" << std::endl;
+            of_src << "    rc = ::sqlite3session_attach(session_, nullptr);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "    " << module.onError << "(db_.filename_, \"replication\", rc, error(db_.val_));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::start(changeset_sink& sink) {" << std::endl;
+            of_src << "  connection_lock lk(db_);" << std::endl;
+            of_src << "  stop();" << std::endl;
+            of_src << "  if (!db_.ownPreupdate(this, \"replication\")) {" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  sink_ = &sink;" << std::endl;
+            of_src << "  attach();" << std::endl;
+            of_src << "  db_.repl_ = this;" << std::endl;
+            of_src << "  db_.listen(this);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::stop() {" << std::endl;
+            of_src << "  if (session_ == nullptr) {" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  connection_lock lk(db_);" << std::endl;
+            of_src << "  db_.repl_ = nullptr;" << std::endl;
+            of_src << "  db_.unlisten(this);" << std::endl;
+            of_src << "  db_.releasePreupdate(this);" << std::endl;
+            of_src << "  ::sqlite3session_delete(session_);" << std::endl;
+            of_src << "  session_ = nullptr;" << std::endl;
+            of_src << "  sink_ = nullptr;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::publish() {" << std::endl;
+            of_src << "  connection_lock lk(db_);" << std::endl;
+            of_src << "  // inside a transaction, its changes are not committed yet" << std::endl;
+            of_src << "  if ((session_ == nullptr) || (::sqlite3_get_autocommit(db_.val_) == 0) || ::sqlite3session_isempty(session_)) {" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  int size = 0;" << std::endl;
+            of_src << "  void* data = nullptr;" << std::endl;
+            of_src << "  int rc = ::sqlite3session_changeset(session_, &size, &data);" << std::endl;
+            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "    " << module.onError << "(db_.filename_, \"changeset\", rc, error(db_.val_));" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  ::sqlite3session_delete(session_);" << std::endl;
+            of_src << "  session_ = nullptr;" << std::endl;
+            of_src << "  attach();" << std::endl;
+            of_src << "  if (size > 0) {" << std::endl;
+            of_src << "    ++published_;" << std::endl;
+            of_src << "    publishedBytes_ += static_cast<uint64_t>(size);" << std::endl;
+            of_src << "    sink_->write(data, static_cast<size_t>(size));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  ::sqlite3_free(data);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::apply(const void* data, const size_t& size) {" << std::endl;
+            of_src << "  connection_lock lk(db_);" << std::endl;
+            of_src << "  // the follower converges on the leader, rows it has are replaced, and changes to rows it does not have are skipped" << std::endl;
+            of_src << "  auto onConflict = [](void*, int conflict, sqlite3_changeset_iter*) {" << std::endl;
+            of_src << "    return ((conflict == SQLITE_CHANGESET_DATA) || (conflict == SQLITE_CHANGESET_CONFLICT)) ? SQLITE_CHANGESET_REPLACE : SQLITE_CHANGESET_OMIT;" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << "  int rc = ::sqlite3changeset_apply(db_.val_, static_cast<int>(size), const_cast<void*>(data), nullptr, onConflict, nullptr);" << std::endl;
+            of_src << "  ++db_.epoch_;" << std::endl;
+            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "    " << module.onError << "(db_.filename_, \"apply_changeset\", rc, error(db_.val_));" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  ++applied_;" << std::endl;
+            of_src << "  appliedBytes_ += size;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << "#else" << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::attach() {" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::start(changeset_sink&) {" << std::endl;
+            of_src << "  " << module.onError << "(db_.filename_, \"replication\", SQLITE_MISUSE, \"requires SQLITE_ENABLE_SESSION and SQLITE_ENABLE_PREUPDATE_HOOK\");" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::stop() {" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::publish() {" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::replication::apply(const void*, const size_t&) {" << std::endl;
+            of_src << "  " << module.onError << "(db_.filename_, \"apply_changeset\", SQLITE_MISUSE, \"requires SQLITE_ENABLE_SESSION and SQLITE_ENABLE_PREUPDATE_HOOK\");" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << "#endif" << std::endl;
+            of_src << std::endl;
+            of_src << "size_t " << module.generateBaseNS << "::replication::follow(file_source& source) {" << std::endl;
+            of_src << "  size_t n = 0;" << std::endl;
+            of_src << "  std::vector<uint8_t> changeset;" << std::endl;
+            of_src << "  while (source.next(changeset)) {" << std::endl;
+            of_src << "    apply(changeset.data(), changeset.size());" << std::endl;
+            of_src << "    ++n;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  return n;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << module.generateBaseNS << "::replication_stats " << module.generateBaseNS << "::replication::stats() const {" << std::endl;
+            of_src << "  replication_stats s;" << std::endl;
+            of_src << "  s.published = published_;" << std::endl;
+            of_src << "  s.publishedBytes = publishedBytes_;" << std::endl;
+            of_src << "  s.applied = applied_;" << std::endl;
+            of_src << "  s.appliedBytes = appliedBytes_;" << std::endl;
+            of_src << "  return s;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::database::commit() {" << std::endl;
+            of_src << "  commitTx_.reset();" << std::endl;
+            of_src << "  commitTx_.next();" << std::endl;
+            of_src << "}" << std::endl;
             of_src << std::endl;
-
             of_src << "namespace {" << std::endl;
-            if(module.onError == "on_Error") {
-                of_src << "  inline int on_Error(const std::string& db, const std::string& src, int rc, const std::string& msg){" << std::endl;
-                of_src << "    std::cout << \"(\" << db << \"):sqlite error:\" << msg << \"(\" << rc << \") in \" << src << \", aborting.\" << std::endl;" << std::endl;
-                of_src << "    exit(1);" << std::endl;
-                of_src << "  }" << std::endl;
-                of_src << std::endl;
-            }
-            if(module.onTrace != "") {
-                of_src << "  void on_Trace(void* /*context*/, const char* /*sql*/){" << std::endl;
-                of_src << "  }" << std::endl;
-                of_src << std::endl;
-            }
-            if(module.onOpen == "on_Open") {
-                of_src << "  inline void on_Open(const std::string& /*filename*/, const int& /*flags*/){" << std::endl;
-                of_src << "  }" << std::endl;
-                of_src << std::endl;
-            }
-            if(module.onOpened == "on_Opened") {
-                of_src << "  inline void on_Opened(" << module.generateBaseNS << "::database& /*db*/){" << std::endl;
-                of_src << "  }" << std::endl;
-                of_src << std::endl;
-            }
-
-            of_src << "  inline int getParamIndex(" << module.generateBaseNS << "::statement& stmt, const std::string& key) {" << std::endl;
-            of_src << "    if (stmt.val_ == nullptr) {" << std::endl;
-            of_src << "      " << module.onError << "(stmt.db_.filename_, \"get_index\", SQLITE_MISUSE, \"uninitialized statement\");" << std::endl;
+            of_src << "  // just enough of a FlatBuffers builder for the Arrow IPC metadata. Like the real one, it" << std::endl;
+            of_src << "  // builds back to front, so that children come first and every offset points forward." << std::endl;
+            of_src << "  // Positions are distances from the end of the buffer" << std::endl;
+            of_src << "  struct flatbuffer {" << std::endl;
+            of_src << "    std::vector<uint8_t> buf;" << std::endl;
+            of_src << "    size_t head;" << std::endl;
+            of_src << "    size_t tableStart;" << std::endl;
+            of_src << "    std::vector<std::pair<uint16_t, size_t>> fields;" << std::endl;
+            of_src << std::endl;
+            of_src << "    inline size_t size() const {return buf.size() - head;}" << std::endl;
+            of_src << "    inline void reserve(const size_t& n) {" << std::endl;
+            of_src << "      if (head >= n) {" << std::endl;
+            of_src << "        return;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      auto sz = size();" << std::endl;
+            of_src << "      std::vector<uint8_t> nb(std::max(buf.size() * 2, sz + n + 64));" << std::endl;
+            of_src << "      ::memcpy(nb.data() + nb.size() - sz, buf.data() + head, sz);" << std::endl;
+            of_src << "      head = nb.size() - sz;" << std::endl;
+            of_src << "      buf.swap(nb);" << std::endl;
             of_src << "    }" << std::endl;
-            of_src << "    int idx = ::sqlite3_bind_parameter_index(stmt.val_, key.c_str());" << std::endl;
-            of_src << "    if (idx == 0) {" << std::endl;
-            of_src << "      " << module.onError << "(stmt.db_.filename_, \"unknown_param\", SQLITE_MISUSE, key);" << std::endl;
+            of_src << "    inline void pad(const size_t& n) {" << std::endl;
+            of_src << "      if (n == 0) {" << std::endl;
+            of_src << "        return;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      reserve(n);" << std::endl;
+            of_src << "      head -= n;" << std::endl;
+            of_src << "      ::memset(buf.data() + head, 0, n);" << std::endl;
             of_src << "    }" << std::endl;
-            of_src << "    return idx;" << std::endl;
+            of_src << "    // aligns so that align divides the size after the next additional bytes" << std::endl;
+            of_src << "    inline void prep(const size_t& align, const size_t& additional) {" << std::endl;
+            of_src << "      pad((align - ((size() + additional) % align)) % align);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    template <typename T> inline void push(const T& val) {" << std::endl;
+            of_src << "      prep(sizeof(T), sizeof(T));" << std::endl;
+            of_src << "      reserve(sizeof(T));" << std::endl;
+            of_src << "      head -= sizeof(T);" << std::endl;
+            of_src << "      ::memcpy(buf.data() + head, &val, sizeof(T));" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline void pushOffset(const size_t& target) {" << std::endl;
+            of_src << "      prep(4, 4);" << std::endl;
+            of_src << "      push<uint32_t>(static_cast<uint32_t>(size() + 4 - target));" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline size_t string(const std::string& s) {" << std::endl;
+            of_src << "      prep(4, s.size() + 1);" << std::endl;
+            of_src << "      pad(1);" << std::endl;
+            of_src << "      reserve(s.size());" << std::endl;
+            of_src << "      head -= s.size();" << std::endl;
+            of_src << "      ::memcpy(buf.data() + head, s.data(), s.size());" << std::endl;
+            of_src << "      push<uint32_t>(static_cast<uint32_t>(s.size()));" << std::endl;
+            of_src << "      return size();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline size_t offsets(const std::vector<size_t>& list) {" << std::endl;
+            of_src << "      prep(4, list.size() * 4);" << std::endl;
+            of_src << "      for (auto it = list.rbegin(); it != list.rend(); ++it) {" << std::endl;
+            of_src << "        pushOffset(*it);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      push<uint32_t>(static_cast<uint32_t>(list.size()));" << std::endl;
+            of_src << "      return size();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    // a vector of structs of two longs, such as FieldNode and Buffer" << std::endl;
+            of_src << "    inline size_t pairs(const std::vector<std::array<int64_t, 2>>& list) {" << std::endl;
+            of_src << "      prep(4, list.size() * 16);" << std::endl;
+            of_src << "      prep(8, list.size() * 16);" << std::endl;
+            of_src << "      for (auto it = list.rbegin(); it != list.rend(); ++it) {" << std::endl;
+            of_src << "        push<int64_t>((*it)[1]);" << std::endl;
+            of_src << "        push<int64_t>((*it)[0]);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      push<uint32_t>(static_cast<uint32_t>(list.size()));" << std::endl;
+            of_src << "      return size();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline void startTable() {" << std::endl;
+            of_src << "      fields.clear();" << std::endl;
+            of_src << "      tableStart = size();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    template <typename T> inline void add(const uint16_t& id, const T& val) {" << std::endl;
+            of_src << "      push<T>(val);" << std::endl;
+            of_src << "      fields.emplace_back(id, size());" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline void addOffset(const uint16_t& id, const size_t& target) {" << std::endl;
+            of_src << "      pushOffset(target);" << std::endl;
+            of_src << "      fields.emplace_back(id, size());" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline size_t endTable() {" << std::endl;
+            of_src << "      push<int32_t>(0);" << std::endl;
+            of_src << "      auto table = size();" << std::endl;
+            of_src << "      uint16_t count = 0;" << std::endl;
+            of_src << "      for (auto& f : fields) {" << std::endl;
+            of_src << "        count = std::max<uint16_t>(count, static_cast<uint16_t>(f.first + 1));" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      std::vector<uint16_t> vt(count, 0);" << std::endl;
+            of_src << "      for (auto& f : fields) {" << std::endl;
+            of_src << "        vt.at(f.first) = static_cast<uint16_t>(table - f.second);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      for (auto it = vt.rbegin(); it != vt.rend(); ++it) {" << std::endl;
+            of_src << "        push<uint16_t>(*it);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      push<uint16_t>(static_cast<uint16_t>(table - tableStart));" << std::endl;
+            of_src << "      push<uint16_t>(static_cast<uint16_t>((count + 2) * 2));" << std::endl;
+            of_src << "      auto vtable = size();" << std::endl;
+            of_src << "      int32_t soffset = static_cast<int32_t>(vtable - table);" << std::endl;
+            of_src << "      ::memcpy(buf.data() + buf.size() - table, &soffset, sizeof(soffset));" << std::endl;
+            of_src << "      return table;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline void finish(const size_t& root) {" << std::endl;
+            of_src << "      prep(8, 4);" << std::endl;
+            of_src << "      pushOffset(root);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    inline flatbuffer() : buf(512), head(512), tableStart(0) {}" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  // Arrow's Message.fbs and Schema.fbs" << std::endl;
+            of_src << "  enum : uint8_t { arrow_schema = 1, arrow_record_batch = 3 };" << std::endl;
+            of_src << "  enum : uint8_t { arrow_int = 2, arrow_floating_point = 3, arrow_binary = 4, arrow_utf8 = 5 };" << std::endl;
+            of_src << "  const int16_t arrow_metadata_v5 = 4;" << std::endl;
+            of_src << std::endl;
+            of_src << "  inline std::vector<uint8_t> arrow_message(flatbuffer& fb, const uint8_t& type, const size_t& header, const int64_t& bodyLength) {" << std::endl;
+            of_src << "    fb.startTable();" << std::endl;
+            of_src << "    fb.add<int64_t>(3, bodyLength);" << std::endl;
+            of_src << "    fb.addOffset(2, header);" << std::endl;
+            of_src << "    fb.add<int16_t>(0, arrow_metadata_v5);" << std::endl;
+            of_src << "    fb.add<uint8_t>(1, type);" << std::endl;
+            of_src << "    fb.finish(fb.endTable());" << std::endl;
+            of_src << "    return std::vector<uint8_t>(fb.buf.begin() + static_cast<std::ptrdiff_t>(fb.head), fb.buf.end());" << std::endl;
             of_src << "  }" << std::endl;
             of_src << "} // namespace" << std::endl;
             of_src << std::endl;
-
-            of_src << "  std::string " << module.generateBaseNS << "::error(sqlite3* db){" << std::endl;
-            of_src << "    return ::sqlite3_errmsg(db);" << std::endl;
+            of_src << module.generateBaseNS << "::arrow_writer::arrow_writer(const std::string& path) : fp_(::fopen(path.c_str(), \"wb\")), owned_(true), bodyLength_(0), batches_(0) {" << std::endl;
+            of_src << "  if (fp_ == nullptr) {" << std::endl;
+            of_src << "    " << module.onError << "(path, \"arrow_writer:\" + path, SQLITE_CANTOPEN, ::strerror(errno));" << std::endl;
             of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
             of_src << std::endl;
-
-            of_src << "void " << module.generateBaseNS << "::database::open(const std::string& filename, const int& flags, const char* vfs){" << std::endl;
-            if (module.mutexName.length() > 0) {
-                of_src << "#if " << module.mutexName << std::endl;
-                of_src << "  ::sqlite3_config(SQLITE_CONFIG_SERIALIZED);" << std::endl;
-                of_src << "#else //" << module.mutexName << std::endl;
-                of_src << "  ::sqlite3_config(SQLITE_CONFIG_SINGLETHREAD);" << std::endl;
-                of_src << "#endif //" << module.mutexName << std::endl;
-            }
-            of_src << "  if (val_ != nullptr) {close();}" << std::endl;
-            of_src << "  " << module.onOpen << "(filename, flags);" << std::endl;
-            of_src << "  int rc = ::sqlite3_open_v2(filename.c_str(), &val_, flags, vfs);" << std::endl;
-            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
-            of_src << "    rc=" << module.onError << "(filename, \"open_db:\" + filename, rc, error(val_));" << std::endl;
-            of_src << "    val_ = nullptr;" << std::endl;
+            of_src << module.generateBaseNS << "::arrow_writer::~arrow_writer() {" << std::endl;
+            of_src << "  if (owned_ && (fp_ != nullptr)) {" << std::endl;
+            of_src << "    ::fclose(fp_);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            // a writer whose file could not be opened was reported once, and writes nothing
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::write(const void* data, const size_t& len) {" << std::endl;
+            of_src << "  if (fp_ == nullptr) {" << std::endl;
             of_src << "    return;" << std::endl;
             of_src << "  }" << std::endl;
+            of_src << "  if ((len > 0) && (::fwrite(data, 1, len, fp_) != len)) {" << std::endl;
+            of_src << "    " << module.onError << "(\"\", \"arrow_write\", SQLITE_IOERR, ::strerror(errno));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            // the encapsulated format: a continuation marker, the size of the metadata, the metadata padded to 8 bytes, and the body
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::writeMessage(const std::vector<uint8_t>& meta) {" << std::endl;
+            of_src << "  static const uint8_t zeros[8] = {0};" << std::endl;
+            of_src << "  auto padded = (meta.size() + 7) & ~size_t(7);" << std::endl;
+            of_src << "  uint32_t hdr[2] = {0xFFFFFFFF, static_cast<uint32_t>(padded)};" << std::endl;
+            of_src << "  write(hdr, sizeof(hdr));" << std::endl;
+            of_src << "  write(meta.data(), meta.size());" << std::endl;
+            of_src << "  write(zeros, padded - meta.size());" << std::endl;
+            of_src << "  for (auto& b : body_) {" << std::endl;
+            of_src << "    write(b.first, b.second);" << std::endl;
+            of_src << "    write(zeros, ((b.second + 7) & ~size_t(7)) - b.second);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::begin(const std::vector<arrow_field>& fields) {" << std::endl;
+            of_src << "  fields_ = fields;" << std::endl;
+            of_src << "  flatbuffer fb;" << std::endl;
+            of_src << "  std::vector<size_t> fl;" << std::endl;
+            of_src << "  for (auto& f : fields_) {" << std::endl;
+            of_src << "    size_t type = 0;" << std::endl;
+            of_src << "    uint8_t tt = arrow_binary;" << std::endl;
+            of_src << "    fb.startTable();" << std::endl;
+            of_src << "    switch (f.type) {" << std::endl;
+            of_src << "    case arrow_type::int64:" << std::endl;
+            of_src << "      fb.add<int32_t>(0, 64);" << std::endl;
+            of_src << "      fb.add<uint8_t>(1, 1);" << std::endl;
+            of_src << "      tt = arrow_int;" << std::endl;
+            of_src << "      break;" << std::endl;
+            of_src << "    case arrow_type::float64:" << std::endl;
+            of_src << "      fb.add<int16_t>(0, 2);" << std::endl;
+            of_src << "      tt = arrow_floating_point;" << std::endl;
+            of_src << "      break;" << std::endl;
+            of_src << "    case arrow_type::utf8:" << std::endl;
+            of_src << "      tt = arrow_utf8;" << std::endl;
+            of_src << "      break;" << std::endl;
+            of_src << "    case arrow_type::binary:" << std::endl;
+            of_src << "      break;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    type = fb.endTable();" << std::endl;
+            of_src << "    auto children = fb.offsets({});" << std::endl;
+            of_src << "    auto name = fb.string(f.name);" << std::endl;
+            of_src << "    fb.startTable();" << std::endl;
+            of_src << "    fb.addOffset(0, name);" << std::endl;
+            of_src << "    fb.addOffset(3, type);" << std::endl;
+            of_src << "    fb.addOffset(5, children);" << std::endl;
+            of_src << "    fb.add<uint8_t>(1, 1);" << std::endl;
+            of_src << "    fb.add<uint8_t>(2, tt);" << std::endl;
+            of_src << "    fl.push_back(fb.endTable());" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  auto fv = fb.offsets(fl);" << std::endl;
+            of_src << "  fb.startTable();" << std::endl;
+            of_src << "  fb.addOffset(1, fv);" << std::endl;
+            of_src << "  fb.add<int16_t>(0, 0);" << std::endl;
+            of_src << "  auto schema = fb.endTable();" << std::endl;
+            of_src << "  body_.clear();" << std::endl;
+            of_src << "  writeMessage(arrow_message(fb, arrow_schema, schema, 0));" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::addBuffer(const void* data, const size_t& len) {" << std::endl;
+            of_src << "  buffers_.push_back({bodyLength_, static_cast<int64_t>(len)});" << std::endl;
+            of_src << "  body_.emplace_back(data, len);" << std::endl;
+            of_src << "  bodyLength_ += static_cast<int64_t>((len + 7) & ~size_t(7));" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            // the words of the bitmap are little endian, so their bytes are in Arrow's bit order
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::addValidity(const std::vector<uint64_t>& valid, const size_t& rows) {" << std::endl;
+            of_src << "  int64_t nulls = static_cast<int64_t>(rows);" << std::endl;
+            of_src << "  for (auto& w : valid) {" << std::endl;
+            of_src << "    nulls -= __builtin_popcountll(w);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  nodes_.push_back({static_cast<int64_t>(rows), nulls});" << std::endl;
+            of_src << "  addBuffer(valid.data(), (nulls > 0) ? ((rows + 7) / 8) : 0);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::add(const column<int64_t>& col) {" << std::endl;
+            of_src << "  addValidity(col.valid, col.size());" << std::endl;
+            of_src << "  addBuffer(col.values.data(), col.size() * sizeof(int64_t));" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::add(const column<double>& col) {" << std::endl;
+            of_src << "  addValidity(col.valid, col.size());" << std::endl;
+            of_src << "  addBuffer(col.values.data(), col.size() * sizeof(double));" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::add(const text_column& col) {" << std::endl;
+            of_src << "  static const int32_t zero = 0;" << std::endl;
+            of_src << "  addValidity(col.valid, col.size());" << std::endl;
+            of_src << "  if (col.offsets.size() > 0) {" << std::endl;
+            of_src << "    addBuffer(col.offsets.data(), col.offsets.size() * sizeof(int32_t));" << std::endl;
+            of_src << "  } else {" << std::endl;
+            of_src << "    addBuffer(&zero, sizeof(zero));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  addBuffer(col.arena.data(), col.arena.size());" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            // the columns added since the last batch, in the order of the fields, become one record batch
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::batch(const size_t& rows) {" << std::endl;
+            of_src << "  assert(nodes_.size() == fields_.size());" << std::endl;
+            of_src << "  flatbuffer fb;" << std::endl;
+            of_src << "  auto bv = fb.pairs(buffers_);" << std::endl;
+            of_src << "  auto nv = fb.pairs(nodes_);" << std::endl;
+            of_src << "  fb.startTable();" << std::endl;
+            of_src << "  fb.add<int64_t>(0, static_cast<int64_t>(rows));" << std::endl;
+            of_src << "  fb.addOffset(1, nv);" << std::endl;
+            of_src << "  fb.addOffset(2, bv);" << std::endl;
+            of_src << "  auto rb = fb.endTable();" << std::endl;
+            of_src << "  writeMessage(arrow_message(fb, arrow_record_batch, rb, bodyLength_));" << std::endl;
+            of_src << "  ++batches_;" << std::endl;
+            of_src << "  nodes_.clear();" << std::endl;
+            of_src << "  buffers_.clear();" << std::endl;
+            of_src << "  body_.clear();" << std::endl;
+            of_src << "  bodyLength_ = 0;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "void " << module.generateBaseNS << "::arrow_writer::end() {" << std::endl;
+            of_src << "  uint32_t eos[2] = {0xFFFFFFFF, 0};" << std::endl;
+            of_src << "  write(eos, sizeof(eos));" << std::endl;
+            of_src << "  if ((fp_ != nullptr) && (::fflush(fp_) != 0)) {" << std::endl;
+            of_src << "    " << module.onError << "(\"\", \"arrow_write\", SQLITE_IOERR, ::strerror(errno));" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+            of_src << "#if defined(__SSE2__)" << std::endl;
+            of_src << "#include <emmintrin.h>" << std::endl;
+            of_src << "#endif" << std::endl;
+            of_src << "#include <charconv>" << std::endl;
+            of_src << "#include <deque>" << std::endl;
+            of_src << "#include <fcntl.h>" << std::endl;
+            of_src << "#include <sys/mman.h>" << std::endl;
+            of_src << "#include <sys/stat.h>" << std::endl;
+            of_src << "#include <strings.h>" << std::endl;
+            of_src << "#include <unistd.h>" << std::endl;
+            of_src << std::endl;
+            of_src << "namespace {" << std::endl;
+            of_src << "  // returns the first delimiter, quote or line end at or after p, 16 bytes at a time where SSE2 is available" << std::endl;
+            of_src << "  inline const char* csv_scan(const char* p, const char* end, const char delim) {" << std::endl;
+            of_src << "#if defined(__SSE2__)" << std::endl;
+            of_src << "    const auto d = _mm_set1_epi8(delim);" << std::endl;
+            of_src << "    const auto q = _mm_set1_epi8('\"');" << std::endl;
+            of_src << "    const auto n = _mm_set1_epi8('\\n');" << std::endl;
+            of_src << "    const auto r = _mm_set1_epi8('\\r');" << std::endl;
+            of_src << "    while ((end - p) >= 16) {" << std::endl;
+            of_src << "      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));" << std::endl;
+            of_src << "      auto m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, d), _mm_cmpeq_epi8(v, q)), _mm_or_si128(_mm_cmpeq_epi8(v, n), _mm_cmpeq_epi8(v, r)));" << std::endl;
+            of_src << "      auto bits = _mm_movemask_epi8(m);" << std::endl;
+            of_src << "      if (bits != 0) {" << std::endl;
+            of_src << "        return p + __builtin_ctz(static_cast<unsigned>(bits));" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      p += 16;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "#endif" << std::endl;
+            of_src << "    while ((p < end) && (*p != delim) && (*p != '\"') && (*p != '\\n') && (*p != '\\r')) {" << std::endl;
+            of_src << "      ++p;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return p;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // splits RFC 4180 records. Fields point into the input, except quoted fields with" << std::endl;
+            of_src << "  // doubled quotes, which are unescaped into esc (a deque, so that they do not move)" << std::endl;
+            of_src << "  struct csv_reader {" << std::endl;
+            of_src << "    const char* p;" << std::endl;
+            of_src << "    const char* end;" << std::endl;
+            of_src << "    char delim;" << std::endl;
+            of_src << "    size_t record;" << std::endl;
+            of_src << "    std::vector<std::string_view> fields;" << std::endl;
+            of_src << "    std::deque<std::string> esc;" << std::endl;
+            of_src << std::endl;
+            of_src << "    inline void quoted() {" << std::endl;
+            of_src << "      auto start = ++p;" << std::endl;
+            of_src << "      bool escaped = false;" << std::endl;
+            of_src << "      const char* q = end;" << std::endl;
+            of_src << "      while (p < end) {" << std::endl;
+            of_src << "        q = static_cast<const char*>(::memchr(p, '\"', static_cast<size_t>(end - p)));" << std::endl;
+            of_src << "        if (q == nullptr) {" << std::endl;
+            of_src << "          q = end;" << std::endl;
+            of_src << "          break;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        if (((q + 1) < end) && (q[1] == '\"')) {" << std::endl;
+            of_src << "          escaped = true;" << std::endl;
+            of_src << "          p = q + 2;" << std::endl;
+            of_src << "          continue;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        break;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if (!escaped) {" << std::endl;
+            of_src << "        fields.emplace_back(start, static_cast<size_t>(q - start));" << std::endl;
+            of_src << "      } else {" << std::endl;
+            of_src << "        if (esc.size() <= fields.size()) {" << std::endl;
+            of_src << "          esc.resize(fields.size() + 1);" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        auto& s = esc[fields.size()];" << std::endl;
+            of_src << "        s.clear();" << std::endl;
+            of_src << "        for (auto c = start; c < q; ++c) {" << std::endl;
+            of_src << "          s.push_back(*c);" << std::endl;
+            of_src << "          if (*c == '\"') {" << std::endl;
+            of_src << "            ++c;" << std::endl;
+            of_src << "          }" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        fields.emplace_back(s);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      p = (q < end) ? csv_scan(q + 1, end, delim) : end;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << std::endl;
+            of_src << "    inline bool next() {" << std::endl;
+            of_src << "      fields.clear();" << std::endl;
+            of_src << "      while ((p < end) && ((*p == '\\n') || (*p == '\\r'))) {" << std::endl;
+            of_src << "        ++p;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if (p >= end) {" << std::endl;
+            of_src << "        return false;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      ++record;" << std::endl;
+            of_src << "      for (;;) {" << std::endl;
+            of_src << "        if ((p < end) && (*p == '\"')) {" << std::endl;
+            of_src << "          quoted();" << std::endl;
+            of_src << "        } else {" << std::endl;
+            of_src << "          auto q = csv_scan(p, end, delim);" << std::endl;
+            of_src << "          // a quote inside an unquoted field is taken as it is" << std::endl;
+            of_src << "          while ((q < end) && (*q == '\"')) {" << std::endl;
+            of_src << "            q = csv_scan(q + 1, end, delim);" << std::endl;
+            of_src << "          }" << std::endl;
+            of_src << "          fields.emplace_back(p, static_cast<size_t>(q - p));" << std::endl;
+            of_src << "          p = q;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        if (p >= end) {" << std::endl;
+            of_src << "          return true;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        if (*p == delim) {" << std::endl;
+            of_src << "          ++p;" << std::endl;
+            of_src << "          continue;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        if (*p == '\\r') {" << std::endl;
+            of_src << "          ++p;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        if ((p < end) && (*p == '\\n')) {" << std::endl;
+            of_src << "          ++p;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        return true;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << std::endl;
+            of_src << "    inline csv_reader(const char* data, const size_t& size, const char& d) : p(data), end(data + size), delim(d), record(0) {}" << std::endl;
+            of_src << "  };" << std::endl;
+            of_src << std::endl;
+            of_src << "  inline int hex_value(const char& c) {" << std::endl;
+            of_src << "    if ((c >= '0') && (c <= '9')) {" << std::endl;
+            of_src << "      return c - '0';" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if ((c >= 'a') && (c <= 'f')) {" << std::endl;
+            of_src << "      return c - 'a' + 10;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if ((c >= 'A') && (c <= 'F')) {" << std::endl;
+            of_src << "      return c - 'A' + 10;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    return -1;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  // binds a field as its column's storage class, the values stay in the file (or in blob) until the row is inserted." << std::endl;
+            of_src << "  // An empty field is NULL, except in a TEXT column, and blobs are written as hex" << std::endl;
+            of_src << "  inline bool bind_field(sqlite3_stmt* st, const int& idx, const std::string_view& f, const int& type, std::vector<uint8_t>& blob) {" << std::endl;
+            of_src << "    if (f.empty() && (type != SQLITE_TEXT)) {" << std::endl;
+            of_src << "      return (::sqlite3_bind_null(st, idx) == SQLITE_OK);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    switch (type) {" << std::endl;
+            of_src << "    case SQLITE_INTEGER: {" << std::endl;
+            of_src << "      int64_t v = 0;" << std::endl;
+            of_src << "      auto rv = std::from_chars(f.data(), f.data() + f.size(), v);" << std::endl;
+            of_src << "      if ((rv.ec != std::errc()) || (rv.ptr != (f.data() + f.size()))) {" << std::endl;
+            of_src << "        return false;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      return (::sqlite3_bind_int64(st, idx, v) == SQLITE_OK);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    case SQLITE_FLOAT: {" << std::endl;
+            of_src << "      double v = 0;" << std::endl;
+            of_src << "      auto rv = std::from_chars(f.data(), f.data() + f.size(), v);" << std::endl;
+            of_src << "      if ((rv.ec != std::errc()) || (rv.ptr != (f.data() + f.size()))) {" << std::endl;
+            of_src << "        return false;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      return (::sqlite3_bind_double(st, idx, v) == SQLITE_OK);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    case SQLITE_TEXT:" << std::endl;
+            of_src << "      return (::sqlite3_bind_text(st, idx, f.data(), static_cast<int>(f.size()), SQLITE_STATIC) == SQLITE_OK);" << std::endl;
+            of_src << "    default:" << std::endl;
+            of_src << "      if ((f.size() % 2) != 0) {" << std::endl;
+            of_src << "        return false;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      blob.resize(f.size() / 2);" << std::endl;
+            of_src << "      for (size_t i = 0; i < blob.size(); ++i) {" << std::endl;
+            of_src << "        auto hi = hex_value(f[2 * i]);" << std::endl;
+            of_src << "        auto lo = hex_value(f[(2 * i) + 1]);" << std::endl;
+            of_src << "        if ((hi < 0) || (lo < 0)) {" << std::endl;
+            of_src << "          return false;" << std::endl;
+            of_src << "        }" << std::endl;
+            of_src << "        blob[i] = static_cast<uint8_t>((hi << 4) | lo);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      return (::sqlite3_bind_blob(st, idx, blob.data(), static_cast<int>(blob.size()), SQLITE_STATIC) == SQLITE_OK);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "} // namespace" << std::endl;
+            of_src << std::endl;
+            of_src << "size_t " << module.generateBaseNS << "::importCsv(database& db, const std::string& path, const std::string& table, const std::vector<import_column>& cols, const import_config& cfg) {" << std::endl;
+            of_src << "  int fd = ::open(path.c_str(), O_RDONLY);" << std::endl;
+            of_src << "  if (fd < 0) {" << std::endl;
+            of_src << "    " << module.onError << "(path, \"import:\" + path, SQLITE_CANTOPEN, ::strerror(errno));" << std::endl;
+            of_src << "    return 0;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  struct stat sb;" << std::endl;
+            of_src << "  size_t size = (::fstat(fd, &sb) == 0) ? static_cast<size_t>(sb.st_size) : 0;" << std::endl;
+            of_src << "  void* map = nullptr;" << std::endl;
+            of_src << "  if (size > 0) {" << std::endl;
+            of_src << "    map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);" << std::endl;
+            of_src << "    if (map == MAP_FAILED) {" << std::endl;
+            of_src << "      ::close(fd);" << std::endl;
+            of_src << "      " << module.onError << "(path, \"import:\" + path, SQLITE_IOERR, ::strerror(errno));" << std::endl;
+            of_src << "      return 0;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    ::madvise(map, size, MADV_SEQUENTIAL);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  ::close(fd);" << std::endl;
+            of_src << "  struct unmap {" << std::endl;
+            of_src << "    void* p;" << std::endl;
+            of_src << "    size_t n;" << std::endl;
+            of_src << "    inline ~unmap() {" << std::endl;
+            of_src << "      if (p != nullptr) {" << std::endl;
+            of_src << "        ::munmap(p, n);" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  } um{map, size};" << std::endl;
+            of_src << std::endl;
+            of_src << "  csv_reader rd(static_cast<const char*>(map), size, cfg.delimiter);" << std::endl;
+            of_src << "  std::vector<size_t> order;" << std::endl;
+            of_src << "  if (cfg.header) {" << std::endl;
+            of_src << "    if (!rd.next()) {" << std::endl;
+            of_src << "      return 0;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    for (auto& f : rd.fields) {" << std::endl;
+            of_src << "      size_t i = 0;" << std::endl;
+            of_src << "      while ((i < cols.size()) && ((::strlen(cols[i].name) != f.size()) || (::strncasecmp(cols[i].name, f.data(), f.size()) != 0))) {" << std::endl;
+            of_src << "        ++i;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      if (i == cols.size()) {" << std::endl;
+            of_src << "        " << module.onError << "(db.filename_, \"import:\" + path, SQLITE_ERROR, \"no column \" + std::string(f) + \" in \" + table);" << std::endl;
+            of_src << "        return 0;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "      order.push_back(i);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  } else {" << std::endl;
+            of_src << "    for (size_t i = 0; i < cols.size(); ++i) {" << std::endl;
+            of_src << "      order.push_back(i);" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  std::string sql = \"INSERT INTO \" + table + \"(\";" << std::endl;
+            of_src << "  std::string sep;" << std::endl;
+            of_src << "  for (auto& i : order) {" << std::endl;
+            of_src << "    sql += sep + cols[i].name;" << std::endl;
+            of_src << "    sep = \", \";" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  sql += \") VALUES(\";" << std::endl;
+            of_src << "  sep = \"\";" << std::endl;
+            of_src << "  for (size_t i = 0; i < order.size(); ++i) {" << std::endl;
+            of_src << "    sql += sep + \"?\";" << std::endl;
+            of_src << "    sep = \", \";" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  sql += \")\";" << std::endl;
+            of_src << std::endl;
+            of_src << "  connection_lock lk(db);" << std::endl;
+            of_src << "  // rolls back the open batch when the load stops on an error, or a handler throws" << std::endl;
+            of_src << "  struct rollback_guard {" << std::endl;
+            of_src << "    database& db;" << std::endl;
+            of_src << "    inline ~rollback_guard() {" << std::endl;
+            of_src << "      if (!::sqlite3_get_autocommit(db.val_)) {" << std::endl;
+            of_src << "        db.exec(\"ROLLBACK\");" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  } rg{db};" << std::endl;
+            of_src << "  db.beginImmediate();" << std::endl;
+            of_src << std::endl;
+            of_src << "  // indexes other than those of the PRIMARY KEY and UNIQUE constraints are dropped, and built once after the load." << std::endl;
+            of_src << "  // The drops, the load and the rebuild are then one transaction, so a failure leaves every index in place" << std::endl;
+            of_src << "  std::vector<std::string> indexes;" << std::endl;
+            of_src << "  if (cfg.deferIndexes) {" << std::endl;
+            of_src << "    exstatement ix(db);" << std::endl;
+            of_src << "    ix.open(\"SELECT name, sql FROM sqlite_master WHERE type = 'index' AND tbl_name = '\" + table + \"' AND sql IS NOT NULL\");" << std::endl;
+            of_src << "    std::vector<std::string> names;" << std::endl;
+            of_src << "    while (ix.next()) {" << std::endl;
+            of_src << "      names.push_back(ix.getColumnText(0));" << std::endl;
+            of_src << "      indexes.push_back(ix.getColumnText(1));" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    ix.close();" << std::endl;
+            of_src << "    for (auto& n : names) {" << std::endl;
+            of_src << "      db.exec(\"DROP INDEX \\\"\" + n + \"\\\"\");" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << std::endl;
+            of_src << "  exstatement ins(db);" << std::endl;
+            of_src << "  ins.open(sql, (\"import\" + table).c_str());" << std::endl;
+            of_src << "  std::vector<std::vector<uint8_t>> blobs(order.size());" << std::endl;
+            of_src << "  size_t rows = 0;" << std::endl;
+            of_src << "  size_t pending = 0;" << std::endl;
+            of_src << "  const size_t batchRows = cfg.deferIndexes ? 0 : cfg.batchRows;" << std::endl;
+            of_src << "  bool failed = false;" << std::endl;
+            of_src << "  while (rd.next()) {" << std::endl;
+            of_src << "    if (rd.fields.size() != order.size()) {" << std::endl;
+            of_src << "      " << module.onError << "(db.filename_, \"import:\" + path, SQLITE_ERROR, \"record \" + std::to_string(rd.record) + \" has \" + std::to_string(rd.fields.size()) + \" fields, expected \" + std::to_string(order.size()));" << std::endl;
+            of_src << "      failed = true;" << std::endl;
+            of_src << "      break;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    for (size_t i = 0; i < order.size(); ++i) {" << std::endl;
+            of_src << "      if (!bind_field(ins.val_, static_cast<int>(i + 1), rd.fields[i], cols[order[i]].type, blobs[i])) {" << std::endl;
+            of_src << "        " << module.onError << "(db.filename_, \"import:\" + path, SQLITE_MISMATCH, \"record \" + std::to_string(rd.record) + \", column \" + cols[order[i]].name + \":\" + std::string(rd.fields[i]));" << std::endl;
+            of_src << "        failed = true;" << std::endl;
+            of_src << "        break;" << std::endl;
+            of_src << "      }" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    if (failed) {" << std::endl;
+            of_src << "      break;" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "    ins.next();" << std::endl;
+            of_src << "    ins.reset();" << std::endl;
+            of_src << "    if (++pending == batchRows) {" << std::endl;
+            of_src << "      db.commit();" << std::endl;
+            of_src << "      rows += pending;" << std::endl;
+            of_src << "      pending = 0;" << std::endl;
+            of_src << "      db.beginImmediate();" << std::endl;
+            of_src << "    }" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  // the bound values point into the file, which is about to be unmapped" << std::endl;
+            of_src << "  ::sqlite3_clear_bindings(ins.val_);" << std::endl;
+            of_src << "  if (failed) {" << std::endl;
+            // the guard rolls back the batch that failed, and with it any dropped index
+            of_src << "    return rows;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  for (auto& ix : indexes) {" << std::endl;
+            of_src << "    db.exec(ix);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  db.commit();" << std::endl;
+            of_src << "  return rows + pending;" << std::endl;
+            of_src << "}" << std::endl;
 
-            if(module.onTrace != "") {
-                of_src << "  sqlite3_trace(val_, &on_Trace, NULL);" << std::endl;
-            }
-
-            of_src << "  beginTx_.open(\"BEGIN EXCLUSIVE\");" << std::endl;
-            of_src << "  commitTx_.open(\"COMMIT\");" << std::endl;
+            of_src << std::endl;
+            // without SQLITE_ENABLE_SNAPSHOT (or outside WAL mode) each pinned reader
+            // only gets its own read transaction, consistent within that reader
+            of_src << module.generateBaseNS << "::snapshot::snapshot(readers& rs) : rs_(rs), holder_(nullptr), val_(nullptr) {" << std::endl;
+            of_src << "#if defined(SQLITE_ENABLE_SNAPSHOT)" << std::endl;
+            of_src << "  holder_ = rs_.get();" << std::endl;
+            of_src << "  holder_->exec(\"BEGIN\");" << std::endl;
+            of_src << "  holder_->exec(\"SELECT 1 FROM sqlite_master LIMIT 1\");" << std::endl;
+            of_src << "  if (::sqlite3_snapshot_get(holder_->val_, \"main\", &val_) != SQLITE_OK) {" << std::endl;
+            of_src << "    val_ = nullptr;" << std::endl;
+            of_src << "    holder_->exec(\"COMMIT\");" << std::endl;
+            of_src << "    rs_.release(holder_);" << std::endl;
+            of_src << "    holder_ = nullptr;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "#endif" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
 
-            of_src << "  ::sqlite3_busy_timeout(val_, 5000);" << std::endl;
-            of_src << "  filename_ = filename;" << std::endl;
-            of_src << "  " << module.onOpened << "(*this);" << std::endl;
+            of_src << module.generateBaseNS << "::snapshot::~snapshot(){" << std::endl;
+            of_src << "#if defined(SQLITE_ENABLE_SNAPSHOT)" << std::endl;
+            of_src << "  if (val_ != nullptr) {" << std::endl;
+            of_src << "    ::sqlite3_snapshot_free(val_);" << std::endl;
+            of_src << "    holder_->exec(\"COMMIT\");" << std::endl;
+            of_src << "    rs_.release(holder_);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "#endif" << std::endl;
             of_src << "}" << std::endl;
             of_src << std::endl;
 
-            of_src << "void " << module.generateBaseNS << "::database::close(){" << std::endl;
-            of_src << "  if (val_) {" << std::endl;
-            of_src << "    beginTx_.close();" << std::endl;
-            of_src << "    commitTx_.close();" << std::endl;
-            of_src << "    int rc = SQLITE_BUSY;" << std::endl;
-            of_src << "    for (int i = 0; ((i < 10) && (rc == SQLITE_BUSY)); ++i) {" << std::endl;
-            of_src << "      rc = ::sqlite3_close(val_);" << std::endl;
-            of_src << "    }" << std::endl;
-            of_src << "    if (rc > 0) {" << std::endl;
-            of_src << "      " << module.onError << "(filename_, \"close_db\", rc, error(val_));" << std::endl;
+            of_src << "void " << module.generateBaseNS << "::snapshot::pin(database& conn){" << std::endl;
+            of_src << "  conn.exec(\"BEGIN\");" << std::endl;
+            of_src << "#if defined(SQLITE_ENABLE_SNAPSHOT)" << std::endl;
+            of_src << "  if (val_ != nullptr) {" << std::endl;
+            of_src << "    int rc = ::sqlite3_snapshot_open(conn.val_, \"main\", val_);" << std::endl;
+            // the connection goes back to its pool, so it must not be left in the transaction
+            of_src << "    if (rc != SQLITE_OK) {" << std::endl;
+            of_src << "      auto msg = error(conn.val_);" << std::endl;
+            of_src << "      conn.exec(\"ROLLBACK\");" << std::endl;
+            of_src << "      " << module.onError << "(conn.filename_, \"snapshot_open\", rc, msg);" << std::endl;
             of_src << "    }" << std::endl;
             of_src << "  }" << std::endl;
-            of_src << "  val_ = nullptr;" << std::endl;
-            of_src << "  filename_ = \"\";" << std::endl;
+            of_src << "#endif" << std::endl;
             of_src << "}" << std::endl;
             of_src << std::endl;
 
-            of_src << "void " << module.generateBaseNS << "::database::exec(const std::string& sqls){" << std::endl;
-            of_src << "  char* err = nullptr;" << std::endl;
-            of_src << "  int rc = sqlite3_exec(val_, sqls.c_str(), nullptr, nullptr, &err);" << std::endl;
-            of_src << "  if (rc != SQLITE_OK) {" << std::endl;
-            of_src << "    std::string msg(err);" << std::endl;
-            of_src << "    sqlite3_free(err);" << std::endl;
-            of_src << "    " << module.onError << "(filename_, \"exec[\" + sqls + \"]\", rc, msg);" << std::endl;
+            of_src << "void " << module.generateBaseNS << "::snapshot::unpin(database& conn){" << std::endl;
+            of_src << "  if (!::sqlite3_get_autocommit(conn.val_)) {" << std::endl;
+            of_src << "    conn.exec(\"COMMIT\");" << std::endl;
             of_src << "  }" << std::endl;
             of_src << "}" << std::endl;
             of_src << std::endl;
 
-            of_src << "void " << module.generateBaseNS << "::statement::open(const std::string& sql){" << std::endl;
+            of_src << "void " << module.generateBaseNS << "::statement::open(const std::string& sql, const char* name){" << std::endl;
+            of_src << "  io_ = ((name != nullptr) && io_enabled) ? ioCounters(name) : nullptr;" << std::endl;
             of_src << "  if(db_.val_ == nullptr){" << std::endl;
             of_src << "    " << module.onError << "(db_.filename_, \"prepare\", SQLITE_MISUSE, \"[\" + sql + \"]:database not open\");" << std::endl;
             of_src << "    return;" << std::endl;
@@ -1746,10 +7302,12 @@ namespace {
             of_src << std::endl;
 
             of_src << "bool " << module.generateBaseNS << "::statement::next(){" << std::endl;
+            of_src << "  io_scope ios(io_);" << std::endl;
             of_src << "  int rc = ::sqlite3_step(val_);" << std::endl;
             of_src << "  if ((rc > 0) && (rc < 100)) {" << std::endl;
             of_src << "    rc=" << module.onError << "(db_.filename_, \"next\", rc, error(db_.val_));" << std::endl;
             of_src << "  }" << std::endl;
+            of_src << "  db_.afterStep();" << std::endl;
             of_src << "  return (rc == SQLITE_ROW);" << std::endl;
             of_src << "}" << std::endl;
             of_src << std::endl;
@@ -1767,6 +7325,26 @@ namespace {
                 of_src << std::endl;
             }
 
+            of_src << "size_t " << module.generateBaseNS << "::statement::update(){" << std::endl;
+            of_src << "  next();" << std::endl;
+            of_src << "  return static_cast<size_t>(::sqlite3_changes(db_.val_));" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            // an upsert that updates leaves the last insert rowid alone, so it is set to a
+            // sentinel first; the connection mutex keeps other threads from moving it meanwhile
+            of_src << module.generateBaseNS << "::upsert_result " << module.generateBaseNS << "::statement::upsert(){" << std::endl;
+            of_src << "  connection_lock lk(db_);" << std::endl;
+            of_src << "  ::sqlite3_set_last_insert_rowid(db_.val_, INT64_MIN);" << std::endl;
+            of_src << "  next();" << std::endl;
+            of_src << "  auto rv = upsert_result::none;" << std::endl;
+            of_src << "  if(::sqlite3_changes(db_.val_) > 0){" << std::endl;
+            of_src << "    rv = (::sqlite3_last_insert_rowid(db_.val_) != INT64_MIN) ? upsert_result::inserted : upsert_result::updated;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  return rv;" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
             of_src << "void " << module.generateBaseNS << "::statement::xdelete(){" << std::endl;
             of_src << "  next();" << std::endl;
             of_src << "}" << std::endl;
@@ -1832,6 +7410,80 @@ namespace {
             of_src << "  }" << std::endl;
             of_src << "  return std::string(val, static_cast<size_t>(len));" << std::endl;
             of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::statement::setParamBlob(const std::string& key, const void* val, const size_t& len){" << std::endl;
+            of_src << "  int idx = getParamIndex(*this, key);" << std::endl;
+            of_src << "#pragma clang diagnostic push" << std::endl;
+            of_src << "#pragma clang diagnostic ignored \"-Wold-style-cast\"" << std::endl;
+            // an empty vector may have no data, which sqlite3_bind_blob64() would bind as NULL
+            of_src << "  if (val == nullptr) {" << std::endl;
+            of_src << "    ::sqlite3_bind_zeroblob(val_, idx, 0);" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  ::sqlite3_bind_blob64(val_, idx, val, static_cast<sqlite3_uint64>(len), SQLITE_TRANSIENT);" << std::endl;
+            of_src << "#pragma clang diagnostic pop" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            // these assign into val, reusing its capacity
+            of_src << "void " << module.generateBaseNS << "::statement::getColumn(const int& idx, std::string& val){" << std::endl;
+            of_src << "  auto txt = reinterpret_cast<const char*>(::sqlite3_column_text(val_, idx));" << std::endl;
+            of_src << "  int len = ::sqlite3_column_bytes(val_, idx);" << std::endl;
+            of_src << "  if (txt == nullptr) {" << std::endl;
+            of_src << "    val.clear();" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  val.assign(txt, static_cast<size_t>(len));" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::statement::getColumn(const int& idx, std::vector<uint8_t>& val){" << std::endl;
+            of_src << "  auto blob = static_cast<const uint8_t*>(::sqlite3_column_blob(val_, idx));" << std::endl;
+            of_src << "  int len = ::sqlite3_column_bytes(val_, idx);" << std::endl;
+            of_src << "  if (blob == nullptr) {" << std::endl;
+            of_src << "    val.clear();" << std::endl;
+            of_src << "    return;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  val.assign(blob, blob + len);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            // these append to the arena of a columnar result, a NULL is appended as an empty value
+            of_src << "void " << module.generateBaseNS << "::statement::appendText(const int& idx, text_column& col){" << std::endl;
+            of_src << "  auto txt = ::sqlite3_column_text(val_, idx);" << std::endl;
+            of_src << "  col.push(txt, static_cast<size_t>(::sqlite3_column_bytes(val_, idx)), (txt == nullptr));" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            of_src << "void " << module.generateBaseNS << "::statement::appendBlob(const int& idx, text_column& col){" << std::endl;
+            of_src << "  auto blob = ::sqlite3_column_blob(val_, idx);" << std::endl;
+            of_src << "  col.push(blob, static_cast<size_t>(::sqlite3_column_bytes(val_, idx)), (::sqlite3_column_type(val_, idx) == SQLITE_NULL));" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            // a NULL or empty blob has no data, and is returned as empty
+            of_src << "std::vector<uint8_t> " << module.generateBaseNS << "::statement::getColumnBlob(const int& idx){" << std::endl;
+            of_src << "  auto val = static_cast<const uint8_t*>(::sqlite3_column_blob(val_, idx));" << std::endl;
+            of_src << "  int len = ::sqlite3_column_bytes(val_, idx);" << std::endl;
+            of_src << "  if (val == nullptr) {" << std::endl;
+            of_src << "    return std::vector<uint8_t>();" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  return std::vector<uint8_t>(val, val + len);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
+
+            // copies at most len bytes into val, zero fills the rest, and returns the size of the blob
+            of_src << "size_t " << module.generateBaseNS << "::statement::getColumnBlob(const int& idx, void* val, const size_t& len){" << std::endl;
+            of_src << "  auto src = ::sqlite3_column_blob(val_, idx);" << std::endl;
+            of_src << "  auto n = static_cast<size_t>(::sqlite3_column_bytes(val_, idx));" << std::endl;
+            of_src << "  auto cn = (src == nullptr) ? 0 : std::min(n, len);" << std::endl;
+            of_src << "  if (cn > 0) {" << std::endl;
+            of_src << "    ::memcpy(val, src, cn);" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  ::memset(static_cast<uint8_t*>(val) + cn, 0, len - cn);" << std::endl;
+            of_src << "  return n;" << std::endl;
+            of_src << "}" << std::endl;
         }
         of_src << std::endl;
 
@@ -1846,6 +7498,41 @@ namespace {
             of_src << "  return \"<UNKNOWN-ENUM:" << e.name << ">:\" + std::to_string(static_cast<int>(val));" << std::endl;
             of_src << "}" << std::endl;
             of_src << std::endl;
+
+            // perfect hash of the names into a table, one compare per lookup
+            uint32_t seed = 0;
+            auto tsize = getEnumTable(e.valueList, seed);
+            std::vector<int> slots(tsize, -1);
+            for(size_t i = 0; i < e.valueList.size(); ++i) {
+                slots.at(enumHash(seed, e.valueList.at(i)) & (tsize - 1)) = static_cast<int>(i);
+            }
+            of_src << "template <> " << ns << e.name << " " << ns << "from_string<" << ns << e.name << ">(const std::string& str){" << std::endl;
+            of_src << "  static const char* const names[] = {";
+            std::string sep;
+            for(auto& i : slots) {
+                of_src << sep << ((i < 0) ? "nullptr" : ("\"" + e.valueList.at(static_cast<size_t>(i)) + "\""));
+                sep = ", ";
+            }
+            of_src << "};" << std::endl;
+            of_src << "  static const int vals[] = {";
+            sep = "";
+            for(auto& i : slots) {
+                of_src << sep << i;
+                sep = ", ";
+            }
+            of_src << "};" << std::endl;
+            of_src << "  uint32_t h = " << (2166136261u ^ seed) << "u;" << std::endl;
+            of_src << "  for(auto& c : str){" << std::endl;
+            of_src << "    h = (h ^ static_cast<uint8_t>(c)) * 16777619u;" << std::endl;
+            of_src << "  }" << std::endl;
+            of_src << "  auto i = h & " << (tsize - 1) << "u;" << std::endl;
+            of_src << "  if((names[i] != nullptr) && (str == names[i])){" << std::endl;
+            of_src << "    return static_cast<" << ns << e.name << ">(vals[i]);" << std::endl;
+            of_src << "  }" << std::endl;
+            // there is no connection to report to, and no value to return
+            of_src << "  throw std::invalid_argument(\"unknown " << e.name << ":\" + str);" << std::endl;
+            of_src << "}" << std::endl;
+            of_src << std::endl;
         }
 
 
@@ -3,22 +3,116 @@ NAMESPACE 'model';
 SQLCH 'mysqlch';
 **/
 
+---ENUM Status (Active Suspended Closed) INTEGER;
+---ENUM Role (Member Admin);
+
 ---DEFINE DATABASE Auth;
 
 ---VTYPE id 'uint32_t';
+---VTYPE status 'Status';
+---VTYPE role 'Role';
+---CDC 1024;
 CREATE TABLE UserMaster(
         id INTEGER PRIMARY KEY
     ,uname VARCHAR
-);
+    ,status INTEGER NOT NULL DEFAULT 0
+    ,role VARCHAR NOT NULL DEFAULT 'Member' CHECK(length(role) > 0)
+) /* the CHECK(... IN (...)) of each ENUM column goes before this comment */;
 
 CREATE INDEX UserName_Index On UserMaster(uname);
 
+---VTYPE token 'std::array<uint8_t, 16>';
+---VTYPE issued 'std::chrono::time_point<std::chrono::system_clock, std::chrono::milliseconds>';
+---VTYPE ttl 'std::chrono::seconds';
+CREATE TABLE UserToken(
+        token BLOB PRIMARY KEY
+    ,uid INTEGER REFERENCES UserMaster(id)
+    ,expiry REAL
+    ,data BLOB
+    ,issued INTEGER
+    ,ttl INTEGER
+);
+
+CREATE INDEX UserToken_Issued On UserToken(issued);
+
 ---END DATABASE;
 
 ---DEFINE INTERFACE UserRW ON UserMaster;
 INSERT INTO UserMaster(uname) VALUES(:uname);
+
+---QNAME upsertUser;
+INSERT INTO UserMaster(id, uname) VALUES(:id, :uname) ON CONFLICT(id) DO UPDATE SET uname = excluded.uname;
+
+---QNAME upsertUserReturning;
+INSERT INTO UserMaster(id, uname) VALUES(:id, :uname) ON CONFLICT(id) DO UPDATE SET uname = excluded.uname RETURNING *;
+
+---QNAME insertUserIfAbsent;
+INSERT INTO UserMaster(id, uname) VALUES(:id, :uname) ON CONFLICT(id) DO NOTHING;
+
+---QNAME setUserStatus;
+UPDATE UserMaster SET status = :status, role = :role WHERE id = :id;
 ---END INTERFACE;
 
 ---DEFINE INTERFACE UserRO ON UserMaster;
+---PAGINATE BY id;
+---PARALLEL;
 SELECT * FROM UserMaster ORDER BY id;
+
+---PARALLEL;
+---QNAME selectUsersByName;
+SELECT * FROM UserMaster ORDER BY uname DESC, id;
+
+---CACHE 16;
+---QNAME selectUserByName;
+SELECT * FROM UserMaster WHERE uname = :uname;
+
+SELECT * FROM UserMaster WHERE id = :id;
+
+---COLUMNAR;
+---ARROW;
+---QNAME selectUserTable;
+SELECT id, uname, status FROM UserMaster WHERE id <= :id ORDER BY id;
+
+---QNAME selectUsersByStatus;
+SELECT * FROM UserMaster WHERE status = :status ORDER BY id;
+
+---QNAME selectUsersByIds;
+SELECT * FROM UserMaster WHERE id IN sqlch_array( :ids ) ORDER BY id;
+
+---QNAME countUsers;
+SELECT COUNT(*) FROM UserMaster;
+
+---QNAME selectUserPair;
+SELECT * FROM UserMaster WHERE id IN (:id, :id + 1);
+
+---VTYPE running 'int64_t';
+---QNAME countUsersRunning;
+SELECT COUNT(*) OVER (ORDER BY id) AS running FROM UserMaster;
+
+---EXISTS;
+---QNAME hasUser;
+SELECT 1 FROM UserMaster WHERE uname = :uname;
+---END INTERFACE;
+
+---DEFINE PROCEDURE ProvisionUser ON UserMaster;
+---CALL UserRW.upsertUser;
+---CALL UserRW.setUserStatus;
+---QNAME selectProvisioned;
+SELECT * FROM UserMaster WHERE id = :id;
+---END PROCEDURE;
+
+---DEFINE INTERFACE TokenRW ON UserToken;
+INSERT INTO UserToken(token, uid, expiry, data, issued, ttl) VALUES(:token, :uid, :expiry, :data, :issued, :ttl);
+
+---VTYPE since 'std::chrono::time_point<std::chrono::system_clock, std::chrono::milliseconds>';
+---VTYPE until 'std::chrono::time_point<std::chrono::system_clock, std::chrono::milliseconds>';
+---QNAME selectTokensIssued;
+SELECT * FROM UserToken WHERE issued >= :since AND issued < :until ORDER BY issued;
+
+SELECT * FROM UserToken WHERE token = :token;
+
+---COLUMNAR;
+---ARROW;
+---QNAME selectTokenTable;
+SELECT * FROM UserToken ORDER BY uid;
 ---END INTERFACE;
@@ -1,5 +1,9 @@
 #include <iostream>
 #include <assert.h>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "test.hpp"
 
 inline void createDB(const std::string& filename) {
@@ -23,12 +27,926 @@ inline void selectDB(const std::string& filename) {
     auto ul = ro.selectUserMaster();
     assert(ul.size() == 1);
     assert(ul.at(0).uname == "amitabh");
+
+    auto u = ro.selectUserMaster_id(ul.at(0).id);
+    assert(u && (u->uname == "amitabh"));
+    assert(!ro.selectUserMaster_id(ul.at(0).id + 1));
+    assert(ro.countUsers() == 1);
+    // an IN list on the key, and a window aggregate, can yield many rows
+    assert(ro.selectUserPair(ul.at(0).id).size() == 1);
+    assert(ro.countUsersRunning().size() == 1);
+    assert(ro.selectUsersByIds({ul.at(0).id, ul.at(0).id + 1}).size() == 1);
+    assert(ro.selectUsersByIds({}).empty());
+
+    std::vector<model::Auth::UserMaster> out(3);
+    assert((ro.selectUserMaster(out) == 1) && (out.size() == 1) && (out.at(0).uname == "amitabh"));
+    assert(ro.hasUser("amitabh"));
+    assert(!ro.hasUser("nobody"));
+}
+
+inline void cacheDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+
+    model::UserRW rw(db);
+    model::UserRO ro(db);
+    assert(ro.selectUserByName("amitabh").size() == 1);
+    assert(ro.selectUserByName("amitabh").size() == 1);
+    rw.insertUserMaster("amitabh");
+    assert(ro.selectUserByName("amitabh").size() == 2);
+
+    // a result cached on another connection before the write commits is dropped by the commit
+    {
+        sqlch::readers::guard g(db.readers);
+        model::UserRO other(db, g.conn());
+        sqlch::transaction t(db.db, true);
+        rw.insertUserMaster("amitabh");
+        assert(other.selectUserByName("amitabh").size() == 2);
+        t.commit();
+        assert(other.selectUserByName("amitabh").size() == 3);
+    }
+
+    // and one cached from a write that is rolled back, by the rollback
+    db.db.beginImmediate();
+    rw.insertUserMaster("amitabh");
+    assert(ro.selectUserByName("amitabh").size() == 4);
+    db.db.exec("ROLLBACK;");
+    assert(ro.selectUserByName("amitabh").size() == 3);
+    db.db.exec("DELETE FROM UserMaster WHERE id = 3;");
+}
+
+inline void pageDB(const std::string& filename) {
+    model::Auth db;
+    db.openro(filename);
+
+    model::UserRO ro(db);
+    model::UserRO::selectUserMaster_page page;
+    auto p1 = ro.selectUserMasterPage(page, 1);
+    assert((p1.size() == 1) && !page.done);
+    auto p2 = ro.selectUserMasterPage(page, 1);
+    assert((p2.size() == 1) && (p2.at(0).id > p1.at(0).id));
+    auto p3 = ro.selectUserMasterPage(page, 1);
+    assert(p3.empty() && page.done);
+
+    model::UserRO::selectUserMaster_page empty;
+    bool rejected = false;
+    try {
+        ro.selectUserMasterPage(empty, 0);
+    } catch(const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected && !empty.done);
+}
+
+inline void parallelDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+
+    model::UserRW rw(db);
+    for(int i = 0; i < 100; ++i) {
+        rw.insertUserMaster("user" + std::to_string(i % 7));
+    }
+
+    model::UserRO ro(db);
+    auto ul = ro.selectUserMaster();
+    assert(ro.selectUserMasterParallel(4).size() == ul.size());
+    auto ol = ro.selectUsersByName();
+    auto pl = ro.selectUsersByNameParallel(3);
+    assert(pl.size() == ol.size());
+    for(size_t i = 0; i < ol.size(); ++i) {
+        assert(pl.at(i).id == ol.at(i).id);
+    }
+}
+
+#if defined(SQLITE_ENABLE_SNAPSHOT)
+inline void snapshotDB(const std::string& filename) {
+    {
+        model::Auth db;
+        db.openrw(filename);
+        db.db.exec("PRAGMA journal_mode=WAL;");
+
+        model::UserRW rw(db);
+        model::UserRO ro(db);
+        auto before = ro.countUsers();
+        {
+            sqlch::snapshot snap(db.readers);
+            rw.upsertUser(9001, "snapshot");
+            assert(ro.countUsers() == before + 1);
+
+            // both pinned readers still see the state from before the insert
+            sqlch::snapshot::reader r1(snap);
+            sqlch::snapshot::reader r2(snap);
+            model::UserRO ro1(db, r1.conn());
+            model::UserRO ro2(db, r2.conn());
+            assert(ro1.countUsers() == before);
+            assert(ro2.countUsers() == before);
+
+            sqlch::snapshot fresh(db.readers);
+            sqlch::snapshot::reader r3(fresh);
+            model::UserRO ro3(db, r3.conn());
+            assert(ro3.countUsers() == before + 1);
+        }
+        db.db.exec("DELETE FROM UserMaster WHERE id = 9001;");
+    }
+
+    // the pooled readers are closed with db, so the journal mode can go back
+    model::Auth db;
+    db.openrw(filename);
+    db.db.exec("PRAGMA journal_mode=DELETE;");
+}
+#endif
+
+inline void poolDB(const std::string& filename) {
+    model::Auth db;
+    db.openro(filename);
+
+    sqlch::pool_config cfg;
+    cfg.maxSize = 2;
+    db.UserROPool.configure(cfg);
+    {
+        model::UserRO::guard g1(db.UserROPool);
+        model::UserRO::guard g2(db.UserROPool);
+        assert(g1 && g2);
+        model::UserRO::guard g3(db.UserROPool, std::chrono::milliseconds(10));
+        assert(!g3);
+        assert(g1.conn().countUsers() > 0);
+    }
+    auto st = db.UserROPool.stats();
+    assert((st.size == 2) && (st.idle == 2) && (st.timeouts == 1));
+
+    // more threads than instances, each release has to wake a waiter
+    std::vector<std::thread> tl;
+    for(int t = 0; t < 4; ++t) {
+        tl.emplace_back([&db]() {
+            for(int i = 0; i < 1000; ++i) {
+                model::UserRO::guard g(db.UserROPool);
+                assert(g);
+            }
+        });
+    }
+    for(auto& t : tl) {
+        t.join();
+    }
+    assert(db.UserROPool.stats().size == 2);
+}
+
+inline void enumDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+
+    assert(model::from_string<model::Status>("Suspended") == model::Status::Suspended);
+    bool unknown = false;
+    try {
+        model::from_string<model::Role>("Owner");
+    } catch(const std::invalid_argument&) {
+        unknown = true;
+    }
+    assert(unknown);
+
+    model::UserRW rw(db);
+    model::UserRO ro(db);
+    auto id = ro.selectUserMaster().at(0).id;
+    assert(rw.setUserStatus(model::Status::Closed, model::Role::Admin, id) == 1);
+    auto ul = ro.selectUsersByStatus(model::Status::Closed);
+    assert((ul.size() == 1) && (ul.at(0).id == id) && (ul.at(0).role == model::Role::Admin));
+    assert(static_cast<int64_t>(ro.selectUsersByStatus(model::Status::Active).size()) == (ro.countUsers() - 1));
+
+    // the CHECK constraint rejects ordinals outside the enum
+    assert(sqlite3_exec(db.db.val_, "UPDATE UserMaster SET status = 7;", nullptr, nullptr, nullptr) == SQLITE_CONSTRAINT);
+}
+
+inline void blobDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+
+    model::TokenRW rw(db);
+    std::array<uint8_t, 16> token{};
+    for(size_t i = 0; i < token.size(); ++i) {
+        token.at(i) = static_cast<uint8_t>(i * 17);
+    }
+    auto now = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
+    rw.insertUserToken(token, 1, 1.5, {0, 1, 2}, now, std::chrono::seconds(30));
+    auto t = rw.selectUserToken_token(token);
+    assert(t && (t->token == token) && (t->expiry == 1.5) && (t->data == std::vector<uint8_t>({0, 1, 2})));
+    assert((t->issued == now) && (t->ttl == std::chrono::seconds(30)));
+    token.at(0) = 1;
+    assert(!rw.selectUserToken_token(token));
+
+    rw.insertUserToken(token, 2, 0, {}, now + std::chrono::hours(1), std::chrono::seconds(0));
+    auto tl = rw.selectTokensIssued(now, now + std::chrono::minutes(1));
+    assert((tl.size() == 1) && (tl.at(0).uid == 1));
+    assert(rw.selectTokensIssued(now, now + std::chrono::hours(2)).size() == 2);
+}
+
+inline void columnarDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+
+    model::UserRO ro(db);
+    auto rows = ro.selectUserMaster();
+    auto cols = ro.selectUserTableColumns(10);
+    size_t n = 0;
+    for(auto& r : rows) {
+        if(r.id > 10) {
+            continue;
+        }
+        assert((cols.id[n] == r.id) && (cols.uname[n] == r.uname) && (cols.status[n] == r.status));
+        assert(!cols.id.isNull(n) && !cols.uname.isNull(n));
+        ++n;
+    }
+    assert((n > 0) && (cols.size == n) && (cols.uname.size() == n) && (cols.status.size() == n));
+
+    // refilling keeps the arrays
+    auto arena = cols.uname.arena.data();
+    assert(ro.selectUserTableColumns(cols, 10) == n);
+    assert(cols.uname.arena.data() == arena);
+
+    model::TokenRW rw(db);
+    db.db.exec("INSERT INTO UserToken(token, uid) VALUES(x'ff', 3);");
+    auto tc = rw.selectTokenTableColumns();
+    assert(tc.size == 3);
+    assert((tc.uid[0] == 1) && (tc.expiry[0] == 1.5) && (tc.data[0] == std::string_view("\x00\x01\x02", 3)));
+    assert((tc.data[1].size() == 0) && !tc.data.isNull(1));
+    assert((tc.token[2].at(0) == 0xff) && (tc.token[2].at(1) == 0));
+    assert(tc.expiry.isNull(2) && tc.data.isNull(2) && tc.issued.isNull(2) && !tc.uid.isNull(2));
+    db.db.exec("DELETE FROM UserToken WHERE uid = 3;");
+}
+
+// the position of field f of the flatbuffer table at t, or 0 when it is absent
+inline size_t fbField(const uint8_t* b, const size_t& t, const int& f) {
+    int32_t vt = 0;
+    ::memcpy(&vt, b + t, 4);
+    uint16_t vt_size = 0;
+    ::memcpy(&vt_size, b + t - vt, 2);
+    if((4 + 2 * f) >= vt_size) {
+        return 0;
+    }
+    uint16_t off = 0;
+    ::memcpy(&off, b + t - vt + 4 + 2 * f, 2);
+    return (off > 0) ? (t + off) : 0;
+}
+
+// follows the offset stored at p
+inline size_t fbDeref(const uint8_t* b, const size_t& p) {
+    uint32_t off = 0;
+    ::memcpy(&off, b + p, 4);
+    return p + off;
+}
+
+inline std::vector<uint8_t> readFile(const std::string& path) {
+    FILE* fp = ::fopen(path.c_str(), "rb");
+    assert(fp != nullptr);
+    std::vector<uint8_t> buf;
+    uint8_t tmp[4096];
+    size_t len = 0;
+    while((len = ::fread(tmp, 1, sizeof(tmp), fp)) > 0) {
+        buf.insert(buf.end(), tmp, tmp + len);
+    }
+    ::fclose(fp);
+    return buf;
+}
+
+inline void arrowDB(const std::string& filename, const std::string& exportFile) {
+    model::Auth db;
+    db.openrw(filename);
+
+    model::UserRO ro(db);
+    auto cols = ro.selectUserTableColumns(10);
+    size_t rows = 0;
+    {
+        sqlch::arrow_writer w(exportFile);
+        rows = ro.selectUserTableArrow(w, 4, 10);
+        assert(w.batches() == (rows + 3) / 4);
+    }
+    assert(rows == cols.size);
+    {
+        sqlch::arrow_writer w(exportFile + ".0");
+        bool rejected = false;
+        try {
+            ro.selectUserTableArrow(w, 0, 10);
+        } catch(const std::invalid_argument&) {
+            rejected = true;
+        }
+        assert(rejected && (w.batches() == 0));
+    }
+    ::remove((exportFile + ".0").c_str());
+
+    // read the stream back: each message starts with the continuation marker and ends at 8 bytes
+    auto buf = readFile(exportFile);
+    size_t pos = 0;
+    size_t messages = 0;
+    for(;;) {
+        uint32_t hdr[2];
+        assert(pos + sizeof(hdr) <= buf.size());
+        ::memcpy(hdr, buf.data() + pos, sizeof(hdr));
+        assert((hdr[0] == 0xFFFFFFFF) && ((hdr[1] % 8) == 0));
+        pos += sizeof(hdr);
+        if(hdr[1] == 0) {
+            break;
+        }
+        // bodyLength is the last scalar of a Message, so the body follows the metadata
+        int64_t body = 0;
+        auto meta = buf.data() + pos;
+        uint32_t root = 0;
+        ::memcpy(&root, meta, 4);
+        int32_t vt = 0;
+        ::memcpy(&vt, meta + root, 4);
+        uint16_t vtable[6] = {0};
+        ::memcpy(vtable, meta + root - vt, sizeof(vtable));
+        if(vtable[0] > 10) {
+            ::memcpy(&body, meta + root + vtable[5], 8);
+        }
+        pos += hdr[1] + static_cast<size_t>(body);
+        ++messages;
+    }
+    assert((pos == buf.size()) && (messages == 1 + (rows + 3) / 4));
+
+    // a batch with a column of each type, decoded from its buffers
+    const uint8_t blob[3] = {0x00, 0xFF, 0x07};
+    {
+        sqlch::arrow_writer w(exportFile);
+        w.begin({{"i", sqlch::arrow_type::int64}, {"f", sqlch::arrow_type::float64}, {"s", sqlch::arrow_type::utf8}, {"b", sqlch::arrow_type::binary}});
+        sqlch::column<int64_t> ic;
+        ic.push(-7, false);
+        ic.push(int64_t(1) << 40, false);
+        sqlch::column<double> fc;
+        fc.push(2.5, false);
+        fc.push(0, true);
+        sqlch::text_column sc;
+        sc.push("abc", 3, false);
+        sc.push("", 0, false);
+        sqlch::text_column bc;
+        bc.push(blob, sizeof(blob), false);
+        bc.push(nullptr, 0, true);
+        w.add(ic);
+        w.add(fc);
+        w.add(sc);
+        w.add(bc);
+        w.batch(2);
+        w.end();
+    }
+    buf = readFile(exportFile);
+    uint32_t hdr[2];
+    ::memcpy(hdr, buf.data(), sizeof(hdr));
+    pos = sizeof(hdr) + hdr[1];
+    ::memcpy(hdr, buf.data() + pos, sizeof(hdr));
+    auto meta = buf.data() + pos + sizeof(hdr);
+    auto body = meta + hdr[1];
+    auto rb = fbDeref(meta, fbField(meta, fbDeref(meta, 0), 2));
+    int64_t length = 0;
+    ::memcpy(&length, meta + fbField(meta, rb, 0), 8);
+    assert(length == 2);
+    auto bufs = fbDeref(meta, fbField(meta, rb, 2));
+    uint32_t nbufs = 0;
+    ::memcpy(&nbufs, meta + bufs, 4);
+    // the validity and values of each number, the validity, offsets and data of each string
+    assert(nbufs == 10);
+    auto buffer = [&](const size_t& k) {
+        int64_t ol[2];
+        ::memcpy(ol, meta + bufs + 4 + 16 * k, sizeof(ol));
+        return std::make_pair(body + ol[0], static_cast<size_t>(ol[1]));
+    };
+    int64_t iv[2];
+    assert(buffer(1).second == sizeof(iv));
+    ::memcpy(iv, buffer(1).first, sizeof(iv));
+    assert((iv[0] == -7) && (iv[1] == (int64_t(1) << 40)));
+    double fv = 0;
+    ::memcpy(&fv, buffer(3).first, sizeof(fv));
+    assert((fv == 2.5) && (buffer(2).second == 1) && (*buffer(2).first == 0x01));
+    int32_t so[3];
+    ::memcpy(so, buffer(5).first, sizeof(so));
+    assert((so[0] == 0) && (so[1] == 3) && (so[2] == 3));
+    assert(std::string(reinterpret_cast<const char*>(buffer(6).first), buffer(6).second) == "abc");
+    int32_t bo[3];
+    ::memcpy(bo, buffer(8).first, sizeof(bo));
+    assert((bo[0] == 0) && (bo[1] == 3) && (bo[2] == 3));
+    assert((buffer(9).second == sizeof(blob)) && (::memcmp(buffer(9).first, blob, sizeof(blob)) == 0));
+    assert((buffer(7).second == 1) && (*buffer(7).first == 0x01));
+    ::remove(exportFile.c_str());
+}
+
+inline void importDB(const std::string& filename, const std::string& csvFile) {
+    model::Auth db;
+    db.create(filename);
+
+    FILE* fp = ::fopen(csvFile.c_str(), "wb");
+    assert(fp != nullptr);
+    ::fputs("uname,ID,role\r\n", fp);
+    ::fputs("plain,1,Member\r\n", fp);
+    ::fputs("\"with, comma\",2,Admin\n", fp);
+    ::fputs("\"say \"\"hi\"\"\",3,Member\n", fp);
+    ::fputs(",4,Member\n", fp);
+    for(int i = 5; i <= 1000; ++i) {
+        ::fprintf(fp, "u%d,%d,Member\n", i, i);
+    }
+    ::fputs("\n", fp);
+    ::fclose(fp);
+
+    sqlch::import_config cfg;
+    cfg.batchRows = 64;
+    cfg.deferIndexes = true;
+    assert(db.importUserMaster(csvFile, cfg) == 1000);
+    model::UserRO ro(db);
+    assert(ro.countUsers() == 1000);
+    assert(ro.selectUserMaster_id(1)->uname == "plain");
+    auto u = ro.selectUserMaster_id(2);
+    assert(u && (u->uname == "with, comma") && (u->role == model::Role::Admin) && (u->status == model::Status::Active));
+    assert(ro.selectUserMaster_id(3)->uname == "say \"hi\"");
+    assert(ro.selectUserMaster_id(4)->uname == "");
+    assert(ro.selectUserByName("u1000").size() == 1);
+    sqlch::exstatement ix(db.db);
+    ix.open("SELECT COUNT(*) FROM sqlite_master WHERE type = 'index' AND name = 'UserName_Index'");
+    assert(ix.next() && (ix.getColumn<int64_t>(0) == 1));
+    ix.reset();
+
+    // a load that fails is rolled back with the indexes it dropped, even when the handler does not return
+    fp = ::fopen(csvFile.c_str(), "wb");
+    ::fputs("uname,ID\n", fp);
+    ::fputs("u2001,2001\n", fp);
+    ::fputs("u2002,x2002\n", fp);
+    ::fclose(fp);
+    auto pid = ::fork();
+    if (pid == 0) {
+        ::freopen("/dev/null", "w", stdout);
+        model::Auth cdb;
+        cdb.openrw(filename);
+        cdb.importUserMaster(csvFile, cfg);
+        ::_exit(0);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && (WEXITSTATUS(status) == 1));
+    assert(ro.countUsers() == 1000);
+    assert(ix.next() && (ix.getColumn<int64_t>(0) == 1));
+    ix.close();
+
+    // without a header the fields are in the order of the table, blobs are hex and empty fields are NULL
+    fp = ::fopen(csvFile.c_str(), "wb");
+    ::fputs("00112233445566778899aabbccddeeff,1,1.5,0a0b,1000,30\n", fp);
+    ::fputs("ff,2,,,,", fp);
+    ::fclose(fp);
+    cfg = sqlch::import_config();
+    cfg.header = false;
+    assert(db.importUserToken(csvFile, cfg) == 2);
+    model::TokenRW rw(db);
+    auto tc = rw.selectTokenTableColumns();
+    assert((tc.size == 2) && (tc.token[0].at(15) == 0xff) && (tc.expiry[0] == 1.5) && (tc.data[0] == std::string_view("\x0a\x0b", 2)));
+    assert((tc.issued[0].time_since_epoch().count() == 1000) && (tc.ttl[0].count() == 30));
+    assert((tc.token[1].at(0) == 0xff) && tc.expiry.isNull(1) && tc.data.isNull(1) && tc.ttl.isNull(1));
+    ::remove(csvFile.c_str());
+}
+
+inline void updateDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+
+    model::UserRO ro(db);
+    auto u = ro.selectUserMaster().at(0);
+    model::Auth::UserMaster_changes ch;
+    assert(db.updateUserMaster(u.id, ch) == 0);
+    ch.set_uname("renamed");
+    assert(db.updateUserMaster(u.id, ch) == 1);
+    assert(db.updateUserMaster(u.id + 100000, ch) == 0);
+    auto v = ro.selectUserMaster_id(u.id);
+    assert(v && (v->uname == "renamed") && (v->status == u.status) && (v->role == u.role));
+    ch.set_status(model::Status::Suspended);
+    assert(db.updateUserMaster(u.id, ch) == 1);
+    assert(ro.selectUserMaster_id(u.id)->status == model::Status::Suspended);
+
+    // threads writing different sets of columns create their statements at the same time
+    std::vector<std::thread> tl;
+    for(int t = 0; t < 4; ++t) {
+        tl.emplace_back([&db, &u, t]() {
+            model::Auth::UserMaster_changes tc;
+            if(t & 1) {
+                tc.set_uname("renamed");
+            }
+            if(t & 2) {
+                tc.set_status(model::Status::Suspended);
+            }
+            tc.set_role(u.role);
+            for(int i = 0; i < 100; ++i) {
+                assert(db.updateUserMaster(u.id, tc) == 1);
+            }
+        });
+    }
+    for(auto& t : tl) {
+        t.join();
+    }
+    assert(db.UserMaster_update_.size() == 6);
+}
+
+inline void upsertDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+
+    model::UserRW rw(db);
+    model::UserRO ro(db);
+    assert(rw.upsertUser(500, "u500") == sqlch::upsert_result::inserted);
+    assert(rw.upsertUser(500, "v500") == sqlch::upsert_result::updated);
+    assert(ro.selectUserMaster_id(500)->uname == "v500");
+    assert(rw.insertUserIfAbsent(500, "w500") == sqlch::upsert_result::none);
+    assert(rw.insertUserIfAbsent(501, "u501") == sqlch::upsert_result::inserted);
+    auto u = rw.upsertUserReturning(501, "v501");
+    assert(u && (u->id == 501) && (u->uname == "v501"));
+    assert(ro.selectUserByName("v501").size() == 1);
+}
+
+inline void procDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+
+    auto u = db.runProvisionUser(600, "u600", model::Status::Suspended, model::Role::Admin);
+    assert(u && (u->uname == "u600") && (u->status == model::Status::Suspended) && (u->role == model::Role::Admin));
+    model::ProvisionUser p(db);
+    u = p.run(600, "v600", model::Status::Active, model::Role::Member);
+    assert(u && (u->uname == "v600") && (u->status == model::Status::Active));
+}
+
+inline void maintDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+    db.db.exec("PRAGMA journal_mode=WAL;");
+    db.db.exec("PRAGMA wal_autocheckpoint=250;");
+
+    sqlch::maintenance_config cfg;
+    cfg.checkpointInterval = std::chrono::milliseconds(10);
+    cfg.walFrames = 1;
+    cfg.truncateFrames = 1;
+    db.maintenance.start(cfg);
+    assert(db.maintenance.isRunning());
+    model::UserRW rw(db);
+    for (uint32_t i = 0; i < 10; ++i) {
+        rw.upsertUser(700 + i, "u" + std::to_string(700 + i));
+    }
+    for (int i = 0; ((i < 200) && (db.maintenance.stats().checkpoints == 0)); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    db.maintenance.stop();
+    auto st = db.maintenance.stats();
+    assert(st.checkpoints > 0);
+    assert(st.maxCheckpoint >= st.lastCheckpoint);
+    // stop() gives back the autocheckpoint the writer had
+    sqlite3_stmt* stmt = nullptr;
+    ::sqlite3_prepare_v2(db.db.val_, "PRAGMA wal_autocheckpoint;", -1, &stmt, nullptr);
+    assert(::sqlite3_step(stmt) == SQLITE_ROW);
+    assert(::sqlite3_column_int(stmt, 0) == 250);
+    ::sqlite3_finalize(stmt);
+    db.db.exec("PRAGMA journal_mode=DELETE;");
+}
+
+struct alloc_calls {
+    uint64_t prepareMallocs;  // allocations of the first call, which prepares the statement
+    uint64_t unpooled;        // allocations of the later calls that went to malloc
+    uint64_t pooled;          // allocations of the later calls that were served from the pool
+    int64_t used;
+    int64_t highwater;
+};
+
+inline alloc_calls allocsPerCall(const std::string& filename, const bool& lookaside) {
+    model::Auth db;
+    db.openro(filename);
+    if (!lookaside) {
+        ::sqlite3_db_config(db.db.val_, SQLITE_DBCONFIG_LOOKASIDE, nullptr, 0, 0);
+    }
+    // preparing the statements of the interface uses lookaside
+    auto s0 = sqlch::allocStats();
+    model::UserRO ro(db);
+    ro.selectUserMaster_id(1);
+    auto s1 = sqlch::allocStats();
+    for (int i = 0; i < 100; ++i) {
+        ro.selectUserMaster_id(1);
+    }
+    auto s2 = sqlch::allocStats();
+    alloc_calls rv;
+    rv.prepareMallocs = s1.mallocs - s0.mallocs;
+    rv.pooled = s2.pooled - s1.pooled;
+    rv.unpooled = (s2.mallocs - s1.mallocs) - rv.pooled;
+    rv.used = s2.used;
+    rv.highwater = s2.highwater;
+    return rv;
+}
+
+inline void allocDB(const std::string& filename) {
+    assert(!sqlch::initialize());
+    auto without = allocsPerCall(filename, false);
+    auto with = allocsPerCall(filename, true);
+    // equal when sqlite is built with SQLITE_OMIT_LOOKASIDE
+    assert(with.prepareMallocs <= without.prepareMallocs);
+    // once warmed up, every allocation of a call is served from the pool
+    assert((with.unpooled == 0) && (without.unpooled == 0));
+    assert(without.pooled > 0);
+    assert(with.highwater >= with.used);
+}
+
+inline void pcacheDB(const std::string& filename) {
+    model::Auth db;
+    db.openro(filename);
+
+    auto s0 = sqlch::pageCacheStats();
+    {
+        sqlch::readers::guard g1(db.readers);
+        sqlch::readers::guard g2(db.readers);
+        model::UserRO ro1(db, g1.conn());
+        model::UserRO ro2(db, g2.conn());
+        for (int i = 0; i < 10; ++i) {
+            assert(ro1.countUsers() == ro2.countUsers());
+        }
+    }
+    auto s1 = sqlch::pageCacheStats();
+    assert(s1.hits > s0.hits);
+    assert((s1.budget == 64 * 1024) && (s1.bytes <= s1.budget));
+}
+
+inline void ioDB(const std::string& filename) {
+    assert(sqlch::registerStatsVfs());
+    {
+        model::Auth db;
+        db.create(filename, sqlch::statsVfs);
+        model::UserRW rw(db);
+        for (uint32_t i = 1; i <= 10; ++i) {
+            rw.upsertUser(i, "u" + std::to_string(i));
+        }
+    }
+    {
+        model::Auth db;
+        db.openro(filename, sqlch::statsVfs);
+        model::UserRO ro(db);
+        assert(ro.selectUserMaster().size() == 10);
+    }
+    auto st = sqlch::ioStats();
+    auto& up = st["UserRW.upsertUser"];
+    assert((up.writes > 0) && (up.writeBytes > 0) && (up.syncs > 0));
+    assert(st["UserRO.selectUserMaster"].reads > 0);
+    ::remove(filename.c_str());
+}
+
+inline void cdcDB(const std::string& filename) {
+    model::Auth db;
+    db.openrw(filename);
+    db.enableChanges();
+
+    model::UserRW rw(db);
+    model::Auth::UserMaster_change ch;
+    while (db.UserMaster_events.pop(ch)) {}
+    assert(rw.upsertUser(900, "u900") == sqlch::upsert_result::inserted);
+    assert(db.UserMaster_events.pop(ch));
+    assert((ch.op == sqlch::change_op::insert) && (ch.rowid == 900));
+#if defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+    assert(!ch.before && ch.after && (ch.after->uname == "u900"));
+#endif
+    assert(rw.upsertUser(900, "v900") == sqlch::upsert_result::updated);
+    assert(db.UserMaster_events.pop(ch));
+    assert((ch.op == sqlch::change_op::update) && (ch.rowid == 900));
+#if defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+    assert(ch.before && (ch.before->uname == "u900") && ch.after && (ch.after->uname == "v900"));
+#endif
+    db.db.exec("DELETE FROM UserMaster WHERE id = 900;");
+    assert(db.UserMaster_events.pop(ch));
+    assert((ch.op == sqlch::change_op::remove) && (ch.rowid == 900));
+#if defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+    assert(ch.before && (ch.before->id == 900) && !ch.after);
+#endif
+
+    // changes of a rolled back transaction are not published
+    {
+        sqlch::transaction t(db.db);
+        rw.upsertUser(901, "u901");
+    }
+    assert(!db.UserMaster_events.pop(ch));
+
+    // those of a commit that failed are published once, when it is retried and succeeds
+    sqlite3* reader = nullptr;
+    assert(::sqlite3_open_v2(filename.c_str(), &reader, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK);
+    assert(::sqlite3_exec(reader, "BEGIN;SELECT COUNT(*) FROM UserMaster;", nullptr, nullptr, nullptr) == SQLITE_OK);
+    ::sqlite3_busy_timeout(db.db.val_, 0);
+    db.db.exec("BEGIN DEFERRED;");
+    rw.upsertUser(902, "u902");
+    assert(::sqlite3_exec(db.db.val_, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_BUSY);
+    db.db.afterStep();
+    assert(!db.UserMaster_events.pop(ch));
+    ::sqlite3_exec(reader, "COMMIT", nullptr, nullptr, nullptr);
+    ::sqlite3_close(reader);
+    db.db.exec("COMMIT");
+    assert(db.UserMaster_events.pop(ch) && (ch.rowid == 902));
+    db.db.exec("DELETE FROM UserMaster WHERE id = 902;");
+    assert(db.UserMaster_events.pop(ch) && (ch.op == sqlch::change_op::remove));
+    assert(!db.UserMaster_events.pop(ch));
+    assert(db.UserMaster_events.dropped() == 0);
+}
+
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+inline void replDB(const std::string& leaderFile, const std::string& followerFile, const std::string& logFile) {
+    ::remove(logFile.c_str());
+    model::Auth leader;
+    leader.create(leaderFile);
+    model::Auth follower;
+    follower.create(followerFile);
+
+    sqlch::file_sink sink(logFile);
+    leader.replication.start(sink);
+    model::UserRW rw(leader);
+    {
+        sqlch::transaction t(leader.db);
+        rw.upsertUser(1, "u1");
+        rw.upsertUser(2, "u2");
+        t.commit();
+    }
+    leader.runProvisionUser(3, "u3", model::Status::Suspended, model::Role::Admin);
+    {
+        sqlch::transaction t(leader.db);
+        rw.upsertUser(4, "u4");
+    }
+    assert(leader.replication.stats().published == 2);
+
+    sqlch::file_source source(logFile);
+    assert(follower.replication.follow(source) == 2);
+    model::UserRO ro(follower);
+    assert(ro.selectUserMaster().size() == 3);
+    auto u = ro.selectUserMaster_id(3);
+    assert(u && (u->uname == "u3") && (u->status == model::Status::Suspended) && (u->role == model::Role::Admin));
+    assert(!ro.selectUserMaster_id(4));
+
+    // updates and deletes are shipped as well
+    {
+        sqlch::transaction t(leader.db);
+        rw.upsertUser(1, "v1");
+        leader.db.exec("DELETE FROM UserMaster WHERE id = 2;");
+        t.commit();
+    }
+    assert(follower.replication.follow(source) == 1);
+    assert(!follower.replication.follow(source));
+    assert(ro.selectUserMaster_id(1)->uname == "v1");
+    assert(!ro.selectUserMaster_id(2));
+    assert(follower.replication.stats().applied == 3);
+
+    // writes in autocommit mode are shipped on their own, as each one commits
+    rw.upsertUser(5, "u5");
+    assert(follower.replication.follow(source) == 1);
+    assert(ro.selectUserMaster_id(5)->uname == "u5");
+    leader.db.exec("UPDATE UserMaster SET uname = 'v5' WHERE id = 5;");
+    assert(follower.replication.follow(source) == 1);
+    assert(ro.selectUserMaster_id(5)->uname == "v5");
+
+    // the session and the change capture can not share the preupdate hook, in either order
+    auto pid = ::fork();
+    if (pid == 0) {
+        ::freopen("/dev/null", "w", stdout);
+        leader.enableChanges();
+        ::_exit(0);
+    }
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && (WEXITSTATUS(status) == 1));
+    leader.replication.stop();
+    leader.enableChanges();
+    pid = ::fork();
+    if (pid == 0) {
+        ::freopen("/dev/null", "w", stdout);
+        leader.replication.start(sink);
+        ::_exit(0);
+    }
+    ::waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && (WEXITSTATUS(status) == 1));
+}
+#endif
+
+#if SQLCH_IO_URING
+inline void uringDB(const std::string& filename) {
+    if (!sqlch::registerUringVfs()) {
+        return;
+    }
+    {
+        model::Auth db;
+        db.create(filename, sqlch::uringVfs);
+        db.db.exec("PRAGMA journal_mode=WAL;");
+        model::UserRW rw(db);
+        for (uint32_t i = 1; i <= 1000; ++i) {
+            sqlch::transaction t(db.db);
+            rw.upsertUser(i, "u" + std::to_string(i));
+            t.commit();
+        }
+        model::UserRO ro(db);
+        assert(ro.countUsers() == 1000);
+        assert(ro.selectUserMaster_id(500)->uname == "u500");
+    }
+    {
+        model::Auth db;
+        db.openro(filename, sqlch::uringVfs);
+        model::UserRO ro(db);
+        assert(ro.selectUserMaster().size() == 1000);
+    }
+
+    // a WAL write that fails must fail its commit, a commit that succeeded must be there after a crash
+    int fds[2];
+    assert(::pipe(fds) == 0);
+    auto pid = ::fork();
+    if (pid == 0) {
+        ::freopen("/dev/null", "w", stdout);
+        ::close(fds[0]);
+        ::signal(SIGXFSZ, SIG_IGN);
+        rlimit lim = {256 * 1024, 256 * 1024};
+        ::setrlimit(RLIMIT_FSIZE, &lim);
+        model::Auth db;
+        db.openrw(filename, sqlch::uringVfs);
+        // without a sync on commit, nothing else would see the failed write before the wal-index update
+        db.db.exec("PRAGMA synchronous=NORMAL;");
+        model::UserRW rw(db);
+        for (uint32_t i = 1; i <= 1000; ++i) {
+            sqlch::transaction t(db.db);
+            rw.upsertUser(1000 + i, std::string(2000, 'x'));
+            t.commit();
+            ::write(fds[1], &i, sizeof(i));
+        }
+        ::_exit(0);
+    }
+    ::close(fds[1]);
+    uint32_t committed = 0;
+    uint32_t n = 0;
+    while (::read(fds[0], &n, sizeof(n)) == sizeof(n)) {
+        committed = n;
+    }
+    ::close(fds[0]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && (WEXITSTATUS(status) == 1));
+    {
+        model::Auth db;
+        db.openro(filename);
+        model::UserRO ro(db);
+        assert(ro.countUsers() == 1000 + committed);
+    }
+    ::remove(filename.c_str());
+    ::remove((filename + "-wal").c_str());
+    ::remove((filename + "-shm").c_str());
+}
+#endif
+
+inline void loadDB(const std::string& filename) {
+    model::Auth db;
+    db.openro(filename);
+
+    model::UserRO ro(db);
+    auto ul = ro.selectUsersByIds({1, 2, 3});
+    assert(ul.size() == 3);
+    auto tm = db.loadUserToken_uid(ul);
+    assert((tm.size() == 2) && (tm.at(1).size() == 1) && (tm.at(2).size() == 1) && (tm.count(3) == 0));
+    assert(tm.at(2).at(0).uid == 2);
+
+    // the first calls from several threads race to create the statement
+    model::Auth db2;
+    db2.openro(filename);
+    std::vector<std::thread> tl;
+    for(int t = 0; t < 4; ++t) {
+        tl.emplace_back([&db2, &ul]() {
+            for(int i = 0; i < 50; ++i) {
+                assert(db2.loadUserToken_uid(ul).size() == 2);
+            }
+        });
+    }
+    for(auto& t : tl) {
+        t.join();
+    }
 }
 
 int main(int argc, char* argv[]) {
     std::string filename = "test.db";
+    sqlch::runtime_config cfg;
+    cfg.poolAllocator = true;
+    cfg.lookasideSize = 1200;
+    cfg.lookasideCount = 100;
+    cfg.pageCacheBudget = 64 * 1024;
+    cfg.mmapSize = 1024 * 1024;
+    assert(sqlch::initialize(cfg));
     createDB(filename);
     insertDB(filename);
     selectDB(filename);
+    cacheDB(filename);
+    pageDB(filename);
+    parallelDB(filename);
+#if defined(SQLITE_ENABLE_SNAPSHOT)
+    snapshotDB(filename);
+#endif
+    poolDB(filename);
+    enumDB(filename);
+    blobDB(filename);
+    columnarDB(filename);
+    arrowDB(filename, "test_export.arrow");
+    importDB("test_import.db", "test_import.csv");
+    loadDB(filename);
+    updateDB(filename);
+    upsertDB(filename);
+    procDB(filename);
+    maintDB(filename);
+    allocDB(filename);
+    pcacheDB(filename);
+    ioDB("test_io.db");
+    cdcDB(filename);
+#if defined(SQLITE_ENABLE_SESSION) && defined(SQLITE_ENABLE_PREUPDATE_HOOK)
+    replDB("test_leader.db", "test_follower.db", "test_repl.log");
+#endif
+#if SQLCH_IO_URING
+    uringDB("test_uring.db");
+#endif
     return 0;
 }